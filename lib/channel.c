@@ -0,0 +1,365 @@
+// Implements the functions prototyped in channel.h.
+
+// Imports
+#include <string.h>
+#include <sched.h>
+
+// Local imports
+#include "isa.h"
+#include "libsca.h"
+#include "channel.h"
+
+// ISA-specific imports
+#if (ISA == ISA_X86)
+#include <x86intrin.h>
+#endif
+
+// The preamble, sent most significant bit first. Any shift of it by up to 8
+// bits differs from itself in at least 6 of the overlapping bits, so it's
+// unlikely to be found a few bits off (and it differs from an idle channel,
+// which reads as all 0s, in 8 bits).
+#define CHANNEL_PREAMBLE 0x0be6
+
+// Maximum number of codewords interleaved together
+#define CHANNEL_MAX_INTERLEAVE 64
+
+// Bytes in a frame besides its payload: the length, and the checksum
+#define CHANNEL_OVERHEAD 2
+
+// Hamming(7,4) codeword for each nibble. Bit 'i' of a codeword is position
+// 'i + 1' of the code: parity bits are at positions 1, 2, and 4, and the
+// nibble's bits at positions 3, 5, 6, and 7.
+static const uint8_t LG(channel_hamming_encode)[16] = {
+    0x00, 0x07, 0x19, 0x1e, 0x2a, 0x2d, 0x33, 0x34,
+    0x4b, 0x4c, 0x52, 0x55, 0x61, 0x66, 0x78, 0x7f
+};
+
+// Nibble decoded from each (possibly corrupted) Hamming(7,4) codeword. Bit 4
+// is set if a bit of the codeword had to be corrected.
+static const uint8_t LG(channel_hamming_decode)[128] = {
+    0x00, 0x10, 0x10, 0x11, 0x10, 0x11, 0x11, 0x01,
+    0x10, 0x12, 0x14, 0x18, 0x19, 0x15, 0x13, 0x11,
+    0x10, 0x12, 0x1a, 0x16, 0x17, 0x1b, 0x13, 0x11,
+    0x12, 0x02, 0x13, 0x12, 0x13, 0x12, 0x03, 0x13,
+    0x10, 0x1c, 0x14, 0x16, 0x17, 0x15, 0x1d, 0x11,
+    0x14, 0x15, 0x04, 0x14, 0x15, 0x05, 0x14, 0x15,
+    0x17, 0x16, 0x16, 0x06, 0x07, 0x17, 0x17, 0x16,
+    0x1e, 0x12, 0x14, 0x16, 0x17, 0x15, 0x13, 0x1f,
+    0x10, 0x1c, 0x1a, 0x18, 0x19, 0x1b, 0x1d, 0x11,
+    0x19, 0x18, 0x18, 0x08, 0x09, 0x19, 0x19, 0x18,
+    0x1a, 0x1b, 0x0a, 0x1a, 0x1b, 0x0b, 0x1a, 0x1b,
+    0x1e, 0x12, 0x1a, 0x18, 0x19, 0x1b, 0x13, 0x1f,
+    0x1c, 0x0c, 0x1d, 0x1c, 0x1d, 0x1c, 0x0d, 0x1d,
+    0x1e, 0x1c, 0x14, 0x18, 0x19, 0x15, 0x1d, 0x1f,
+    0x1e, 0x1c, 0x1a, 0x16, 0x17, 0x1b, 0x1d, 0x1f,
+    0x0e, 0x1e, 0x1e, 0x1f, 0x1e, 0x1f, 0x1f, 0x0f,
+};
+
+// Names of each code (indexed by 'fec_e')
+static const char* LG(fec_names)[LIBSCA_FEC_COUNT] = {
+    "none", "hamming74"
+};
+
+
+// ====================== Framing and Error Correction ====================== //
+// Helper function that returns the number of bits in a codeword.
+static inline unsigned int LF(channel_codeword_bits)(PS(channel_t)* ch)
+{ return ch->fec == LIBSCA_FEC_HAMMING74 ? 7 : 4; }
+
+// Helper function that returns the number of codewords a frame carrying
+// 'len' payload bytes is coded into: two per byte, padded out to a whole
+// number of interleaved groups.
+static inline size_t LF(channel_codewords)(PS(channel_t)* ch, size_t len)
+{
+    size_t count = (len + CHANNEL_OVERHEAD) * 2;
+    return ((count + ch->interleave - 1) / ch->interleave) * ch->interleave;
+}
+
+// Helper function that computes a CRC-8 (polynomial 0x07) over a buffer.
+static uint8_t LF(channel_crc8)(const uint8_t* data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+        { crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x07) : crc << 1; }
+    }
+    return crc;
+}
+
+// Helper function that de-interleaves and decodes the group of codewords
+// whose bits start at 'bits', storing one nibble per codeword in 'nibbles'.
+// Returns the number of codewords that needed a correction.
+static size_t LF(channel_decode_group)(PS(channel_t)* ch, const uint8_t* bits,
+                                       uint8_t* nibbles)
+{
+    unsigned int n = LF(channel_codeword_bits)(ch);
+    unsigned int depth = ch->interleave;
+    uint8_t codewords[CHANNEL_MAX_INTERLEAVE] = {0};
+
+    // bit 'b' of every codeword in the group is sent before bit 'b + 1' of
+    // any of them
+    for (unsigned int b = 0; b < n; b++)
+    {
+        for (unsigned int c = 0; c < depth; c++)
+        { codewords[c] |= (*bits++ & 0x1) << b; }
+    }
+
+    size_t corrected = 0;
+    for (unsigned int c = 0; c < depth; c++)
+    {
+        if (ch->fec == LIBSCA_FEC_HAMMING74)
+        {
+            uint8_t decoded = LG(channel_hamming_decode)[codewords[c]];
+            nibbles[c] = decoded & 0xf;
+            corrected += decoded >> 4;
+        }
+        else
+        { nibbles[c] = codewords[c]; }
+    }
+    return corrected;
+}
+
+PE(result_e) PF(channel_init)(PS(channel_t)* ch, PE(fec_e) fec,
+                              unsigned int interleave)
+{
+    if (fec >= LIBSCA_FEC_COUNT || interleave == 0 ||
+        interleave > CHANNEL_MAX_INTERLEAVE)
+    { return LIBSCA_INVALID_INPUT; }
+    ch->fec = fec;
+    ch->interleave = interleave;
+    return LIBSCA_SUCCESS;
+}
+
+size_t PF(channel_frame_bits)(PS(channel_t)* ch, size_t len)
+{
+    return LIBSCA_CHANNEL_PREAMBLE_BITS +
+           (LF(channel_codewords)(ch, len) * LF(channel_codeword_bits)(ch));
+}
+
+size_t PF(channel_encode)(PS(channel_t)* ch, const uint8_t* payload,
+                          size_t len, uint8_t* bits)
+{
+    if (len > LIBSCA_CHANNEL_MAX_PAYLOAD)
+    { return 0; }
+
+    // build the frame's bytes: its length, payload, and checksum
+    uint8_t frame[LIBSCA_CHANNEL_MAX_PAYLOAD + CHANNEL_OVERHEAD];
+    frame[0] = (uint8_t) len;
+    memcpy(frame + 1, payload, len);
+    frame[len + 1] = LF(channel_crc8)(frame, len + 1);
+
+    uint8_t* out = bits;
+    for (int b = LIBSCA_CHANNEL_PREAMBLE_BITS - 1; b >= 0; b--)
+    { *out++ = (CHANNEL_PREAMBLE >> b) & 0x1; }
+
+    // code the frame one interleaved group at a time (low nibbles first).
+    // Codewords past the end of the frame pad out the last group; both codes
+    // map a 0 nibble to a 0 codeword
+    unsigned int n = LF(channel_codeword_bits)(ch);
+    unsigned int depth = ch->interleave;
+    size_t nibbles = (len + CHANNEL_OVERHEAD) * 2;
+    size_t count = LF(channel_codewords)(ch, len);
+    for (size_t group = 0; group < count; group += depth)
+    {
+        uint8_t codewords[CHANNEL_MAX_INTERLEAVE];
+        for (unsigned int c = 0; c < depth; c++)
+        {
+            size_t i = group + c;
+            uint8_t nibble = i < nibbles ? (frame[i / 2] >> ((i % 2) * 4)) & 0xf
+                                         : 0;
+            codewords[c] = ch->fec == LIBSCA_FEC_HAMMING74 ?
+                           LG(channel_hamming_encode)[nibble] : nibble;
+        }
+        for (unsigned int b = 0; b < n; b++)
+        {
+            for (unsigned int c = 0; c < depth; c++)
+            { *out++ = (codewords[c] >> b) & 0x1; }
+        }
+    }
+    return out - bits;
+}
+
+PE(result_e) PF(channel_decode)(PS(channel_t)* ch, const uint8_t* bits,
+                                size_t nbits, size_t* pos, uint8_t* payload,
+                                size_t* len, size_t* corrected)
+{
+    // the length is in the first two codewords, which may span more than one
+    // interleaved group
+    unsigned int depth = ch->interleave;
+    size_t group_bits = depth * LF(channel_codeword_bits)(ch);
+    size_t header = ((2 + depth - 1) / depth) * depth;
+    size_t min_bits = LIBSCA_CHANNEL_PREAMBLE_BITS +
+                      ((header / depth) * group_bits);
+
+    // slide along the bits until they match the preamble closely enough. The
+    // last 16 bits are kept in a window, so each step is a shift and an XOR
+    size_t i = *pos;
+    uint32_t window = 0;
+    for (size_t k = 0; k < LIBSCA_CHANNEL_PREAMBLE_BITS - 1 && i + k < nbits;
+         k++)
+    { window = (window << 1) | (bits[i + k] & 0x1); }
+    for (; i + min_bits <= nbits; i++)
+    {
+        window = ((window << 1) | (bits[i + LIBSCA_CHANNEL_PREAMBLE_BITS - 1] &
+                                   0x1)) & 0xffff;
+        if (__builtin_popcount(window ^ CHANNEL_PREAMBLE) >
+            LIBSCA_CHANNEL_PREAMBLE_ERRORS)
+        { continue; }
+
+        // decode the groups holding the length, then the rest
+        const uint8_t* coded = bits + i + LIBSCA_CHANNEL_PREAMBLE_BITS;
+        uint8_t nibbles[(LIBSCA_CHANNEL_MAX_PAYLOAD + CHANNEL_OVERHEAD) * 2 +
+                        CHANNEL_MAX_INTERLEAVE];
+        size_t fixed = 0;
+        for (size_t group = 0; group < header; group += depth)
+        {
+            fixed += LF(channel_decode_group)(ch, coded, nibbles + group);
+            coded += group_bits;
+        }
+        size_t length = nibbles[0] | (nibbles[1] << 4);
+        size_t count = LF(channel_codewords)(ch, length);
+        size_t frame_bits = PF(channel_frame_bits)(ch, length);
+        // a frame that would run past the end is most likely a false match
+        // with a garbage length, so keep searching from the next position
+        // (a real frame after it mustn't be thrown away)
+        if (i + frame_bits > nbits)
+        { continue; }
+        for (size_t group = header; group < count; group += depth)
+        {
+            fixed += LF(channel_decode_group)(ch, coded, nibbles + group);
+            coded += group_bits;
+        }
+
+        // reassemble the bytes, and check them against the checksum
+        uint8_t frame[LIBSCA_CHANNEL_MAX_PAYLOAD + CHANNEL_OVERHEAD];
+        for (size_t b = 0; b < length + CHANNEL_OVERHEAD; b++)
+        { frame[b] = nibbles[b * 2] | (nibbles[(b * 2) + 1] << 4); }
+        if (LF(channel_crc8)(frame, length + 1) != frame[length + 1])
+        {
+            *pos = i + LIBSCA_CHANNEL_PREAMBLE_BITS;
+            return LIBSCA_FAILURE;
+        }
+
+        memcpy(payload, frame + 1, length);
+        *len = length;
+        if (corrected)
+        { *corrected += fixed; }
+        *pos = i + frame_bits;
+        return LIBSCA_SUCCESS;
+    }
+
+    *pos = nbits;
+    return LIBSCA_INVALID_INPUT;
+}
+
+const char* PF(fec_name)(PE(fec_e) fec)
+{
+    if (fec >= LIBSCA_FEC_COUNT)
+    { return NULL; }
+    return LG(fec_names)[fec];
+}
+
+PE(fec_e) PF(fec_parse)(const char* name)
+{
+    for (int i = 0; i < LIBSCA_FEC_COUNT; i++)
+    {
+        if (!strcmp(name, LG(fec_names)[i]))
+        { return (PE(fec_e)) i; }
+    }
+    return LIBSCA_FEC_COUNT;
+}
+
+
+// ============================= Slot Transport ============================= //
+// Helper function that waits until the timestamp counter reaches 'target',
+// and returns the time. The CPU is yielded while waiting, in case the other
+// end of the channel is running on the same CPU (and needs it to reach its
+// own deadline).
+static inline uint64_t LF(channel_wait)(uint64_t target)
+{
+    uint64_t now;
+    while ((now = PF(cycles)()) < target)
+    { sched_yield(); }
+    return now;
+}
+
+void PF(channel_transmit)(PS(channel_link_t)* link, uint64_t start,
+                          const uint8_t* bits, size_t nbits)
+{
+    size_t lines = link->line_count;
+    uint64_t slot = link->slot_cycles;
+    for (size_t k = 0; k * lines < nbits; k++)
+    {
+        // touch the lines early in the slot; if we're already past the
+        // middle of it, the receiver is about to sample, so skip it
+        uint64_t slot_start = start + (k * slot);
+        uint64_t now = LF(channel_wait)(slot_start);
+        if (now > slot_start + (slot / 2))
+        { continue; }
+
+        const uint8_t* symbol = bits + (k * lines);
+        for (size_t l = 0; l < lines && (k * lines) + l < nbits; l++)
+        {
+            if (symbol[l] & 0x1)
+            {
+                // the fence keeps a mispredicted branch from touching a line
+                // speculatively (which the receiver would see as a 1)
+                #if (ISA == ISA_X86)
+                _mm_lfence();
+                #endif
+                *(volatile uint8_t*) link->lines[l];
+            }
+        }
+    }
+}
+
+size_t PF(channel_receive)(PS(channel_link_t)* link, uint64_t start,
+                           uint8_t* bits, size_t nbits, uint8_t* erased)
+{
+    size_t lines = link->line_count;
+    uint64_t slot = link->slot_cycles;
+    if (link->shuffle == 0)
+    { link->shuffle = 0x9e3779b97f4a7c15ul; }
+
+    // start from a clean slate: every line flushed
+    size_t order[LIBSCA_CHANNEL_MAX_LINES];
+    for (size_t l = 0; l < lines; l++)
+    {
+        order[l] = l;
+        PF(flush)(link->lines[l]);
+    }
+
+    size_t missed = 0;
+    for (size_t k = 0; k * lines < nbits; k++)
+    {
+        uint8_t* symbol = bits + (k * lines);
+        size_t count = MIN(lines, nbits - (k * lines));
+
+        // sample late in the slot, giving the sender time to touch its lines
+        uint64_t slot_end = start + ((k + 1) * slot);
+        uint64_t now = LF(channel_wait)(slot_end - (slot / 4));
+        if (erased)
+        { erased[k] = now >= slot_end; }
+        if (now >= slot_end)
+        {
+            // too late to tell this slot apart from the next one
+            memset(symbol, 0, count);
+            missed++;
+            continue;
+        }
+
+        // probe the lines in a fresh random order each slot
+        PF(rand_shuffle)(order, lines, &link->shuffle);
+        for (size_t i = 0; i < lines; i++)
+        {
+            size_t l = order[i];
+            unsigned long cycles = PF(load)(link->lines[l], NULL);
+            if (l < count)
+            { symbol[l] = cycles <= link->threshold; }
+            PF(flush)(link->lines[l]);
+        }
+    }
+    return missed;
+}
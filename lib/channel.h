@@ -0,0 +1,119 @@
+// This module implements a framed, error-corrected covert channel on top of a
+// slotted Flush+Reload bit transport. The transport sends a fixed number of
+// bits per time slot (one per shared line: a touched line is a 1), with slots
+// synchronized on the timestamp counter. The framing layer turns payloads into
+// bit streams the receiver can find and check on its own:
+//
+//      [ preamble ][ length | payload | CRC-8 ] (coded and interleaved)
+//
+// The preamble (sent uncoded) lets the receiver find where a frame starts in
+// its stream of slots, even after slots were missed or garbled. The rest of
+// the frame is split into nibbles, each optionally protected with a Hamming
+// (7,4) code (which corrects one flipped bit per nibble), and the codewords
+// are interleaved so a burst of errors (such as an interrupt wiping out a few
+// consecutive slots) is spread across many codewords.
+
+#ifndef LIBSCA_CHANNEL_H
+#define LIBSCA_CHANNEL_H
+
+// Imports
+#include <stddef.h>
+#include <stdint.h>
+#include "symbols.h"
+#include "error.h"
+
+// Maximum payload of a single frame (in bytes)
+#define LIBSCA_CHANNEL_MAX_PAYLOAD 255
+// Length of the preamble (in bits), and the number of bits of it that may be
+// received incorrectly while still being recognized
+#define LIBSCA_CHANNEL_PREAMBLE_BITS 16
+#define LIBSCA_CHANNEL_PREAMBLE_ERRORS 2
+// Maximum number of lines (bits per slot) a transport can use
+#define LIBSCA_CHANNEL_MAX_LINES 64
+
+
+// ====================== Framing and Error Correction ====================== //
+// Enum representing the forward error correction codes a channel can use.
+typedef enum LE(fec)
+{
+    LIBSCA_FEC_NONE,            // nibbles are sent as-is
+    LIBSCA_FEC_HAMMING74,       // each nibble is sent as a Hamming(7,4) word
+    LIBSCA_FEC_COUNT,           // ------------------------------------------
+} PE(fec_e);
+
+// A channel's framing configuration. Both ends must use the same one.
+typedef struct LS(channel)
+{
+    PE(fec_e) fec;              // code applied to each nibble
+    unsigned int interleave;    // codewords interleaved together (1 = none)
+} PS(channel_t);
+
+// Initializes a channel configuration.
+// Returns a result enum.
+PE(result_e) PF(channel_init)(PS(channel_t)* ch, PE(fec_e) fec,
+                              unsigned int interleave);
+
+// Returns the number of bits a frame carrying 'len' payload bytes encodes to.
+size_t PF(channel_frame_bits)(PS(channel_t)* ch, size_t len);
+
+// Encodes a frame carrying 'len' bytes of 'payload' into 'bits' (one bit per
+// byte, each 0 or 1), which must hold 'channel_frame_bits(len)' entries.
+// Returns the number of bits written, or 0 if the payload is too large.
+size_t PF(channel_encode)(PS(channel_t)* ch, const uint8_t* payload,
+                          size_t len, uint8_t* bits);
+
+// Searches 'bits' (one bit per byte) for the next frame, starting at '*pos',
+// and decodes its payload into 'payload' (which should hold
+// LIBSCA_CHANNEL_MAX_PAYLOAD bytes) and its length into '*len'. The number
+// of bits the code corrected is added to '*corrected' (if non-NULL).
+// '*pos' is advanced past the frame if one was decoded, past its preamble if
+// the frame failed its checksum, or to the end of the bits if no preamble
+// was found. (A preamble whose frame would run past the end of the bits is
+// skipped, and the search continues after it.)
+// Returns LIBSCA_SUCCESS if a frame was decoded, LIBSCA_FAILURE if a frame
+// was found but was corrupted, and LIBSCA_INVALID_INPUT if no frame was
+// found.
+PE(result_e) PF(channel_decode)(PS(channel_t)* ch, const uint8_t* bits,
+                                size_t nbits, size_t* pos, uint8_t* payload,
+                                size_t* len, size_t* corrected);
+
+// Returns a string name for the given code (ex: "hamming74").
+// Returns NULL if the code is invalid.
+const char* PF(fec_name)(PE(fec_e) fec);
+
+// Parses a code's name (as returned by 'fec_name()').
+// Returns LIBSCA_FEC_COUNT if the name isn't recognized.
+PE(fec_e) PF(fec_parse)(const char* name);
+
+
+// ============================= Slot Transport ============================= //
+// A slotted Flush+Reload bit transport over lines shared by two processes.
+// The sender and receiver must agree on the lines (in the same order), the
+// slot length, and the timestamp at which the first slot starts.
+typedef struct LS(channel_link)
+{
+    uint8_t* lines[LIBSCA_CHANNEL_MAX_LINES];   // shared lines (one per bit)
+    size_t line_count;          // bits sent per slot
+    unsigned long slot_cycles;  // length of each slot (in cycles)
+    unsigned long threshold;    // receiver: loads this fast are 1s
+    uint64_t shuffle;           // receiver: state of the probe-order shuffle
+} PS(channel_link_t);
+
+// Sends 'nbits' bits (one per byte), 'line_count' per slot, starting with
+// the slot that begins at the timestamp 'start'. A 1 is sent by loading its
+// line early in the slot. Slots that have already reached their midpoint
+// by the time we get to them are skipped.
+void PF(channel_transmit)(PS(channel_link_t)* link, uint64_t start,
+                          const uint8_t* bits, size_t nbits);
+
+// Receives 'nbits' bits (one per byte) sent by 'channel_transmit()' with the
+// same start time. Each slot is sampled three quarters of the way through:
+// every line's load is timed (in a random order, so the prefetchers can't
+// learn a stride) and then flushed for the next slot. Bits of slots we reach
+// too late to sample are set to 0. If 'erased' is non-NULL, it receives one
+// entry per slot: 1 if the slot was missed, and 0 otherwise.
+// Returns the number of slots missed.
+size_t PF(channel_receive)(PS(channel_link_t)* link, uint64_t start,
+                           uint8_t* bits, size_t nbits, uint8_t* erased);
+
+#endif
@@ -7,10 +7,37 @@
 
 // Global config struct
 PS(config_t) LG(config) = {
-    .cache_size = 49152,
-    .cache_associativity = 12,
-    .cache_line_size = 64,
-    .addr_collision_trial_score = 0.95
+    .cache_levels = {
+        [LIBSCA_CACHE_L1D] = {
+            .size = 49152,
+            .associativity = 12,
+            .line_size = 64,
+            .inclusive = -1
+        },
+        [LIBSCA_CACHE_L1I] = {
+            .size = 32768,
+            .associativity = 8,
+            .line_size = 64,
+            .inclusive = -1
+        },
+        [LIBSCA_CACHE_L2] = {
+            .size = 1310720,
+            .associativity = 20,
+            .line_size = 64,
+            .inclusive = -1
+        },
+        [LIBSCA_CACHE_LLC] = {
+            .size = 12582912,
+            .associativity = 12,
+            .line_size = 64,
+            .inclusive = -1
+        }
+    },
+    .addr_collision_trial_score = 0.95,
+    .mem_alloc_flags = LIBSCA_MEM_POPULATE,
+    .evset_test_trials = 5,
+    .filter_mad_cutoff = 5.0,
+    .filter_max_cycles = 100000
 };
 
 PS(config_t)* PF(config_get)()
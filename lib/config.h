@@ -8,16 +8,49 @@
 #include <stddef.h>
 #include "symbols.h"
 
+// Flags used to control how the library allocates the memory regions it uses
+// for timing cache lines (see 'mem_alloc_flags' below).
+#define LIBSCA_MEM_HUGEPAGE 0x1     // back regions with 2 MiB huge pages
+#define LIBSCA_MEM_POPULATE 0x2     // pre-fault every page at allocation time
+#define LIBSCA_MEM_LOCK     0x4     // mlock() regions into physical memory
+
+// Enum representing the levels of the CPU cache hierarchy the library knows
+// about.
+typedef enum LE(cache_level)
+{
+    LIBSCA_CACHE_L1D,           // level 1 data cache
+    LIBSCA_CACHE_L1I,           // level 1 instruction cache
+    LIBSCA_CACHE_L2,            // level 2 (unified) cache
+    LIBSCA_CACHE_LLC,           // last-level cache
+    LIBSCA_CACHE_LEVEL_COUNT,   // ------------------------------------------
+} PE(cache_level_e);
+
+// Maximum length of a cache level's list of sharing CPUs.
+#define LIBSCA_CPU_LIST_SIZE 256
+
+// Describes the geometry of a single level of the CPU cache.
+typedef struct LS(cache_geometry)
+{
+    size_t size;                // total number of bytes in the cache
+    size_t associativity;       // number of cache lines per set
+    size_t line_size;           // size of each cache line (in bytes)
+    size_t sets;                // number of sets (if 0, derived from the above)
+    int inclusive;              // 1 if inclusive of lower levels, 0 if not, -1 if unknown
+    char shared_cpu_list[LIBSCA_CPU_LIST_SIZE]; // CPUs sharing the cache (ex: "0-3,8-11")
+} PS(cache_geometry_t);
+
 // This struct represents the global config for the library. If this library is
 // ever used by multiple threads at once, this is NOT thread-safe. The config
 // fields should be initialized at the start of the program, then left alone as
 // a read-only data structure once threads are spawned.
 typedef struct LS(config)
 {
-    size_t cache_size;                  // total number of bytes in the cache
-    size_t cache_associativity;         // number of cache lines per set
-    size_t cache_line_size;             // size of each cache line (in bytes)
+    PS(cache_geometry_t) cache_levels[LIBSCA_CACHE_LEVEL_COUNT]; // geometry of each cache level
     double addr_collision_trial_score;  // [0.0, 1.0] hit rate required to consider two addresses colliding
+    int mem_alloc_flags;                // LIBSCA_MEM_* flags used when allocating cache lines
+    unsigned int evset_test_trials;     // number of trials (majority vote) per eviction test
+    double filter_mad_cutoff;           // scaled MADs from the median a filtered sample may lie (0 disables)
+    unsigned long filter_max_cycles;    // filtered samples above this are always discarded (0 disables)
 
 } PS(config_t);
 
@@ -31,8 +64,12 @@ typedef struct LS(config)
 //
 // So, given the above config fields, we can compute various cache metrics:
 //
-//      NUM_LINES = (cache_size / cache_line_size)
-//      NUM_SETS = (NUM_LINES / cache_associativity)
+//      NUM_LINES = (size / line_size)
+//      NUM_SETS = (NUM_LINES / associativity)
+//
+// The library fills these in at initialization, using the CPUID instruction
+// and Linux's /sys/devices/system/cpu/cpu0/cache/index*/ directories. (In
+// containers and VMs, sysconf() often reports zero for these values.)
 //
 // In Linux systems, one way to find the size of the cache is by running
 // `getconf -a` and searching for fields containing the word "CACHE". Example:
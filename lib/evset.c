@@ -0,0 +1,259 @@
+// Implements the functions prototyped in evset.h.
+
+// Imports
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Local imports
+#include "evset.h"
+#include "mem.h"
+#include "utils.h"
+
+
+// ============================= Eviction Sets ============================== //
+int PF(evset_test)(void* target, void** lines, size_t count,
+                   unsigned long threshold, unsigned long* accesses)
+{
+    PS(config_t)* conf = PF(config_get)();
+    unsigned int trials = MAX(conf->evset_test_trials, 1);
+    unsigned int evictions = 0;
+
+    for (unsigned int t = 0; t < trials; t++)
+    {
+        // bring the target into the cache
+        LF(mem_load_cycles)(target, NULL);
+
+        // access every line in the set (twice, back and forth, so replacement
+        // policies that don't evict on the first insertion still do)
+        for (size_t i = 0; i < count; i++)
+        { *((volatile char*) lines[i]); }
+        for (size_t i = count; i > 0; i--)
+        { *((volatile char*) lines[i - 1]); }
+
+        // time the target's reload
+        evictions += LF(mem_load_cycles)(target, NULL) > threshold;
+    }
+
+    // each trial loads the target twice and walks the set twice
+    if (accesses)
+    { *accesses += (unsigned long) trials * (2 + (2 * count)); }
+    return evictions * 2 > trials;
+}
+
+// Helper function that swaps the 'len' addresses starting at index 'a' with the
+// 'len' addresses starting at index 'b'.
+static void LF(evset_swap)(void** lines, size_t a, size_t b, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        void* tmp = lines[a + i];
+        lines[a + i] = lines[b + i];
+        lines[b + i] = tmp;
+    }
+}
+
+PE(result_e) PF(evset_build)(PS(evset_t)* es, void* target,
+                             void** candidates, size_t candidate_count,
+                             PE(cache_level_e) level, unsigned long threshold)
+{
+    memset(es, 0, sizeof(PS(evset_t)));
+    es->target = target;
+    PS(config_t)* conf = PF(config_get)();
+    size_t ways = conf->cache_levels[level].associativity;
+    if (candidate_count < ways || ways == 0)
+    { return LIBSCA_INVALID_INPUT; }
+
+    unsigned long start = LF(mem_cycles)();
+
+    // remove the target itself from the pool, if it's present
+    size_t n = 0;
+    for (size_t i = 0; i < candidate_count; i++)
+    {
+        if (candidates[i] != target)
+        { candidates[n++] = candidates[i]; }
+    }
+
+    // the whole pool must evict the target, or there's nothing to reduce
+    PE(result_e) result = LIBSCA_SUCCESS;
+    if (!PF(evset_test)(target, candidates, n, threshold, &es->accesses))
+    { result = LIBSCA_FAILURE; }
+
+    // reduce the pool until only 'ways' addresses remain
+    while (result == LIBSCA_SUCCESS && n > ways)
+    {
+        // split the pool into (ways + 1) groups and look for one we can remove.
+        // Each group is swapped to the end of the pool, so the remaining
+        // addresses form a contiguous prefix that we can test directly
+        size_t groups = MIN(ways + 1, n);
+        size_t group_size = (n + groups - 1) / groups;
+        int removed = 0;
+        for (size_t g = 0; g < groups && !removed; g++)
+        {
+            size_t g_start = g * group_size;
+            if (g_start >= n)
+            { break; }
+            size_t g_len = MIN(group_size, n - g_start);
+
+            LF(evset_swap)(candidates, g_start, n - g_len, g_len);
+            if (PF(evset_test)(target, candidates, n - g_len, threshold,
+                               &es->accesses))
+            {
+                n -= g_len;
+                removed = 1;
+            }
+            else
+            { LF(evset_swap)(candidates, g_start, n - g_len, g_len); }
+        }
+
+        // if no group could be removed, the pool contains too few congruent
+        // addresses (or our measurements are too noisy) to continue
+        if (!removed)
+        { result = LIBSCA_FAILURE; }
+    }
+
+    es->cycles = LF(mem_cycles)() - start;
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+
+    // copy the minimal set out of the pool
+    es->lines = malloc(n * sizeof(void*));
+    if (!es->lines)
+    { return LIBSCA_ALLOC_FAILURE; }
+    memcpy(es->lines, candidates, n * sizeof(void*));
+    es->size = n;
+    return LIBSCA_SUCCESS;
+}
+
+// Arguments passed to each eviction set construction thread.
+typedef struct LS(evset_worker)
+{
+    unsigned int id;
+    unsigned int threads;
+    PS(evset_t)* sets;
+    void** targets;
+    size_t count;
+    void** candidates;
+    size_t candidate_count;
+    PE(cache_level_e) level;
+    unsigned long threshold;
+    PE(result_e) result;
+} LS(evset_worker_t);
+
+// Thread entry point: pins itself to a CPU, then builds every eviction set
+// whose index is congruent to its ID.
+static void* LF(evset_worker)(void* arg)
+{
+    LS(evset_worker_t)* w = arg;
+    w->result = LIBSCA_SUCCESS;
+
+    // pin this thread to its own CPU
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // each thread reorders its own copy of the pool
+    void** pool = malloc(w->candidate_count * sizeof(void*));
+    if (!pool)
+    {
+        w->result = LIBSCA_ALLOC_FAILURE;
+        return NULL;
+    }
+
+    for (size_t i = w->id; i < w->count; i += w->threads)
+    {
+        memcpy(pool, w->candidates, w->candidate_count * sizeof(void*));
+        PE(result_e) r = PF(evset_build)(&w->sets[i], w->targets[i], pool,
+                                         w->candidate_count, w->level,
+                                         w->threshold);
+        if (r != LIBSCA_SUCCESS)
+        { w->result = r; }
+    }
+
+    free(pool);
+    return NULL;
+}
+
+PE(result_e) PF(evset_build_many)(PS(evset_t)* sets, void** targets,
+                                  size_t count, void** candidates,
+                                  size_t candidate_count,
+                                  PE(cache_level_e) level,
+                                  unsigned long threshold,
+                                  unsigned int threads)
+{
+    if (threads == 0)
+    { return LIBSCA_INVALID_INPUT; }
+    threads = MIN(threads, count > 0 ? count : 1);
+
+    LS(evset_worker_t)* workers = calloc(threads, sizeof(LS(evset_worker_t)));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    if (!workers || !tids)
+    {
+        free(workers);
+        free(tids);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+
+    // start from empty sets, so any that fail are left with a size of zero
+    memset(sets, 0, count * sizeof(PS(evset_t)));
+
+    // workers that run on this thread pin it to a CPU, so save its affinity
+    // to restore once we're done
+    cpu_set_t affinity;
+    int affinity_saved = !pthread_getaffinity_np(pthread_self(),
+                                                 sizeof(affinity), &affinity);
+
+    // spawn one worker per thread (the last one runs on this thread, as do any
+    // whose thread couldn't be created)
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        LS(evset_worker_t)* w = &workers[t];
+        w->id = t;
+        w->threads = threads;
+        w->sets = sets;
+        w->targets = targets;
+        w->count = count;
+        w->candidates = candidates;
+        w->candidate_count = candidate_count;
+        w->level = level;
+        w->threshold = threshold;
+        if (t < threads - 1 &&
+            pthread_create(&tids[t], NULL, LF(evset_worker), w))
+        {
+            tids[t] = 0;
+            LF(evset_worker)(w);
+        }
+    }
+    LF(evset_worker)(&workers[threads - 1]);
+
+    // wait for the workers and collect their results
+    PE(result_e) result = LIBSCA_SUCCESS;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        if (t < threads - 1 && tids[t])
+        { pthread_join(tids[t], NULL); }
+        if (workers[t].result != LIBSCA_SUCCESS)
+        { result = workers[t].result; }
+    }
+    if (affinity_saved)
+    { pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity); }
+
+    free(workers);
+    free(tids);
+    return result;
+}
+
+void PF(evset_free)(PS(evset_t)* es)
+{
+    free(es->lines);
+    es->lines = NULL;
+    es->size = 0;
+}
@@ -0,0 +1,77 @@
+// This module implements the construction of minimal eviction sets. An
+// eviction set for a target address is a group of addresses that map to the
+// same cache set as the target; accessing all of them evicts the target from
+// the cache. A minimal eviction set has exactly as many addresses as the
+// cache's associativity.
+
+#ifndef LIBSCA_EVSET_H
+#define LIBSCA_EVSET_H
+
+// Imports
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+#include "config.h"
+
+
+// ============================= Eviction Sets ============================== //
+// Represents a single eviction set, along with statistics on how much work it
+// took to construct.
+typedef struct LS(evset)
+{
+    void* target;               // the address this set evicts
+    void** lines;               // dynamically-allocated array of addresses
+    size_t size;                // number of addresses in the set
+    unsigned long cycles;       // CPU cycles spent constructing the set
+    unsigned long accesses;     // memory accesses made constructing it
+} PS(evset_t);
+
+// Determines if accessing the 'count' addresses in 'lines' evicts 'target'
+// from the cache. A target whose reload takes more than 'threshold' cycles is
+// considered evicted. The test is repeated the number of times given by the
+// config's 'evset_test_trials', and the majority result is returned (1 if
+// evicted, 0 if not).
+// If 'accesses' is non-NULL, the number of memory accesses made (the target's
+// timed loads as well as the set's lines) is added to it.
+int PF(evset_test)(void* target, void** lines, size_t count,
+                   unsigned long threshold, unsigned long* accesses);
+
+// Builds a minimal eviction set for 'target' within the given cache level,
+// using the 'candidate_count' addresses in 'candidates' as the pool to choose
+// from. The pool must be large enough to evict the target on its own.
+// The 'threshold' parameter is the reload latency (in cycles) above which the
+// target is considered evicted from 'level'. (For L1, this is the L1 hit
+// threshold; for the LLC, it's the threshold between LLC hits and DRAM.)
+//
+// The pool is reduced with group testing: it's split into (associativity + 1)
+// groups, and since a minimal set has only 'associativity' members, at least
+// one group can always be discarded while still evicting the target. This
+// takes a number of tests that's linear in the pool size, rather than the
+// quadratic number of pairwise collision trials.
+//
+// The 'candidates' array is reordered in place. On success, the set's 'lines'
+// must be freed with 'evset_free()'.
+// Returns a result enum (LIBSCA_FAILURE if the pool doesn't evict the target,
+// or couldn't be reduced).
+PE(result_e) PF(evset_build)(PS(evset_t)* es, void* target,
+                             void** candidates, size_t candidate_count,
+                             PE(cache_level_e) level, unsigned long threshold);
+
+// Builds eviction sets for each of the 'count' addresses in 'targets' (writing
+// them into the 'sets' array), sharing the same candidate pool. The work is
+// split among 'threads' threads, each pinned to its own CPU and working on a
+// private copy of the pool. (Parallelism is only useful for the private cache
+// levels; LLC constructions on different cores interfere with each other.)
+// Returns LIBSCA_SUCCESS only if every set was built. Sets that failed have a
+// size of zero.
+PE(result_e) PF(evset_build_many)(PS(evset_t)* sets, void** targets,
+                                  size_t count, void** candidates,
+                                  size_t candidate_count,
+                                  PE(cache_level_e) level,
+                                  unsigned long threshold,
+                                  unsigned int threads);
+
+// Frees the eviction set's memory.
+void PF(evset_free)(PS(evset_t)* es);
+
+#endif
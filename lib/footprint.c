@@ -0,0 +1,306 @@
+// Implements the functions prototyped in footprint.h.
+
+// Imports
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Local imports
+#include "libsca.h"
+#include "footprint.h"
+
+// Maximum length of a line in a CSV profile
+#define FOOTPRINT_LINE_MAX 256
+
+
+// ============================ Footprint Profile =========================== //
+// Helper function that allocates a profile's per-set arrays.
+static PE(result_e) LF(footprint_alloc)(PS(footprint_t)* fp, size_t sets)
+{
+    memset(fp, 0, sizeof(PS(footprint_t)));
+    fp->evictions = calloc(sets, sizeof(uint32_t));
+    fp->baseline = calloc(sets, sizeof(uint32_t));
+    fp->thresholds = calloc(sets, sizeof(uint16_t));
+    if (!fp->evictions || !fp->baseline || !fp->thresholds)
+    {
+        PF(footprint_free)(fp);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+    fp->sets = sets;
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function that sets each set's threshold to a high percentile of its
+// probe latencies, with nothing run between priming and probing.
+static PE(result_e) LF(footprint_calibrate)(PS(footprint_t)* fp,
+                                            PS(primeprobe_t)* pp,
+                                            unsigned long* latencies)
+{
+    PS(dataset_t)* samples = calloc(fp->sets, sizeof(PS(dataset_t)));
+    if (!samples)
+    { return LIBSCA_ALLOC_FAILURE; }
+    PE(result_e) result = LIBSCA_SUCCESS;
+    size_t initialized = 0;
+    for (; initialized < fp->sets; initialized++)
+    {
+        if (PF(dataset_init_width)(&samples[initialized],
+                                   LIBSCA_FOOTPRINT_CALIBRATION, 2))
+        {
+            result = LIBSCA_ALLOC_FAILURE;
+            goto footprint_calibrate_done;
+        }
+    }
+
+    for (unsigned int r = 0; r < LIBSCA_FOOTPRINT_CALIBRATION; r++)
+    {
+        PF(primeprobe_probe_all)(pp, latencies);
+        for (size_t s = 0; s < fp->sets; s++)
+        { PF(dataset_add)(&samples[s], (long) latencies[s]); }
+    }
+    for (size_t s = 0; s < fp->sets; s++)
+    {
+        long threshold = PF(dataset_percentile)(&samples[s],
+                                                LIBSCA_FOOTPRINT_PERCENTILE);
+        fp->thresholds[s] = (uint16_t) MIN(threshold, UINT16_MAX);
+    }
+
+    footprint_calibrate_done:
+    for (size_t s = 0; s < initialized; s++)
+    { PF(dataset_free)(&samples[s]); }
+    free(samples);
+    return result;
+}
+
+PE(result_e) PF(footprint)(PS(footprint_t)* fp, void (*fn)(void* arg),
+                           void* arg, unsigned long rounds)
+{
+    if (!fn || rounds == 0 || rounds > UINT32_MAX)
+    { return LIBSCA_INVALID_INPUT; }
+
+    PS(primeprobe_t) pp;
+    PE(result_e) result = PF(primeprobe_init)(&pp);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+    result = LF(footprint_alloc)(fp, pp.sets);
+    unsigned long* latencies = malloc(pp.sets * sizeof(unsigned long));
+    if (result != LIBSCA_SUCCESS || !latencies)
+    {
+        result = LIBSCA_ALLOC_FAILURE;
+        goto footprint_fail;
+    }
+
+    PF(primeprobe_prime)(&pp);
+    result = LF(footprint_calibrate)(fp, &pp, latencies);
+    if (result != LIBSCA_SUCCESS)
+    { goto footprint_fail; }
+
+    // rounds alternate between the function and the baseline in pairs: each
+    // probe flips the traversal direction, so this way both kinds of round
+    // see both directions equally often. (Probing also primes every set for
+    // the next round.)
+    for (unsigned long r = 0; r < rounds * 2; r++)
+    {
+        int run = (r >> 1) & 0x1;
+        if (run)
+        { fn(arg); }
+        PF(primeprobe_probe_all)(&pp, latencies);
+
+        uint32_t* counts = run ? fp->evictions : fp->baseline;
+        for (size_t s = 0; s < fp->sets; s++)
+        { counts[s] += latencies[s] > fp->thresholds[s]; }
+    }
+    fp->rounds = rounds;
+
+    free(latencies);
+    PF(primeprobe_free)(&pp);
+    return LIBSCA_SUCCESS;
+
+    footprint_fail:
+    free(latencies);
+    PF(primeprobe_free)(&pp);
+    PF(footprint_free)(fp);
+    return result;
+}
+
+double PF(footprint_rate)(PS(footprint_t)* fp, size_t set)
+{
+    if (fp->rounds == 0)
+    { return 0.0; }
+    return ((double) fp->evictions[set] - (double) fp->baseline[set]) /
+           (double) fp->rounds;
+}
+
+// Helper function that divides a difference by its standard error, treating
+// any difference with no error as a certain one.
+static double LF(footprint_score)(double difference, double variance)
+{
+    if (variance <= 0.0)
+    {
+        if (difference == 0.0)
+        { return 0.0; }
+        return difference > 0.0 ? HUGE_VAL : -HUGE_VAL;
+    }
+    return difference / sqrt(variance);
+}
+
+double PF(footprint_z)(PS(footprint_t)* fp, size_t set)
+{
+    if (fp->rounds == 0)
+    { return 0.0; }
+
+    // both rates are compared against their pooled rate
+    double n = (double) fp->rounds;
+    double pooled = ((double) fp->evictions[set] + fp->baseline[set]) /
+                    (2.0 * n);
+    double variance = pooled * (1.0 - pooled) * (2.0 / n);
+    return LF(footprint_score)(PF(footprint_rate)(fp, set), variance);
+}
+
+size_t PF(footprint_touched)(PS(footprint_t)* fp)
+{
+    size_t touched = 0;
+    for (size_t s = 0; s < fp->sets; s++)
+    { touched += PF(footprint_z)(fp, s) > LIBSCA_FOOTPRINT_Z; }
+    return touched;
+}
+
+void PF(footprint_dump)(PS(footprint_t)* fp, FILE* out,
+                        PE(footprint_format_e) format)
+{
+    double n = fp->rounds > 0 ? (double) fp->rounds : 1.0;
+    if (format == LIBSCA_FOOTPRINT_CSV)
+    { fprintf(out, "set,threshold,rounds,evictions,baseline,rate,z\n"); }
+    else
+    {
+        fprintf(out, "L1D footprint: %lu rounds, %lu of %lu sets touched "
+                "(z > %.1f).\n", fp->rounds, PF(footprint_touched)(fp),
+                fp->sets, LIBSCA_FOOTPRINT_Z);
+        fprintf(out, "%6s %10s %10s %10s %10s %10s\n", "set", "threshold",
+                "evicted", "baseline", "excess", "z");
+    }
+
+    for (size_t s = 0; s < fp->sets; s++)
+    {
+        double z = PF(footprint_z)(fp, s);
+        if (format == LIBSCA_FOOTPRINT_CSV)
+        {
+            fprintf(out, "%lu,%u,%lu,%u,%u,%.6f,%.3f\n", s, fp->thresholds[s],
+                    fp->rounds, fp->evictions[s], fp->baseline[s],
+                    PF(footprint_rate)(fp, s), z);
+            continue;
+        }
+        fprintf(out, "%6lu %10u %9.2f%% %9.2f%% %9.2f%% %10.2f%s\n", s,
+                fp->thresholds[s], 100.0 * fp->evictions[s] / n,
+                100.0 * fp->baseline[s] / n, 100.0 * PF(footprint_rate)(fp, s),
+                z, z > LIBSCA_FOOTPRINT_Z ? " *" : "");
+    }
+}
+
+PE(result_e) PF(footprint_load)(PS(footprint_t)* fp, FILE* in)
+{
+    memset(fp, 0, sizeof(PS(footprint_t)));
+    char line[FOOTPRINT_LINE_MAX];
+    if (!fgets(line, sizeof(line), in) || strncmp(line, "set,", 4))
+    { return LIBSCA_INVALID_INPUT; }
+
+    // grow the per-set arrays as rows are read (rows must be in set order)
+    size_t capacity = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+        size_t set;
+        unsigned int threshold;
+        unsigned long rounds;
+        unsigned int evictions;
+        unsigned int baseline;
+        if (sscanf(line, "%lu,%u,%lu,%u,%u", &set, &threshold, &rounds,
+                   &evictions, &baseline) != 5 || set != fp->sets ||
+            (set > 0 && rounds != fp->rounds))
+        {
+            PF(footprint_free)(fp);
+            return LIBSCA_INVALID_INPUT;
+        }
+
+        if (fp->sets == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            uint32_t* e = realloc(fp->evictions, capacity * sizeof(uint32_t));
+            if (e)
+            { fp->evictions = e; }
+            uint32_t* b = realloc(fp->baseline, capacity * sizeof(uint32_t));
+            if (b)
+            { fp->baseline = b; }
+            uint16_t* t = realloc(fp->thresholds, capacity * sizeof(uint16_t));
+            if (t)
+            { fp->thresholds = t; }
+            if (!e || !b || !t)
+            {
+                PF(footprint_free)(fp);
+                return LIBSCA_ALLOC_FAILURE;
+            }
+        }
+        fp->evictions[set] = evictions;
+        fp->baseline[set] = baseline;
+        fp->thresholds[set] = (uint16_t) MIN(threshold, UINT16_MAX);
+        fp->rounds = rounds;
+        fp->sets++;
+    }
+
+    if (fp->sets == 0)
+    { return LIBSCA_INVALID_INPUT; }
+    return LIBSCA_SUCCESS;
+}
+
+long PF(footprint_diff)(PS(footprint_t)* a, PS(footprint_t)* b, FILE* out,
+                        PE(footprint_format_e) format)
+{
+    if (a->sets != b->sets || a->rounds == 0 || b->rounds == 0)
+    { return -1; }
+
+    if (format == LIBSCA_FOOTPRINT_CSV)
+    { fprintf(out, "set,rate_a,rate_b,delta,z\n"); }
+    else
+    {
+        fprintf(out, "%6s %10s %10s %10s %10s\n", "set", "excess a",
+                "excess b", "delta", "z");
+    }
+
+    long changed = 0;
+    for (size_t s = 0; s < a->sets; s++)
+    {
+        // each excess rate is the difference of two independent proportions,
+        // so its variance is the sum of theirs
+        double rate_a = PF(footprint_rate)(a, s);
+        double rate_b = PF(footprint_rate)(b, s);
+        double variance = 0.0;
+        PS(footprint_t)* profiles[] = {a, b};
+        for (int i = 0; i < 2; i++)
+        {
+            double n = (double) profiles[i]->rounds;
+            double pe = profiles[i]->evictions[s] / n;
+            double pb = profiles[i]->baseline[s] / n;
+            variance += ((pe * (1.0 - pe)) + (pb * (1.0 - pb))) / n;
+        }
+        double z = LF(footprint_score)(rate_a - rate_b, variance);
+        int differs = fabs(z) > LIBSCA_FOOTPRINT_Z;
+        changed += differs;
+
+        if (format == LIBSCA_FOOTPRINT_CSV)
+        {
+            fprintf(out, "%lu,%.6f,%.6f,%.6f,%.3f\n", s, rate_a, rate_b,
+                    rate_a - rate_b, z);
+            continue;
+        }
+        fprintf(out, "%6lu %9.2f%% %9.2f%% %9.2f%% %10.2f%s\n", s,
+                100.0 * rate_a, 100.0 * rate_b, 100.0 * (rate_a - rate_b), z,
+                differs ? " *" : "");
+    }
+    return changed;
+}
+
+void PF(footprint_free)(PS(footprint_t)* fp)
+{
+    free(fp->evictions);
+    free(fp->baseline);
+    free(fp->thresholds);
+    memset(fp, 0, sizeof(PS(footprint_t)));
+}
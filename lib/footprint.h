@@ -0,0 +1,94 @@
+// This module implements a cache-footprint profiler: it measures which sets
+// of the L1 data cache a function touches, and how often. Each round, every
+// set is primed, the function is run, and every set is probed; a set whose
+// probe takes longer than its threshold is counted as evicted. The function's
+// rounds are interleaved with baseline rounds that run nothing, so the sets
+// the profiler's own code (and background noise) evicts can be told apart
+// from the ones the function evicts.
+//
+// A set's threshold is the upper quartile of its own probe latencies, measured
+// before profiling with nothing run between priming and probing. On a quiet
+// machine, a set the function touches is evicted in nearly every round, and
+// one it doesn't in few; on a noisy one, the difference in eviction rates is
+// smaller, but it's still significant over enough rounds. Each set's excess
+// rate (over the baseline rounds) is scored with a two-proportion z-test.
+//
+// Profiles can be dumped as text or CSV, loaded back from CSV, and diffed
+// against each other (such as to check that a change shrank a routine's
+// working set, or that a table-free implementation touches no table sets).
+
+#ifndef LIBSCA_FOOTPRINT_H
+#define LIBSCA_FOOTPRINT_H
+
+// Imports
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "symbols.h"
+#include "error.h"
+
+// Percentile of each set's calibration latencies used as its threshold
+#define LIBSCA_FOOTPRINT_PERCENTILE 0.75
+// Number of rounds used to calibrate the thresholds
+#define LIBSCA_FOOTPRINT_CALIBRATION 2000
+// The |z| above which a set is considered touched (or changed, in a diff)
+#define LIBSCA_FOOTPRINT_Z 4.5
+
+
+// ============================ Footprint Profile =========================== //
+// Enum representing the formats a profile can be dumped in.
+typedef enum LE(footprint_format)
+{
+    LIBSCA_FOOTPRINT_TEXT,      // an aligned table, with touched sets marked
+    LIBSCA_FOOTPRINT_CSV,       // comma-separated values (can be loaded back)
+    LIBSCA_FOOTPRINT_FORMAT_COUNT, // ---------------------------------------
+} PE(footprint_format_e);
+
+// A cache-footprint profile.
+typedef struct LS(footprint)
+{
+    size_t sets;                // number of L1D sets profiled
+    unsigned long rounds;       // rounds of each kind (function and baseline)
+    uint32_t* evictions;        // per set: function rounds it was evicted in
+    uint32_t* baseline;         // per set: baseline rounds it was evicted in
+    uint16_t* thresholds;       // per set: probe latency threshold (in cycles)
+} PS(footprint_t);
+
+// Profiles the L1D footprint of 'fn' (called with 'arg') over 'rounds'
+// rounds, interleaved with as many baseline rounds.
+// The profile must be freed with 'footprint_free()'.
+// Returns a result enum.
+PE(result_e) PF(footprint)(PS(footprint_t)* fp, void (*fn)(void* arg),
+                           void* arg, unsigned long rounds);
+
+// Returns the fraction of function rounds a set was evicted in, less the
+// fraction of baseline rounds it was evicted in.
+double PF(footprint_rate)(PS(footprint_t)* fp, size_t set);
+
+// Returns the z-score of a set's excess eviction rate (how many standard
+// errors it lies above zero).
+double PF(footprint_z)(PS(footprint_t)* fp, size_t set);
+
+// Returns the number of sets whose z-score exceeds LIBSCA_FOOTPRINT_Z.
+size_t PF(footprint_touched)(PS(footprint_t)* fp);
+
+// Writes the profile to 'out' in the given format.
+void PF(footprint_dump)(PS(footprint_t)* fp, FILE* out,
+                        PE(footprint_format_e) format);
+
+// Loads a profile written by 'footprint_dump()' in CSV format.
+// The profile must be freed with 'footprint_free()'.
+// Returns a result enum.
+PE(result_e) PF(footprint_load)(PS(footprint_t)* fp, FILE* in);
+
+// Compares two profiles of the same cache, writing each set's excess rate in
+// both (and the z-score of their difference) to 'out' in the given format.
+// Returns the number of sets whose rates differ with a |z| above
+// LIBSCA_FOOTPRINT_Z, or -1 if the profiles cover different numbers of sets.
+long PF(footprint_diff)(PS(footprint_t)* a, PS(footprint_t)* b, FILE* out,
+                        PE(footprint_format_e) format);
+
+// Frees the profile's memory.
+void PF(footprint_free)(PS(footprint_t)* fp);
+
+#endif
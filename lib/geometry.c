@@ -0,0 +1,423 @@
+// Implements the functions prototyped in geometry.h.
+
+// Imports
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Local imports
+#include "libsca.h"
+#include "geometry.h"
+#include "mem.h"
+
+// Smallest working set swept (in bytes)
+#define GEOMETRY_MIN_SIZE 4096
+// Minimum number of timed hops per measurement (small working sets are walked
+// several times over, so the timestamps' overhead is amortized)
+#define GEOMETRY_MIN_HOPS 262144
+// Number of times each measurement is repeated (the fastest one is kept, which
+// filters out interrupts and other noise)
+#define GEOMETRY_REPEATS 3
+// Range of strides tried when inferring the line size (in bytes)
+#define GEOMETRY_MIN_LINE 8
+#define GEOMETRY_MAX_LINE 512
+// Assumed line size used by the capacity sweep, before the real one is known
+#define GEOMETRY_SWEEP_STRIDE 64
+// Largest associativity tried
+#define GEOMETRY_MAX_WAYS 32
+// A point whose latency is this many times its plateau's latency (and at least
+// GEOMETRY_JUMP_CYCLES above it) begins a jump to the next level; the jump
+// ends once a point is within GEOMETRY_SETTLE of the one before it
+#define GEOMETRY_JUMP 1.3
+#define GEOMETRY_JUMP_CYCLES 2.0
+#define GEOMETRY_SETTLE 1.1
+
+// Largest number of plateaus tracked on the latency curve
+#define GEOMETRY_MAX_PLATEAUS 8
+
+// Number of data cache levels inferred (L1D, L2, LLC)
+#define GEOMETRY_DATA_LEVELS 3
+static const PE(cache_level_e) LG(geometry_levels)[GEOMETRY_DATA_LEVELS] =
+{ LIBSCA_CACHE_L1D, LIBSCA_CACHE_L2, LIBSCA_CACHE_LLC };
+
+
+// ============================ Pointer Chasing ============================= //
+// Helper function that links the nodes of a working set into a single cycle
+// and returns its first node. The working set is split into blocks of 'block'
+// bytes, each holding 'group' nodes spaced 'stride' bytes apart. The blocks
+// are visited in a random order (so the hardware prefetchers can't predict
+// the next access), and the nodes within a block in descending order (so the
+// next-line prefetchers, which only look ahead, don't help either).
+// Returns NULL if the permutation couldn't be allocated.
+static void* LF(geometry_link)(char* buf, size_t working_set, size_t block,
+                               size_t stride, size_t group)
+{
+    size_t blocks = working_set / block;
+    size_t* order = malloc(blocks * sizeof(size_t));
+    if (!order)
+    { return NULL; }
+
+    // shuffle the block order
+    for (size_t i = 0; i < blocks; i++)
+    { order[i] = i; }
+    PF(rand_shuffle)(order, blocks, NULL);
+
+    // each node holds a pointer to the next one; the last node of the last
+    // block wraps back around to the first
+    void** first = NULL;
+    void** prev = NULL;
+    for (size_t i = 0; i < blocks; i++)
+    {
+        for (size_t j = 0; j < group; j++)
+        {
+            size_t offset = (order[i] * block) + ((group - 1 - j) * stride);
+            void** cur = (void**) (buf + offset);
+            if (prev)
+            { *prev = cur; }
+            else
+            { first = cur; }
+            prev = cur;
+        }
+    }
+    *prev = first;
+
+    free(order);
+    return first;
+}
+
+// Helper function that walks a linked working set of 'nodes' nodes and returns
+// the average number of cycles per hop. The set is walked once untimed to
+// warm up the caches, then timed several times (keeping the fastest).
+static double LF(geometry_walk)(void** start, size_t nodes)
+{
+    size_t hops = nodes < GEOMETRY_MIN_HOPS ? GEOMETRY_MIN_HOPS : nodes;
+    void** p = start;
+    for (size_t i = 0; i < nodes; i++)
+    { p = (void**) *p; }
+
+    double best = 0.0;
+    for (int r = 0; r < GEOMETRY_REPEATS; r++)
+    {
+        // each load depends on the previous one, so they can't overlap
+        unsigned long cycles1 = LF(mem_cycles)();
+        for (size_t i = 0; i < hops; i++)
+        { p = (void**) *p; }
+        unsigned long cycles2 = LF(mem_cycles)();
+
+        double cycles = (double) (cycles2 - cycles1) / hops;
+        if (r == 0 || cycles < best)
+        { best = cycles; }
+    }
+
+    // hand the final pointer to the compiler so the loops aren't optimized out
+    __asm__ volatile("" : : "r" (p) : "memory");
+    return best;
+}
+
+// Helper function that links and walks a working set (see the two helpers
+// above). Returns 0 on failure.
+static double LF(geometry_chase_blocks)(void* buf, size_t working_set,
+                                        size_t block, size_t stride,
+                                        size_t group)
+{
+    if (!buf || block < sizeof(void*) || group == 0 ||
+        (group - 1) * stride + sizeof(void*) > block || working_set < block)
+    { return 0.0; }
+
+    void** start = LF(geometry_link)(buf, working_set, block, stride, group);
+    if (!start)
+    { return 0.0; }
+    return LF(geometry_walk)(start, (working_set / block) * group);
+}
+
+double PF(geometry_chase)(void* buf, size_t working_set, size_t stride)
+{ return LF(geometry_chase_blocks)(buf, working_set, stride, stride, 1); }
+
+
+// ============================ Geometry Probing ============================ //
+// Helper function that sweeps working sets from GEOMETRY_MIN_SIZE up to
+// 'max_size', alternating between powers of two and 1.5x powers of two (so
+// common capacities like 48 KiB and 12 MiB are measured exactly).
+static PE(result_e) LF(geometry_sweep)(PS(geometry_probe_t)* gp, void* buf,
+                                       size_t max_size)
+{
+    // count the points first
+    size_t count = 0;
+    for (size_t size = GEOMETRY_MIN_SIZE; size <= max_size; size *= 2)
+    { count += (size + (size / 2) <= max_size) ? 2 : 1; }
+
+    gp->points = calloc(count, sizeof(PS(latency_point_t)));
+    if (!gp->points)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    for (size_t size = GEOMETRY_MIN_SIZE; size <= max_size; size *= 2)
+    {
+        size_t sizes[2] = {size, size + (size / 2)};
+        for (int i = 0; i < 2 && sizes[i] <= max_size; i++)
+        {
+            PS(latency_point_t)* point = &gp->points[gp->point_count];
+            point->working_set = sizes[i];
+            point->cycles = PF(geometry_chase)(buf, sizes[i],
+                                               GEOMETRY_SWEEP_STRIDE);
+            if (point->cycles == 0.0)
+            { return LIBSCA_ALLOC_FAILURE; }
+            gp->point_count++;
+        }
+    }
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function that splits the latency curve into plateaus. The first
+// plateaus are assigned to the data cache levels (in order) and the last one
+// to main memory.
+static void LF(geometry_plateaus)(PS(geometry_probe_t)* gp)
+{
+    size_t starts[GEOMETRY_MAX_PLATEAUS];
+    double latencies[GEOMETRY_MAX_PLATEAUS];
+    size_t plateaus = 0;
+
+    // walk the curve, tracking the current plateau's mean latency; once a
+    // point jumps well above it, the plateau ends, and the next one begins
+    // once the curve settles again
+    double sum = 0.0;
+    size_t n = 0;
+    int rising = 0;
+    for (size_t i = 0; i < gp->point_count; i++)
+    {
+        double cycles = gp->points[i].cycles;
+        if (rising)
+        {
+            if (cycles > gp->points[i - 1].cycles * GEOMETRY_SETTLE)
+            { continue; }
+            rising = 0;
+        }
+
+        double mean = n > 0 ? sum / n : cycles;
+        if (n > 0 && cycles > mean * GEOMETRY_JUMP &&
+            cycles > mean + GEOMETRY_JUMP_CYCLES)
+        {
+            rising = 1;
+            n = 0;
+            continue;
+        }
+
+        // start a new plateau, or add to the current one
+        if (n == 0)
+        {
+            if (plateaus == GEOMETRY_MAX_PLATEAUS)
+            { break; }
+            starts[plateaus++] = i;
+            sum = 0.0;
+        }
+        sum += cycles;
+        n++;
+        latencies[plateaus - 1] = sum / n;
+    }
+    if (plateaus == 0)
+    { return; }
+
+    // whatever the curve ends on is treated as main memory (if the sweep ended
+    // mid-jump, its last point is the best estimate available)
+    gp->memory_latency = rising ? gp->points[gp->point_count - 1].cycles :
+                                  latencies[plateaus - 1];
+    size_t levels = rising ? plateaus : plateaus - 1;
+    if (levels > GEOMETRY_DATA_LEVELS)
+    { levels = GEOMETRY_DATA_LEVELS; }
+
+    // the jumps between plateaus are gradual (physical addresses don't spread
+    // evenly across the sets, so conflicts begin before a level is full), so
+    // a level's capacity is taken to be the first working set whose latency
+    // passes the geometric mean of its and the next level's latency. A working
+    // set the exact size of a cache already thrashes it (other lines, such as
+    // the stack and page tables, compete for it too), so this lands on the
+    // capacity itself when it's on the sweep's grid, and rounds it up to the
+    // next grid point otherwise
+    for (size_t l = 0; l < levels; l++)
+    {
+        double next = (l + 1 < plateaus) ? latencies[l + 1] :
+                                           gp->memory_latency;
+        double threshold = sqrt(latencies[l] * next);
+        size_t i = starts[l];
+        while (i < gp->point_count - 1 && gp->points[i].cycles <= threshold)
+        { i++; }
+
+        PE(cache_level_e) level = LG(geometry_levels)[l];
+        gp->levels[level].size = gp->points[i].working_set;
+        gp->latencies[level] = latencies[l];
+    }
+    gp->levels_found = levels;
+}
+
+// Helper function that infers the line size. Each randomly-ordered block of
+// GEOMETRY_MAX_LINE bytes holds a pair of nodes some stride apart; while the
+// stride is shorter than the line size, both nodes share a line and only the
+// first access misses, so the average latency stays near halfway between a
+// hit and a miss. Once the stride reaches the line size, both accesses miss.
+// The working set is sized to miss the L1D but fit in the next level, so the
+// outer levels' (pair-fetching) prefetchers don't affect the result.
+static size_t LF(geometry_line_size)(void* buf, size_t working_set)
+{
+    int steps = 0;
+    double cycles[16];
+    for (size_t stride = GEOMETRY_MIN_LINE; stride < GEOMETRY_MAX_LINE;
+         stride *= 2)
+    {
+        cycles[steps] = LF(geometry_chase_blocks)(buf, working_set,
+                                                  GEOMETRY_MAX_LINE, stride, 2);
+        if (cycles[steps] == 0.0)
+        { return 0; }
+        steps++;
+    }
+
+    // the line size is the first stride whose latency is closer to the
+    // all-miss latency than to the shared-line latency
+    double shared = cycles[0];
+    double separate = cycles[steps - 1];
+    for (int i = 0; i < steps; i++)
+    {
+        if (cycles[i] > (shared + separate) / 2.0)
+        { return GEOMETRY_MIN_LINE << i; }
+    }
+    return 0;
+}
+
+// Helper function that infers a level's associativity by chasing through 'k'
+// lines spaced by the largest power of two no greater than its capacity. If
+// the level's number of sets is a power of two, that spacing is a multiple of
+// (sets * line_size), so every line maps to the same set, and the latency
+// jumps past 'threshold' once 'k' exceeds the number of ways.
+static size_t LF(geometry_ways)(void* buf, size_t max_size, size_t capacity,
+                                double threshold)
+{
+    size_t stride = 1;
+    while (stride * 2 <= capacity)
+    { stride *= 2; }
+
+    for (size_t k = 1; k <= GEOMETRY_MAX_WAYS && k * stride <= max_size; k++)
+    {
+        double cycles = PF(geometry_chase)(buf, k * stride, stride);
+        if (cycles == 0.0)
+        { return 0; }
+        if (cycles > threshold)
+        { return k > 1 ? k - 1 : 0; }
+    }
+    return 0;
+}
+
+PE(result_e) PF(geometry_probe)(PS(geometry_probe_t)* gp, size_t max_size)
+{
+    memset(gp, 0, sizeof(PS(geometry_probe_t)));
+    if (max_size < GEOMETRY_MIN_SIZE * 2)
+    { return LIBSCA_INVALID_INPUT; }
+    for (int i = 0; i < LIBSCA_CACHE_LEVEL_COUNT; i++)
+    { gp->levels[i].inclusive = -1; }
+
+    // huge pages keep TLB misses from adding jumps of their own to the curve,
+    // and give the associativity test control over more of the index bits
+    int flags = LIBSCA_MEM_HUGEPAGE | LIBSCA_MEM_POPULATE;
+    void* buf = LF(mem_map)(max_size, flags, NULL);
+    if (!buf)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    // sweep the working set sizes and split the curve into levels
+    PE(result_e) result = LF(geometry_sweep)(gp, buf, max_size);
+    if (result != LIBSCA_SUCCESS)
+    {
+        LF(mem_unmap)(buf, max_size, flags);
+        PF(geometry_free)(gp);
+        return result;
+    }
+    LF(geometry_plateaus)(gp);
+    if (gp->levels_found == 0)
+    {
+        LF(mem_unmap)(buf, max_size, flags);
+        PF(geometry_free)(gp);
+        return LIBSCA_FAILURE;
+    }
+
+    // the line size test needs a working set that misses the L1D but fits
+    // in the next level
+    size_t l1d_size = gp->levels[LIBSCA_CACHE_L1D].size;
+    size_t line_size = 0;
+    if (l1d_size * 4 <= max_size)
+    { line_size = LF(geometry_line_size)(buf, l1d_size * 4); }
+
+    for (size_t i = 0; i < gp->levels_found; i++)
+    {
+        PE(cache_level_e) level = LG(geometry_levels)[i];
+        PS(cache_geometry_t)* geo = &gp->levels[level];
+        geo->line_size = line_size;
+
+        // the LLC's sets are spread across hashed slices, so lines spaced by
+        // its capacity don't necessarily share a set
+        if (level == LIBSCA_CACHE_LLC)
+        { continue; }
+
+        // a lookup counts as a miss once it's closer to the next level's
+        // latency than this one's
+        double next = (i + 1 < gp->levels_found) ?
+                      gp->latencies[LG(geometry_levels)[i + 1]] :
+                      gp->memory_latency;
+        double threshold = (gp->latencies[level] + next) / 2.0;
+        geo->associativity = LF(geometry_ways)(buf, max_size, geo->size,
+                                               threshold);
+    }
+
+    LF(mem_unmap)(buf, max_size, flags);
+    return LIBSCA_SUCCESS;
+}
+
+void PF(geometry_apply)(PS(geometry_probe_t)* gp)
+{
+    PS(config_t)* conf = PF(config_get)();
+    for (int i = 0; i < LIBSCA_CACHE_LEVEL_COUNT; i++)
+    {
+        PS(cache_geometry_t)* src = &gp->levels[i];
+        PS(cache_geometry_t)* dst = &conf->cache_levels[i];
+        if (src->size == 0)
+        { continue; }
+
+        // any previously-reported set count no longer matches, so it's
+        // cleared to be derived from the new geometry
+        dst->size = src->size;
+        dst->sets = 0;
+        if (src->line_size)
+        { dst->line_size = src->line_size; }
+        if (src->associativity)
+        { dst->associativity = src->associativity; }
+    }
+}
+
+void PF(geometry_print)(PS(geometry_probe_t)* gp, FILE* fp)
+{
+    fprintf(fp, "Latency curve:\n");
+    for (size_t i = 0; i < gp->point_count; i++)
+    {
+        fprintf(fp, "  %10lu bytes  %8.2f cycles\n",
+                gp->points[i].working_set, gp->points[i].cycles);
+    }
+
+    static const char* names[LIBSCA_CACHE_LEVEL_COUNT] =
+    { "L1D", "L1I", "L2", "LLC" };
+    fprintf(fp, "Inferred geometry:\n");
+    for (size_t i = 0; i < gp->levels_found; i++)
+    {
+        PE(cache_level_e) level = LG(geometry_levels)[i];
+        PS(cache_geometry_t)* geo = &gp->levels[level];
+        fprintf(fp, "  %-4s %10lu bytes, ", names[level], geo->size);
+        if (geo->associativity)
+        { fprintf(fp, "%2lu-way, ", geo->associativity); }
+        else
+        { fprintf(fp, "  ?-way, "); }
+        fprintf(fp, "%lu-byte lines, %.2f cycles\n", geo->line_size,
+                gp->latencies[level]);
+    }
+    fprintf(fp, "  Memory %.2f cycles\n", gp->memory_latency);
+}
+
+void PF(geometry_free)(PS(geometry_probe_t)* gp)
+{
+    free(gp->points);
+    gp->points = NULL;
+    gp->point_count = 0;
+}
@@ -0,0 +1,69 @@
+// This module implements empirical cache geometry probing. When the system
+// misreports its cache hierarchy (as VMs and containers often do), the
+// geometry can instead be inferred from the latency of randomized
+// pointer-chasing traversals: the average access latency stays flat while a
+// working set fits in a cache level, then jumps once it spills into the next.
+
+#ifndef LIBSCA_GEOMETRY_H
+#define LIBSCA_GEOMETRY_H
+
+// Imports
+#include <stdio.h>
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+#include "config.h"
+
+
+// =========================== Geometry Probing ============================= //
+// A single point on a latency curve.
+typedef struct LS(latency_point)
+{
+    size_t working_set;         // size of the traversed working set (in bytes)
+    double cycles;              // average cycles per access
+} PS(latency_point_t);
+
+// The results of probing the cache geometry.
+typedef struct LS(geometry_probe)
+{
+    PS(latency_point_t)* points;    // latency-vs-size curve
+    size_t point_count;             // number of entries in 'points'
+    size_t levels_found;            // number of cache levels inferred
+    PS(cache_geometry_t) levels[LIBSCA_CACHE_LEVEL_COUNT]; // inferred geometry
+    double latencies[LIBSCA_CACHE_LEVEL_COUNT];  // access latency of each level
+    double memory_latency;          // access latency of main memory
+} PS(geometry_probe_t);
+
+// Measures the average latency (in cycles per access) of a randomized
+// pointer-chasing traversal over 'working_set' bytes of 'buf', visiting one
+// node every 'stride' bytes. Returns 0 if the parameters are invalid.
+double PF(geometry_chase)(void* buf, size_t working_set, size_t stride);
+
+// Probes the cache hierarchy, sweeping working sets from 4 KiB up to
+// 'max_size' bytes (which should be a few times larger than the last-level
+// cache), and infers the following for the data caches (L1D, L2, LLC):
+//  - The line size: from sequential traversals within randomly-ordered blocks,
+//    whose latency grows with the stride until it reaches the line size.
+//  - Each level's capacity and latency: from the plateaus (and the jumps
+//    between them) of the latency-vs-size curve.
+//  - Each level's associativity: by chasing through N lines spaced one
+//    capacity apart (which all map to the same set), and finding the smallest
+//    N that no longer fits. This relies on the set index bits being known,
+//    so it's skipped for the LLC (whose slices are hashed) and is only
+//    reliable for the L2 when huge pages are available.
+// Levels and fields that couldn't be inferred are left as zero.
+// The caller must free the results with 'geometry_free()'.
+// Returns a result enum.
+PE(result_e) PF(geometry_probe)(PS(geometry_probe_t)* gp, size_t max_size);
+
+// Writes every inferred (non-zero) field of the probe's results into the
+// library config.
+void PF(geometry_apply)(PS(geometry_probe_t)* gp);
+
+// Prints the probe's latency curve and inferred geometry to the given stream.
+void PF(geometry_print)(PS(geometry_probe_t)* gp, FILE* fp);
+
+// Frees the probe's memory.
+void PF(geometry_free)(PS(geometry_probe_t)* gp);
+
+#endif
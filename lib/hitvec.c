@@ -0,0 +1,158 @@
+// Implements the functions prototyped in hitvec.h.
+
+// Imports
+#include <string.h>
+
+// Local imports
+#include "isa.h"
+#include "hitvec.h"
+
+// ISA-specific imports
+#if (ISA == ISA_X86)
+#include <emmintrin.h>
+#endif
+
+
+// ============================== Hit Vectors =============================== //
+void PF(hitvec_clear)(PS(hitvec_t)* hv)
+{ memset(hv, 0, sizeof(PS(hitvec_t))); }
+
+void PF(hitvec_set)(PS(hitvec_t)* hv, unsigned int line)
+{ hv->words[line / 64] |= 1ul << (line % 64); }
+
+void PF(hitvec_unset)(PS(hitvec_t)* hv, unsigned int line)
+{ hv->words[line / 64] &= ~(1ul << (line % 64)); }
+
+int PF(hitvec_test)(PS(hitvec_t)* hv, unsigned int line)
+{ return (hv->words[line / 64] >> (line % 64)) & 0x1; }
+
+unsigned int PF(hitvec_popcount)(PS(hitvec_t)* hv)
+{
+    unsigned int count = 0;
+    for (int w = 0; w < LIBSCA_HITVEC_WORDS; w++)
+    { count += __builtin_popcountl(hv->words[w]); }
+    return count;
+}
+
+void PF(hitvec_and)(PS(hitvec_t)* dst, PS(hitvec_t)* a, PS(hitvec_t)* b)
+{
+    for (int w = 0; w < LIBSCA_HITVEC_WORDS; w++)
+    { dst->words[w] = a->words[w] & b->words[w]; }
+}
+
+void PF(hitvec_or)(PS(hitvec_t)* dst, PS(hitvec_t)* a, PS(hitvec_t)* b)
+{
+    for (int w = 0; w < LIBSCA_HITVEC_WORDS; w++)
+    { dst->words[w] = a->words[w] | b->words[w]; }
+}
+
+void PF(hitvec_andnot)(PS(hitvec_t)* dst, PS(hitvec_t)* a, PS(hitvec_t)* b)
+{
+    for (int w = 0; w < LIBSCA_HITVEC_WORDS; w++)
+    { dst->words[w] = a->words[w] & ~b->words[w]; }
+}
+
+int PF(hitvec_next)(PS(hitvec_t)* hv, unsigned int line)
+{
+    for (unsigned int w = line / 64; w < LIBSCA_HITVEC_WORDS; w++)
+    {
+        // mask off the bits below 'line' in its own word
+        uint64_t bits = hv->words[w];
+        if (w == line / 64)
+        { bits &= ~0ul << (line % 64); }
+        if (bits)
+        { return (int) (w * 64) + __builtin_ctzl(bits); }
+    }
+    return -1;
+}
+
+int PF(hitvec_last)(PS(hitvec_t)* hv)
+{
+    for (int w = LIBSCA_HITVEC_WORDS - 1; w >= 0; w--)
+    {
+        if (hv->words[w])
+        { return (w * 64) + 63 - __builtin_clzl(hv->words[w]); }
+    }
+    return -1;
+}
+
+
+// =========================== Score Accumulation =========================== //
+void PF(hitscore_reset)(PS(hitscore_t)* hs)
+{ memset(hs, 0, sizeof(PS(hitscore_t))); }
+
+#if (ISA == ISA_X86)
+// Lookup table that expands four bits of a hit vector into four 32-bit
+// increments (one per counter)
+#define HITSCORE_NIBBLE(n) \
+    {(n) & 0x1, ((n) >> 1) & 0x1, ((n) >> 2) & 0x1, ((n) >> 3) & 0x1}
+static const uint32_t LG(hitscore_nibbles)[16][4]
+    __attribute__((aligned(16))) = {
+    HITSCORE_NIBBLE(0),  HITSCORE_NIBBLE(1),  HITSCORE_NIBBLE(2),
+    HITSCORE_NIBBLE(3),  HITSCORE_NIBBLE(4),  HITSCORE_NIBBLE(5),
+    HITSCORE_NIBBLE(6),  HITSCORE_NIBBLE(7),  HITSCORE_NIBBLE(8),
+    HITSCORE_NIBBLE(9),  HITSCORE_NIBBLE(10), HITSCORE_NIBBLE(11),
+    HITSCORE_NIBBLE(12), HITSCORE_NIBBLE(13), HITSCORE_NIBBLE(14),
+    HITSCORE_NIBBLE(15)
+};
+#endif
+
+void PF(hitscore_add)(PS(hitscore_t)* hs, PS(hitvec_t)* hv)
+{
+    for (int w = 0; w < LIBSCA_HITVEC_WORDS; w++)
+    {
+        uint64_t bits = hv->words[w];
+        uint32_t* counts = hs->counts + (w * 64);
+
+        // most rounds hit only a handful of lines, so skip empty words
+        if (!bits)
+        { continue; }
+
+        #if (ISA == ISA_X86)
+        for (int n = 0; n < 16; n++)
+        {
+            __m128i* c = (__m128i*) (counts + (n * 4));
+            __m128i inc = _mm_load_si128(
+                (const __m128i*) LG(hitscore_nibbles)[(bits >> (n * 4)) & 0xf]);
+            _mm_store_si128(c, _mm_add_epi32(_mm_load_si128(c), inc));
+        }
+        #else
+        for (int b = 0; b < 64; b++)
+        { counts[b] += (bits >> b) & 0x1; }
+        #endif
+    }
+    hs->rounds++;
+}
+
+void PF(hitscore_merge)(PS(hitscore_t)* dst, PS(hitscore_t)* src)
+{
+    #if (ISA == ISA_X86)
+    for (int i = 0; i < LIBSCA_HITVEC_BITS; i += 4)
+    {
+        __m128i* d = (__m128i*) (dst->counts + i);
+        __m128i s = _mm_load_si128((const __m128i*) (src->counts + i));
+        _mm_store_si128(d, _mm_add_epi32(_mm_load_si128(d), s));
+    }
+    #else
+    for (int i = 0; i < LIBSCA_HITVEC_BITS; i++)
+    { dst->counts[i] += src->counts[i]; }
+    #endif
+    dst->rounds += src->rounds;
+}
+
+int PF(hitscore_best)(PS(hitscore_t)* hs, PS(hitvec_t)* ignore)
+{
+    int best = -1;
+    uint32_t best_count = 0;
+    for (int i = 0; i < LIBSCA_HITVEC_BITS; i++)
+    {
+        if (ignore && PF(hitvec_test)(ignore, (unsigned int) i))
+        { continue; }
+        if (hs->counts[i] > best_count)
+        {
+            best = i;
+            best_count = hs->counts[i];
+        }
+    }
+    return best;
+}
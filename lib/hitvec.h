@@ -0,0 +1,86 @@
+// This module implements hit vectors: fixed-size bitsets with one bit per
+// probed line (such as the 256 lines of a Flush+Reload probe array, one per
+// possible byte value), recording which lines were hits in a single round.
+// Hit vectors from many rounds are aggregated into a score accumulator, which
+// keeps one counter per line and adds a whole hit vector into them at once.
+
+#ifndef LIBSCA_HITVEC_H
+#define LIBSCA_HITVEC_H
+
+// Imports
+#include <stdint.h>
+#include "symbols.h"
+
+// Number of lines tracked by a hit vector (and a score accumulator)
+#define LIBSCA_HITVEC_BITS 256
+#define LIBSCA_HITVEC_WORDS (LIBSCA_HITVEC_BITS / 64)
+
+
+// ============================== Hit Vectors =============================== //
+// A set of line indexes, in [0, LIBSCA_HITVEC_BITS).
+typedef struct LS(hitvec)
+{
+    uint64_t words[LIBSCA_HITVEC_WORDS];
+} PS(hitvec_t);
+
+// Clears every bit of the hit vector.
+void PF(hitvec_clear)(PS(hitvec_t)* hv);
+
+// Sets the bit for the given line.
+void PF(hitvec_set)(PS(hitvec_t)* hv, unsigned int line);
+
+// Clears the bit for the given line.
+void PF(hitvec_unset)(PS(hitvec_t)* hv, unsigned int line);
+
+// Returns 1 if the bit for the given line is set, and 0 otherwise.
+int PF(hitvec_test)(PS(hitvec_t)* hv, unsigned int line);
+
+// Returns the number of set bits.
+unsigned int PF(hitvec_popcount)(PS(hitvec_t)* hv);
+
+// Stores the intersection of 'a' and 'b' (lines set in both) in 'dst'. 'dst'
+// may be the same as either input.
+void PF(hitvec_and)(PS(hitvec_t)* dst, PS(hitvec_t)* a, PS(hitvec_t)* b);
+
+// Stores the union of 'a' and 'b' (lines set in either) in 'dst'.
+void PF(hitvec_or)(PS(hitvec_t)* dst, PS(hitvec_t)* a, PS(hitvec_t)* b);
+
+// Stores the difference of 'a' and 'b' (lines set in 'a' but not in 'b') in
+// 'dst'.
+void PF(hitvec_andnot)(PS(hitvec_t)* dst, PS(hitvec_t)* a, PS(hitvec_t)* b);
+
+// Returns the index of the first set bit at or after 'line', or -1 if there
+// are none. This can be used to iterate over the set bits:
+//      for (int i = hitvec_next(hv, 0); i >= 0; i = hitvec_next(hv, i + 1))
+int PF(hitvec_next)(PS(hitvec_t)* hv, unsigned int line);
+
+// Returns the index of the highest set bit, or -1 if no bits are set.
+int PF(hitvec_last)(PS(hitvec_t)* hv);
+
+
+// =========================== Score Accumulation =========================== //
+// Per-line hit counts, accumulated over many rounds. The counters are kept
+// 16-byte aligned, so whole hit vectors can be added into them with SIMD.
+typedef struct LS(hitscore)
+{
+    uint32_t counts[LIBSCA_HITVEC_BITS] __attribute__((aligned(16)));
+    unsigned long rounds;       // number of hit vectors added
+} PS(hitscore_t);
+
+// Zeroes every counter.
+void PF(hitscore_reset)(PS(hitscore_t)* hs);
+
+// Increments the counter of every line set in the hit vector. On x86 this
+// uses SSE2, adding four counters per instruction.
+void PF(hitscore_add)(PS(hitscore_t)* hs, PS(hitvec_t)* hv);
+
+// Adds every counter (and the number of rounds) of 'src' into 'dst', such as
+// to combine the scores that separate threads accumulated.
+void PF(hitscore_merge)(PS(hitscore_t)* dst, PS(hitscore_t)* src);
+
+// Returns the line with the highest (non-zero) count, ignoring any lines set
+// in 'ignore' (which may be NULL). Ties go to the lowest line.
+// Returns -1 if every (non-ignored) count is zero.
+int PF(hitscore_best)(PS(hitscore_t)* hs, PS(hitvec_t)* ignore);
+
+#endif
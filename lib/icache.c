@@ -0,0 +1,183 @@
+// Implements the functions prototyped in icache.h.
+
+// Imports
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Local imports
+#include "isa.h"
+#include "libsca.h"
+#include "icache.h"
+#include "mem.h"
+
+// Number of sleds timed by each trial of 'collect_icache_timing()'
+#define ICACHE_TIMING_LINES 256
+
+// Opcodes used to generate sleds
+#if (ISA == ISA_X86)
+#define OPCODE_RET 0xc3
+#define OPCODE_NOP 0x90
+#define OPCODE_TRAP 0xcc
+#endif
+
+// Names of each sled (indexed by 'sled_e')
+static const char* LG(sled_names)[LIBSCA_SLED_COUNT] = {"ret", "nop"};
+
+
+// ============================== Code Regions ============================== //
+// Helper function that returns the size of an L1I line.
+static inline size_t LF(icache_line_size)()
+{ return PF(config_get)()->cache_levels[LIBSCA_CACHE_L1I].line_size; }
+
+PE(result_e) PF(icache_init)(PS(icache_t)* ic, size_t lines, size_t stride,
+                             PE(sled_e) sled)
+{
+    memset(ic, 0, sizeof(PS(icache_t)));
+    size_t line_size = LF(icache_line_size)();
+    if (lines == 0 || stride == 0 || stride % line_size != 0 ||
+        sled >= LIBSCA_SLED_COUNT)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // code regions are never backed by huge pages: sleds are meant to be
+    // spread across many pages, like the lines of a data measurement region
+    PS(config_t)* conf = PF(config_get)();
+    PE(result_e) result = PF(region_init)(&ic->region, lines * stride,
+                                          conf->mem_alloc_flags &
+                                          ~LIBSCA_MEM_HUGEPAGE);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+    ic->code = ic->region.base;
+    ic->lines = lines;
+    ic->stride = stride;
+    ic->sled = sled;
+
+    // write the sleds, then make the region executable (and read-only)
+    #if (ISA == ISA_X86)
+    memset(ic->code, OPCODE_TRAP, ic->region.size);
+    for (size_t i = 0; i < lines; i++)
+    {
+        uint8_t* line = ic->code + (i * stride);
+        if (sled == LIBSCA_SLED_NOP)
+        {
+            memset(line, OPCODE_NOP, line_size - 1);
+            line[line_size - 1] = OPCODE_RET;
+        }
+        else
+        { line[0] = OPCODE_RET; }
+    }
+    #else
+    #error "Unsupported ISA"
+    #endif
+    if (mprotect(ic->code, ic->region.size, PROT_READ | PROT_EXEC))
+    {
+        PF(region_free)(&ic->region);
+        memset(ic, 0, sizeof(PS(icache_t)));
+        return LIBSCA_FAILURE;
+    }
+    return LIBSCA_SUCCESS;
+}
+
+void PF(icache_free)(PS(icache_t)* ic)
+{
+    PF(region_free)(&ic->region);
+    memset(ic, 0, sizeof(PS(icache_t)));
+}
+
+void* PF(icache_line)(PS(icache_t)* ic, size_t index)
+{ return ic->code + (index * ic->stride); }
+
+void PF(icache_exec)(void* line)
+{ ((void (*)(void)) line)(); }
+
+unsigned long PF(icache_time)(void* line)
+{
+    void (*sled)(void) = (void (*)(void)) line;
+    unsigned long cycles1 = LF(mem_cycles)();
+    sled();
+    unsigned long cycles2 = LF(mem_cycles)();
+    return cycles2 - cycles1;
+}
+
+unsigned long PF(icache_flush)(void* line)
+{ return LF(mem_flush)(line); }
+
+void PF(icache_evict)(PS(icache_t)* ic, void* target)
+{
+    size_t line_size = LF(icache_line_size)();
+    size_t sets = PF(cache_sets)(LIBSCA_CACHE_L1I);
+    size_t set = ((uintptr_t) target / line_size) % sets;
+
+    // the L1I is virtually indexed, so a sled's set is given by its address
+    for (size_t i = 0; i < ic->lines; i++)
+    {
+        uint8_t* line = ic->code + (i * ic->stride);
+        if (((uintptr_t) line / line_size) % sets == set)
+        { PF(icache_exec)(line); }
+    }
+}
+
+const char* PF(sled_name)(PE(sled_e) sled)
+{
+    if (sled >= LIBSCA_SLED_COUNT)
+    { return NULL; }
+    return LG(sled_names)[sled];
+}
+
+PE(sled_e) PF(sled_parse)(const char* name)
+{
+    for (int i = 0; i < LIBSCA_SLED_COUNT; i++)
+    {
+        if (!strcmp(name, LG(sled_names)[i]))
+        { return (PE(sled_e)) i; }
+    }
+    return LIBSCA_SLED_COUNT;
+}
+
+
+// ============================= Code Timing ================================ //
+// Helper function that executes every sled in a 'collect_icache_timing()'
+// region once (so the timed calls don't include page walks or first-time
+// branch target lookups), then flushes them all.
+static void LF(icache_timing_flush)(void* arg)
+{
+    PS(icache_t)* ic = arg;
+    for (size_t i = 0; i < ic->lines; i++)
+    { PF(icache_exec)(PF(icache_line)(ic, i)); }
+    for (size_t i = 0; i < ic->lines; i++)
+    { PF(icache_flush)(PF(icache_line)(ic, i)); }
+}
+
+// Helper function that times one sled of a 'collect_icache_timing()' region
+// (misses and hits are timed the same way).
+static unsigned long LF(icache_timing_time)(size_t index, int miss, void* arg)
+{ return PF(icache_time)(PF(icache_line)((PS(icache_t)*) arg, index)); }
+
+PE(result_e) PF(collect_icache_timing)(PE(sled_e) sled,
+                                       unsigned int trials,
+                                       PS(dataset_t)* hits,
+                                       PS(dataset_t)* misses,
+                                       void (*callback)(unsigned long, unsigned long))
+{
+    if (trials == 0 || sled >= LIBSCA_SLED_COUNT)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // each sled gets its own page (at a staggered offset, so they spread
+    // across the L1I's sets), keeping the prefetchers from fetching one sled
+    // along with another
+    size_t stride = sysconf(_SC_PAGESIZE) + LF(icache_line_size)();
+    PS(icache_t) ic;
+    PE(result_e) result = PF(icache_init)(&ic, ICACHE_TIMING_LINES, stride,
+                                          sled);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+
+    result = LF(collect_pair_timing)(ICACHE_TIMING_LINES, trials,
+                                     LF(icache_timing_flush),
+                                     LF(icache_timing_time), &ic,
+                                     hits, misses, callback);
+
+    PF(icache_free)(&ic);
+    return result;
+}
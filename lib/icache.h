@@ -0,0 +1,102 @@
+// This module implements instruction-cache timing. Where the rest of the
+// library times data accesses, this times the execution of code: a region of
+// generated code is mapped with a small function ("sled") at the start of
+// each of its lines, and calling a line's sled fetches that line through the
+// L1 instruction cache. Timing the call tells whether the line was cached, so
+// the same Flush+Reload and eviction techniques used for data can be applied
+// to code (such as to measure code-layout effects, or whether a victim
+// executed a function).
+//
+// Two kinds of sleds can be generated: a lone 'ret' (the smallest possible
+// fetch), or a line of 'nop's ending in a 'ret' (which fetches and decodes
+// the whole line). The rest of the region is filled with 'int3's, so that
+// speculative fetches that run off the end of a sled stop right away.
+
+#ifndef LIBSCA_ICACHE_H
+#define LIBSCA_ICACHE_H
+
+// Imports
+#include <stddef.h>
+#include <stdint.h>
+#include "symbols.h"
+#include "error.h"
+#include "region.h"
+#include "stats.h"
+
+
+// ============================== Code Regions ============================== //
+// Enum representing the code generated at the start of each line.
+typedef enum LE(sled)
+{
+    LIBSCA_SLED_RET,            // a single 'ret'
+    LIBSCA_SLED_NOP,            // 'nop's filling the line, then a 'ret'
+    LIBSCA_SLED_COUNT,          // ------------------------------------------
+} PE(sled_e);
+
+// A region of generated code.
+typedef struct LS(icache)
+{
+    PS(region_t) region;        // the mapping (executable, and not writable)
+    uint8_t* code;              // base of the region's code
+    size_t lines;               // number of sleds
+    size_t stride;              // distance between sleds (in bytes)
+    PE(sled_e) sled;            // kind of sled at each line
+} PS(icache_t);
+
+// Maps a region of 'lines' sleds, 'stride' bytes apart (a multiple of the
+// L1I line size). Use a stride of one line for a buffer whose lines cover
+// every L1I set (such as for eviction), and a stride of a page plus a line to
+// keep the prefetchers (which work within a page) from fetching one sled off
+// the back of another.
+// The region must be freed with 'icache_free()'.
+// Returns a result enum.
+PE(result_e) PF(icache_init)(PS(icache_t)* ic, size_t lines, size_t stride,
+                             PE(sled_e) sled);
+
+// Frees the region's memory.
+void PF(icache_free)(PS(icache_t)* ic);
+
+// Returns the address of the sled at the given line.
+void* PF(icache_line)(PS(icache_t)* ic, size_t index);
+
+// Executes the sled at the given address (returned by 'icache_line()').
+void PF(icache_exec)(void* line);
+
+// Executes the sled at the given address, and returns the number of CPU clock
+// cycles it took (including the call and return).
+unsigned long PF(icache_time)(void* line);
+
+// Flushes the sled at the given address from every level of the cache (the
+// 'clflush' instruction invalidates instruction caches as well as data
+// caches). Returns the number of CPU clock cycles the flush took.
+unsigned long PF(icache_flush)(void* line);
+
+// Evicts the given address from the L1I by executing every sled in 'ic' that
+// maps to the same L1I set. For this to evict the line, 'ic' must have a
+// stride of one line and cover the L1I at least twice (so each set gets at
+// least twice its associativity of sleds).
+void PF(icache_evict)(PS(icache_t)* ic, void* target);
+
+// Returns a string name for the given sled (ex: "ret").
+// Returns NULL if the sled is invalid.
+const char* PF(sled_name)(PE(sled_e) sled);
+
+// Parses a sled's name (as returned by 'sled_name()').
+// Returns LIBSCA_SLED_COUNT if the name isn't recognized.
+PE(sled_e) PF(sled_parse)(const char* name);
+
+
+// ============================= Code Timing ================================ //
+// Performs the same measurements as 'collect_timing()', but for instruction
+// fetches: each sample is the time taken to execute a sled that was flushed
+// (a miss) and then to execute it again (a hit). The datasets are filtered
+// and use compact entries, as with 'collect_timing()', and must be freed
+// with 'dataset_free()'.
+// Returns a result enum.
+PE(result_e) PF(collect_icache_timing)(PE(sled_e) sled,
+                                       unsigned int trials,
+                                       PS(dataset_t)* hits,
+                                       PS(dataset_t)* misses,
+                                       void (*callback)(unsigned long, unsigned long));
+
+#endif
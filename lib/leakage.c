@@ -0,0 +1,366 @@
+// Implements the functions prototyped in leakage.h.
+
+// Imports
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Local imports
+#include "libsca.h"
+#include "leakage.h"
+#include "mem.h"
+
+// Latencies are capped at this (whatever the detector's ceiling), so each
+// one's square fits in 32 bits
+#define LEAKAGE_MAX_LATENCY 0xffff
+
+// Names of each mode (indexed by 'leakage_mode_e')
+static const char* LG(leakage_mode_names)[LIBSCA_LEAKAGE_MODE_COUNT] = {
+    "primeprobe", "flushreload"
+};
+
+
+// ============================ Leakage Detector ============================ //
+// Helper function that returns the size of an L1D line (the granularity at
+// which Flush+Reload monitors a buffer).
+static inline size_t LF(leakage_line_size)()
+{ return PF(config_get)()->cache_levels[LIBSCA_CACHE_L1D].line_size; }
+
+PE(result_e) PF(leakage_init)(PS(leakage_t)* lk,
+                              void (*fn)(const void* input, void* arg),
+                              void* arg,
+                              const void** inputs,
+                              size_t classes,
+                              PE(leakage_mode_e) mode,
+                              void* mem,
+                              size_t mem_size)
+{
+    memset(lk, 0, sizeof(PS(leakage_t)));
+    if (!fn || !inputs || classes < 2 || mode >= LIBSCA_LEAKAGE_MODE_COUNT ||
+        (mode == LIBSCA_LEAKAGE_FLUSHRELOAD && (!mem || mem_size == 0)))
+    { return LIBSCA_INVALID_INPUT; }
+
+    lk->fn = fn;
+    lk->arg = arg;
+    lk->inputs = inputs;
+    lk->classes = classes;
+    lk->mode = mode;
+    lk->ceiling = LIBSCA_LEAKAGE_CEILING;
+    if (mode == LIBSCA_LEAKAGE_PRIMEPROBE)
+    { lk->points = PF(cache_sets)(LIBSCA_CACHE_L1D); }
+    else
+    {
+        size_t line_size = LF(leakage_line_size)();
+        lk->mem = mem;
+        lk->mem_size = mem_size;
+        lk->points = (mem_size + line_size - 1) / line_size;
+    }
+
+    lk->traces = calloc(classes, sizeof(uint64_t));
+    lk->sums = calloc(classes * lk->points, sizeof(uint64_t));
+    lk->squares = calloc(classes * lk->points, sizeof(uint64_t));
+    lk->t = calloc(lk->points, sizeof(double));
+    lk->pairs = calloc(lk->points, sizeof(size_t));
+    if (!lk->traces || !lk->sums || !lk->squares || !lk->t || !lk->pairs)
+    {
+        PF(leakage_free)(lk);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+    return LIBSCA_SUCCESS;
+}
+
+// Arguments passed to each collection thread, along with its private sums.
+typedef struct LS(leakage_worker)
+{
+    unsigned int id;
+    PS(leakage_t)* lk;
+    size_t traces;
+    uint64_t* counts;
+    uint64_t* sums;
+    uint64_t* squares;
+    PE(result_e) result;
+} LS(leakage_worker_t);
+
+// Thread entry point: pins itself to a CPU, then collects its share of the
+// traces into its own sums.
+static void* LF(leakage_worker)(void* arg)
+{
+    LS(leakage_worker_t)* w = arg;
+    PS(leakage_t)* lk = w->lk;
+    size_t points = lk->points;
+    w->result = LIBSCA_SUCCESS;
+
+    // pin this thread to its own CPU
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    unsigned long* latencies = malloc(points * sizeof(unsigned long));
+    size_t* order = malloc(points * sizeof(size_t));
+    if (!latencies || !order)
+    {
+        free(latencies);
+        free(order);
+        w->result = LIBSCA_ALLOC_FAILURE;
+        return NULL;
+    }
+    for (size_t p = 0; p < points; p++)
+    { order[p] = p; }
+
+    // Prime+Probe watches this core's own L1D
+    PS(primeprobe_t) pp;
+    if (lk->mode == LIBSCA_LEAKAGE_PRIMEPROBE)
+    {
+        w->result = PF(primeprobe_init)(&pp);
+        if (w->result != LIBSCA_SUCCESS)
+        {
+            free(latencies);
+            free(order);
+            return NULL;
+        }
+        PF(primeprobe_prime)(&pp);
+    }
+
+    size_t line_size = LF(leakage_line_size)();
+    uint64_t ceiling = MIN(lk->ceiling, LEAKAGE_MAX_LATENCY);
+    uint64_t state = LF(mem_cycles)() ^ ((w->id + 1) * 0x9e3779b97f4a7c15ul);
+    for (size_t i = 0; i < w->traces; i++)
+    {
+        size_t c = PF(rand_next)(&state) % lk->classes;
+        if (lk->mode == LIBSCA_LEAKAGE_PRIMEPROBE)
+        {
+            // probing leaves every set primed for the next run
+            lk->fn(lk->inputs[c], lk->arg);
+            PF(primeprobe_probe_all)(&pp, latencies);
+        }
+        else
+        {
+            for (size_t p = 0; p < points; p++)
+            { LF(mem_flush)(lk->mem + (p * line_size)); }
+            lk->fn(lk->inputs[c], lk->arg);
+
+            // reload the lines in a fresh random order each run
+            PF(rand_shuffle)(order, points, &state);
+            for (size_t p = 0; p < points; p++)
+            {
+                size_t l = order[p];
+                latencies[l] = LF(mem_load_cycles)(lk->mem + (l * line_size),
+                                                   NULL);
+            }
+        }
+
+        uint64_t* sums = w->sums + (c * points);
+        uint64_t* squares = w->squares + (c * points);
+        for (size_t p = 0; p < points; p++)
+        {
+            uint64_t v = MIN(latencies[p], ceiling);
+            sums[p] += v;
+            squares[p] += v * v;
+        }
+        w->counts[c]++;
+    }
+
+    if (lk->mode == LIBSCA_LEAKAGE_PRIMEPROBE)
+    { PF(primeprobe_free)(&pp); }
+    free(latencies);
+    free(order);
+    return NULL;
+}
+
+PE(result_e) PF(leakage_collect)(PS(leakage_t)* lk, size_t traces,
+                                 unsigned int threads)
+{
+    if (threads == 0)
+    { return LIBSCA_INVALID_INPUT; }
+    threads = MIN(threads, traces > 0 ? traces : 1);
+
+    size_t entries = lk->classes * lk->points;
+    LS(leakage_worker_t)* workers = calloc(threads,
+                                           sizeof(LS(leakage_worker_t)));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    uint64_t* counts = calloc(threads * lk->classes, sizeof(uint64_t));
+    uint64_t* sums = calloc(threads * entries, sizeof(uint64_t));
+    uint64_t* squares = calloc(threads * entries, sizeof(uint64_t));
+    if (!workers || !tids || !counts || !sums || !squares)
+    {
+        free(workers);
+        free(tids);
+        free(counts);
+        free(sums);
+        free(squares);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+
+    // workers that run on this thread pin it to a CPU, so save its affinity
+    // to restore once we're done
+    cpu_set_t affinity;
+    int affinity_saved = !pthread_getaffinity_np(pthread_self(),
+                                                 sizeof(affinity), &affinity);
+
+    // spawn one worker per thread (the last one runs on this thread, as do any
+    // whose thread couldn't be created)
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        LS(leakage_worker_t)* w = &workers[t];
+        w->id = t;
+        w->lk = lk;
+        w->traces = (traces / threads) + (t < traces % threads);
+        w->counts = counts + (t * lk->classes);
+        w->sums = sums + (t * entries);
+        w->squares = squares + (t * entries);
+        if (t < threads - 1 &&
+            pthread_create(&tids[t], NULL, LF(leakage_worker), w))
+        {
+            tids[t] = 0;
+            LF(leakage_worker)(w);
+        }
+    }
+    LF(leakage_worker)(&workers[threads - 1]);
+
+    // wait for the workers, then add their sums into the detector's
+    PE(result_e) result = LIBSCA_SUCCESS;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        LS(leakage_worker_t)* w = &workers[t];
+        if (t < threads - 1 && tids[t])
+        { pthread_join(tids[t], NULL); }
+        if (w->result != LIBSCA_SUCCESS)
+        {
+            result = w->result;
+            continue;
+        }
+        for (size_t c = 0; c < lk->classes; c++)
+        { lk->traces[c] += w->counts[c]; }
+        for (size_t i = 0; i < entries; i++)
+        {
+            lk->sums[i] += w->sums[i];
+            lk->squares[i] += w->squares[i];
+        }
+    }
+    if (affinity_saved)
+    { pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity); }
+
+    free(workers);
+    free(tids);
+    free(counts);
+    free(sums);
+    free(squares);
+    return result;
+}
+
+// Helper function that computes the mean and (sample) variance of a point's
+// latencies in one class.
+static void LF(leakage_moments)(PS(leakage_t)* lk, size_t point, size_t c,
+                                long double* mean, long double* variance)
+{
+    long double n = lk->traces[c];
+    long double sum = lk->sums[(c * lk->points) + point];
+    long double squares = lk->squares[(c * lk->points) + point];
+    *mean = sum / n;
+    *variance = (squares - ((sum * sum) / n)) / (n - 1);
+}
+
+double PF(leakage_welch)(PS(leakage_t)* lk, size_t point, size_t a, size_t b)
+{
+    if (lk->traces[a] < 2 || lk->traces[b] < 2)
+    { return 0.0; }
+
+    long double mean_a, var_a, mean_b, var_b;
+    LF(leakage_moments)(lk, point, a, &mean_a, &var_a);
+    LF(leakage_moments)(lk, point, b, &mean_b, &var_b);
+    long double error = sqrtl((var_a / lk->traces[a]) +
+                              (var_b / lk->traces[b]));
+
+    // with no variance at all, any difference is a certain one
+    if (error <= 0.0)
+    {
+        if (mean_a == mean_b)
+        { return 0.0; }
+        return mean_a > mean_b ? HUGE_VAL : -HUGE_VAL;
+    }
+    return (double) ((mean_a - mean_b) / error);
+}
+
+size_t PF(leakage_analyze)(PS(leakage_t)* lk, double threshold)
+{
+    size_t flagged = 0;
+    for (size_t p = 0; p < lk->points; p++)
+    {
+        lk->t[p] = 0.0;
+        lk->pairs[p] = 1;
+        for (size_t a = 0; a < lk->classes; a++)
+        {
+            for (size_t b = a + 1; b < lk->classes; b++)
+            {
+                double t = PF(leakage_welch)(lk, p, a, b);
+                if (fabs(t) > fabs(lk->t[p]))
+                {
+                    lk->t[p] = t;
+                    lk->pairs[p] = (a * lk->classes) + b;
+                }
+            }
+        }
+        flagged += fabs(lk->t[p]) > threshold;
+    }
+    return flagged;
+}
+
+void PF(leakage_report)(PS(leakage_t)* lk, double threshold, FILE* out)
+{
+    int lines = lk->mode == LIBSCA_LEAKAGE_FLUSHRELOAD;
+    size_t line_size = LF(leakage_line_size)();
+    fprintf(out, "%10s %12s %8s %12s %12s\n", lines ? "offset" : "set", "t",
+            "classes", "mean a", "mean b");
+    for (size_t p = 0; p < lk->points; p++)
+    {
+        if (fabs(lk->t[p]) <= threshold)
+        { continue; }
+        size_t a = lk->pairs[p] / lk->classes;
+        size_t b = lk->pairs[p] % lk->classes;
+        long double mean_a, mean_b, variance;
+        LF(leakage_moments)(lk, p, a, &mean_a, &variance);
+        LF(leakage_moments)(lk, p, b, &mean_b, &variance);
+        if (lines)
+        { fprintf(out, "%#10lx ", p * line_size); }
+        else
+        { fprintf(out, "%10lu ", p); }
+        fprintf(out, "%12.2f %4lu:%-3lu %12.2Lf %12.2Lf\n", lk->t[p], a, b,
+                mean_a, mean_b);
+    }
+}
+
+const char* PF(leakage_mode_name)(PE(leakage_mode_e) mode)
+{
+    if (mode >= LIBSCA_LEAKAGE_MODE_COUNT)
+    { return NULL; }
+    return LG(leakage_mode_names)[mode];
+}
+
+PE(leakage_mode_e) PF(leakage_mode_parse)(const char* name)
+{
+    for (int i = 0; i < LIBSCA_LEAKAGE_MODE_COUNT; i++)
+    {
+        if (!strcmp(name, LG(leakage_mode_names)[i]))
+        { return (PE(leakage_mode_e)) i; }
+    }
+    return LIBSCA_LEAKAGE_MODE_COUNT;
+}
+
+void PF(leakage_free)(PS(leakage_t)* lk)
+{
+    free(lk->traces);
+    free(lk->sums);
+    free(lk->squares);
+    free(lk->t);
+    free(lk->pairs);
+    memset(lk, 0, sizeof(PS(leakage_t)));
+}
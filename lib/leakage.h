@@ -0,0 +1,122 @@
+// This module implements a constant-time leakage detector, for checking
+// whether a function's cache footprint depends on its (secret) input. The
+// function is run many times with inputs from two or more classes (such as
+// two different keys), chosen at random for each run, and each run is
+// measured either with Prime+Probe over every set of the L1 data cache or
+// with Flush+Reload over every line of a buffer the function reads (such as
+// a lookup table). A Welch's t-test is then applied to each set (or line),
+// as in the Test Vector Leakage Assessment (TVLA) methodology: a |t| above
+// 4.5 means the measurements of two classes differ with high confidence, so
+// the function leaks which class its input came from.
+//
+// Only sums and sums of squares are kept for each point, so any number of
+// traces can be collected without storing them, and the work can be split
+// among several threads (whose sums are added together at the end).
+
+#ifndef LIBSCA_LEAKAGE_H
+#define LIBSCA_LEAKAGE_H
+
+// Imports
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "symbols.h"
+#include "error.h"
+
+// The |t| above which a point is considered to leak (as in TVLA)
+#define LIBSCA_LEAKAGE_THRESHOLD 4.5
+// Default latency (in cycles) that measurements are clamped to
+#define LIBSCA_LEAKAGE_CEILING 1000
+
+
+// ============================ Leakage Detector ============================ //
+// Enum representing the ways each run of the function can be measured.
+typedef enum LE(leakage_mode)
+{
+    LIBSCA_LEAKAGE_PRIMEPROBE,  // Prime+Probe over every L1D set
+    LIBSCA_LEAKAGE_FLUSHRELOAD, // Flush+Reload over every line of a buffer
+    LIBSCA_LEAKAGE_MODE_COUNT,  // ------------------------------------------
+} PE(leakage_mode_e);
+
+// A leakage detector.
+typedef struct LS(leakage)
+{
+    // the function under test: called with one of the inputs each run
+    void (*fn)(const void* input, void* arg);
+    void* arg;                  // passed to every call
+    const void** inputs;        // one input per class
+    size_t classes;             // number of classes (at least 2)
+
+    // how each run is measured
+    PE(leakage_mode_e) mode;
+    uint8_t* mem;               // Flush+Reload: the buffer to monitor
+    size_t mem_size;            // Flush+Reload: the size of the buffer
+    size_t points;              // sets (or lines) measured per run
+    unsigned long ceiling;      // latencies above this are clamped to it
+
+    // per-class sums of each point's latencies (latencies are capped at
+    // 65535 cycles, so the sums can't overflow for billions of traces)
+    uint64_t* traces;           // traces collected, per class
+    uint64_t* sums;             // [class * points + point]
+    uint64_t* squares;          // [class * points + point]
+
+    // results of 'leakage_analyze()'
+    double* t;                  // per point: the t with the largest magnitude
+    size_t* pairs;              // per point: the classes it compares (a, b),
+                                // as '(a * classes) + b'
+} PS(leakage_t);
+
+// Initializes a detector for the given function, called with one of the
+// 'classes' inputs on each run. For LIBSCA_LEAKAGE_FLUSHRELOAD, 'mem' and
+// 'mem_size' give the buffer whose lines are monitored; they're ignored for
+// LIBSCA_LEAKAGE_PRIMEPROBE.
+// The detector must be freed with 'leakage_free()'.
+// Returns a result enum.
+PE(result_e) PF(leakage_init)(PS(leakage_t)* lk,
+                              void (*fn)(const void* input, void* arg),
+                              void* arg,
+                              const void** inputs,
+                              size_t classes,
+                              PE(leakage_mode_e) mode,
+                              void* mem,
+                              size_t mem_size);
+
+// Collects 'traces' more traces, split among 'threads' threads, each pinned
+// to its own CPU (so with Prime+Probe, each watches its own core's L1D). The
+// function under test must be safe to call from several threads at once.
+// Each trace's class is picked at random, so drift in the measurements over
+// time (and, with Flush+Reload, the other threads' runs touching the buffer)
+// adds noise to every class alike rather than showing up as a difference.
+// Latencies are clamped to the detector's 'ceiling' before they're added to
+// the sums: a single interrupt can take tens of thousands of cycles, and a
+// handful of those would swamp the variance of every point.
+// Returns a result enum.
+PE(result_e) PF(leakage_collect)(PS(leakage_t)* lk, size_t traces,
+                                 unsigned int threads);
+
+// Returns Welch's t for a single point, between classes 'a' and 'b'.
+// Returns 0 if either class has fewer than two traces.
+double PF(leakage_welch)(PS(leakage_t)* lk, size_t point, size_t a, size_t b);
+
+// Computes every point's t between every pair of classes, storing the one
+// with the largest magnitude (and the pair it compares) in 't' and 'pairs'.
+// Returns the number of points whose |t| exceeds 'threshold'.
+size_t PF(leakage_analyze)(PS(leakage_t)* lk, double threshold);
+
+// Prints each point whose |t| exceeds 'threshold' (as of the last call to
+// 'leakage_analyze()'), with its set index (or offset into the buffer), its
+// t, and the mean latency of each class it compares.
+void PF(leakage_report)(PS(leakage_t)* lk, double threshold, FILE* out);
+
+// Returns a string name for the given mode (ex: "primeprobe").
+// Returns NULL if the mode is invalid.
+const char* PF(leakage_mode_name)(PE(leakage_mode_e) mode);
+
+// Parses a mode's name (as returned by 'leakage_mode_name()').
+// Returns LIBSCA_LEAKAGE_MODE_COUNT if the name isn't recognized.
+PE(leakage_mode_e) PF(leakage_mode_parse)(const char* name);
+
+// Frees the detector's memory.
+void PF(leakage_free)(PS(leakage_t)* lk);
+
+#endif
@@ -4,37 +4,84 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#include <limits.h>
 #include "symbols.h"
+#include "libsca.h"
 #include "utils.h"
 #include "mem.h"
 #include "config.h"
 #include "stats.h"
+#include "topology.h"
 
 
 // ============================= Library Setup ============================== //
-int PF(init)()
+// Helper function that reads a cache level's geometry via sysconf() and writes
+// it into 'geo'. Levels that sysconf() doesn't describe (i.e. it reports zero
+// for them, as is common in containers) are left untouched.
+// Returns 1 if the level was filled in, and 0 otherwise.
+static int LF(init_level)(PS(cache_geometry_t)* geo,
+                          int size_name, int assoc_name, int lsize_name)
 {
-    // attempt to retrieve the L1 CPU data cache size
-    long l1d_size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
-    if (l1d_size < 0)
-    { return errno; }
-
-    // attempt to retrieve the L1 CPU data cache associativity
-    long l1d_assoc = sysconf(_SC_LEVEL1_DCACHE_ASSOC);
-    if (l1d_assoc < 0)
-    { return errno; }
-    
-    // attempt to retrieve the L1 CPU data cache line size
-    long l1d_lsize = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
-    if (l1d_lsize < 0)
-    { return errno; }
+    long size = sysconf(size_name);
+    long assoc = sysconf(assoc_name);
+    long lsize = sysconf(lsize_name);
+    if (size <= 0 || assoc <= 0 || lsize <= 0)
+    { return 0; }
 
-    // with these fields, update the initial library config state
+    geo->size = size;
+    geo->associativity = assoc;
+    geo->line_size = lsize;
+    geo->sets = 0;
+    return 1;
+}
+
+int PF(init)()
+{
     PS(config_t)* conf = PF(config_get)();
-    conf->cache_size = l1d_size;
-    conf->cache_associativity = l1d_assoc;
-    conf->cache_line_size = l1d_lsize;
+    PS(cache_geometry_t)* levels = conf->cache_levels;
+
+    // read the cache hierarchy from CPUID first (it's the only source that
+    // reports inclusiveness), then fill in any levels it missed from sysfs,
+    // which also reports the CPUs that share each level
+    int found = LF(topology_read_cpuid)(conf);
+    found |= LF(topology_read_sysfs)(conf, found);
+
+    // fall back to sysconf() for any levels neither source described
+    if (!(found & (1 << LIBSCA_CACHE_L1D)))
+    {
+        found |= LF(init_level)(&levels[LIBSCA_CACHE_L1D],
+                                _SC_LEVEL1_DCACHE_SIZE,
+                                _SC_LEVEL1_DCACHE_ASSOC,
+                                _SC_LEVEL1_DCACHE_LINESIZE) << LIBSCA_CACHE_L1D;
+    }
+    if (!(found & (1 << LIBSCA_CACHE_L1I)))
+    {
+        found |= LF(init_level)(&levels[LIBSCA_CACHE_L1I],
+                                _SC_LEVEL1_ICACHE_SIZE,
+                                _SC_LEVEL1_ICACHE_ASSOC,
+                                _SC_LEVEL1_ICACHE_LINESIZE) << LIBSCA_CACHE_L1I;
+    }
+    if (!(found & (1 << LIBSCA_CACHE_L2)))
+    {
+        found |= LF(init_level)(&levels[LIBSCA_CACHE_L2],
+                                _SC_LEVEL2_CACHE_SIZE,
+                                _SC_LEVEL2_CACHE_ASSOC,
+                                _SC_LEVEL2_CACHE_LINESIZE) << LIBSCA_CACHE_L2;
+    }
+    if (!(found & (1 << LIBSCA_CACHE_LLC)))
+    {
+        found |= LF(init_level)(&levels[LIBSCA_CACHE_LLC],
+                                _SC_LEVEL3_CACHE_SIZE,
+                                _SC_LEVEL3_CACHE_ASSOC,
+                                _SC_LEVEL3_CACHE_LINESIZE) << LIBSCA_CACHE_LLC;
+    }
+
+    // if the system has no L3, the L2 is the last-level cache
+    if (!(found & (1 << LIBSCA_CACHE_LLC)) && (found & (1 << LIBSCA_CACHE_L2)))
+    { levels[LIBSCA_CACHE_LLC] = levels[LIBSCA_CACHE_L2]; }
 
+    // any levels that still weren't found keep the config's defaults
     return 0;
 }
 
@@ -55,56 +102,133 @@ unsigned long PF(flush_write)(void* addr, char new_value)
 unsigned long PF(cycles)()
 { return LF(mem_cycles)(); }
 
+unsigned long PF(cycles_cpu)(unsigned int* cpu)
+{ return LF(mem_cycles_cpu)(cpu); }
+
 unsigned long PF(load)(void* src, char* byte)
 { return LF(mem_load_cycles)(src, byte); }
 
 unsigned long PF(store)(void* dst, char byte)
 { return LF(mem_store_cycles)(dst, byte); }
 
-PE(result_e) PF(collect_timing)(unsigned int trials,
-                                PS(dataset_t)* hits,
-                                PS(dataset_t)* misses,
-                                void (*callback)(unsigned long, unsigned long))
+unsigned long PF(prefetch)(void* addr)
+{ return LF(mem_prefetch_cycles)(addr); }
+
+unsigned long PF(prefetchnta)(void* addr)
+{ return LF(mem_prefetchnta_cycles)(addr); }
+
+unsigned long PF(prefetchw)(void* addr)
+{ return LF(mem_prefetchw_cycles)(addr); }
+
+unsigned long PF(probe)(void* addr, PE(probe_e) mode)
 {
-    // don't accept 0 as an input for number of trials
-    if (trials == 0)
-    { return LIBSCA_INVALID_INPUT; }
+    switch (mode)
+    {
+        case LIBSCA_PROBE_PREFETCH:
+            return LF(mem_prefetch_cycles)(addr);
+        case LIBSCA_PROBE_PREFETCHNTA:
+            return LF(mem_prefetchnta_cycles)(addr);
+        case LIBSCA_PROBE_PREFETCHW:
+            return LF(mem_prefetchw_cycles)(addr);
+        default:
+            return LF(mem_load_cycles)(addr, NULL);
+    }
+}
 
-    // set up a memory region to play with during this measurement
-    PS(config_t)* conf = PF(config_get)();
-    size_t mem_size_lines = 256;
-    void* mem = LF(mem_alloc_lines)(mem_size_lines);
-    if (!mem)
+unsigned long PF(probe_warm)(void* addr, PE(probe_e) mode)
+{
+    LF(mem_warm_page)(addr);
+    return PF(probe)(addr, mode);
+}
+
+// Probe mode names, indexed by the probe enum.
+static const char* LG(probe_names)[LIBSCA_PROBE_COUNT] = {
+    "load",
+    "prefetch",
+    "prefetchnta",
+    "prefetchw"
+};
+
+const char* PF(probe_name)(PE(probe_e) mode)
+{
+    if (mode < 0 || mode >= LIBSCA_PROBE_COUNT)
+    { return NULL; }
+    return LG(probe_names)[mode];
+}
+
+PE(probe_e) PF(probe_parse)(const char* name)
+{
+    for (int i = 0; i < LIBSCA_PROBE_COUNT; i++)
+    {
+        if (!strcmp(name, LG(probe_names)[i]))
+        { return (PE(probe_e)) i; }
+    }
+    return LIBSCA_PROBE_COUNT;
+}
+
+PE(result_e) LF(collect_pair_timing)(size_t lines, unsigned int trials,
+                                     void (*flush)(void* arg),
+                                     unsigned long (*time)(size_t index,
+                                                           int miss,
+                                                           void* arg),
+                                     void* arg,
+                                     PS(dataset_t)* hits,
+                                     PS(dataset_t)* misses,
+                                     void (*callback)(unsigned long, unsigned long))
+{
+    size_t* order = malloc(lines * sizeof(size_t));
+    if (!order)
     { return LIBSCA_ALLOC_FAILURE; }
-    
-    // set up datasets for recording data (this allocates a lot of memory at
-    // once...)
-    PF(dataset_init)(hits, mem_size_lines * trials);
-    PF(dataset_init)(misses, mem_size_lines * trials);
+    for (size_t i = 0; i < lines; i++)
+    { order[i] = i; }
+
+    // set up datasets for recording data. This allocates a lot of memory at
+    // once, so 16-bit entries are used (filtered samples almost never exceed
+    // 65534 cycles, and the rare one that does lands in the overflow table)
+    PF(dataset_init_width)(hits, lines * trials, sizeof(uint16_t));
+    PF(dataset_init_width)(misses, lines * trials, sizeof(uint16_t));
+
+    // interrupts and context switches produce huge outliers, so each dataset
+    // is filtered as it's collected
+    PS(filter_t) hit_filter;
+    PS(filter_t) miss_filter;
+    PF(filter_init)(&hit_filter);
+    PF(filter_init)(&miss_filter);
 
     // perform the same trial several times
     for (unsigned int t = 0; t < trials; t++)
     {
-        // first, flush all cache lines within the playground region
-        for (size_t i = 0; i < mem_size_lines; i++)
-        {
-            void* addr = ((char*) mem) + (i * conf->cache_line_size);
-            LF(mem_flush_overwrite(addr, 0x00));
-        }
-
-        // next, load all lines twice - once to measure thie miss time, another
-        // to measure the hit time
-        for (size_t i = 0; i < mem_size_lines; i++)
+        // first, get every target out of the cache
+        flush(arg);
+
+        // next, time each target twice - once to measure the miss time,
+        // another to measure the hit time. The targets are visited in a
+        // random order
+        __sync_synchronize();
+        PF(rand_shuffle)(order, lines, NULL);
+        for (size_t i = 0; i < lines; i++)
         {
-            void* addr = ((char*) mem) + (i * conf->cache_line_size);
-
-            // measure the miss access time
-            unsigned long miss_cycles = PF(load)(addr, NULL);
-            PF(dataset_add)(misses, miss_cycles);
-
-            // measure the hit access time
-            unsigned long hit_cycles = PF(load)(addr, NULL);
-            PF(dataset_add)(hits, hit_cycles);
+            // measure the miss time, then the hit time, noting which CPU
+            // we're on before and after
+            unsigned int cpu1, cpu2;
+            PF(cycles_cpu)(&cpu1);
+            unsigned long miss_cycles = time(order[i], 1, arg);
+            unsigned long hit_cycles = time(order[i], 0, arg);
+            PF(cycles_cpu)(&cpu2);
+
+            // if the thread migrated partway through, neither sample can be
+            // trusted (the target may have been measured in another core's
+            // cache)
+            if (cpu1 != cpu2)
+            {
+                misses->discarded++;
+                hits->discarded++;
+            }
+            else
+            {
+                PF(dataset_add_filtered)(misses, &miss_filter, miss_cycles);
+                PF(dataset_add_filtered)(hits, &hit_filter, hit_cycles);
+            }
 
             // if a callback function was given, invoke that now
             if (callback)
@@ -117,12 +241,92 @@ PE(result_e) PF(collect_timing)(unsigned int trials,
         // in between trials, yield the processor to add some delay
         PF(yield)();
     }
-    
-    // free the memory playground region and return
-    free(mem);
+
+    free(order);
     return LIBSCA_SUCCESS;
 }
 
+PE(result_e) PF(collect_timing)(unsigned int trials,
+                                PS(dataset_t)* hits,
+                                PS(dataset_t)* misses,
+                                void (*callback)(unsigned long, unsigned long))
+{
+    return PF(collect_probe_timing)(LIBSCA_PROBE_LOAD, trials,
+                                    hits, misses, callback);
+}
+
+// Lines probed by 'collect_probe_timing()', and how to probe them.
+typedef struct LS(probe_timing)
+{
+    PS(region_t) region;
+    size_t lines;
+    size_t stride;
+    PE(probe_e) mode;
+} LS(probe_timing_t);
+
+// Helper function that warms up the TLB (so the timed accesses don't include
+// page walks), then flushes every line of a 'collect_probe_timing()' region.
+static void LF(probe_timing_flush)(void* arg)
+{
+    LS(probe_timing_t)* pt = arg;
+    PF(region_warm)(&pt->region);
+    for (size_t i = 0; i < pt->lines; i++)
+    {
+        void* addr = ((char*) pt->region.base) + (i * pt->stride);
+        LF(mem_flush_overwrite)(addr, 0x00);
+    }
+}
+
+// Helper function that probes one line of a 'collect_probe_timing()' region.
+// 256 pages don't all fit in the first-level TLB, so the page's translation is
+// warmed before a miss is timed (otherwise misses pay for a page walk, or at
+// least a second-level TLB lookup, too).
+static unsigned long LF(probe_timing_time)(size_t index, int miss, void* arg)
+{
+    LS(probe_timing_t)* pt = arg;
+    void* addr = ((char*) pt->region.base) + (index * pt->stride);
+    if (miss)
+    { return PF(probe_warm)(addr, pt->mode); }
+    return PF(probe)(addr, pt->mode);
+}
+
+PE(result_e) PF(collect_probe_timing)(PE(probe_e) mode,
+                                      unsigned int trials,
+                                      PS(dataset_t)* hits,
+                                      PS(dataset_t)* misses,
+                                      void (*callback)(unsigned long, unsigned long))
+{
+    // don't accept 0 as an input for number of trials
+    if (trials == 0 || mode < 0 || mode >= LIBSCA_PROBE_COUNT)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // set up a memory region to play with during this measurement
+    PS(config_t)* conf = PF(config_get)();
+    size_t line_size = conf->cache_levels[LIBSCA_CACHE_L1D].line_size;
+
+    // each line gets its own page (at a staggered offset, so they spread
+    // across the L1D's sets); the hardware prefetchers work within a page, so
+    // this keeps them from fetching one line off the back of another's access
+    LS(probe_timing_t) pt;
+    pt.lines = 256;
+    pt.stride = sysconf(_SC_PAGESIZE) + line_size;
+    pt.mode = mode;
+    PE(result_e) result = PF(region_init)(&pt.region,
+                                          pt.lines * pt.stride,
+                                          conf->mem_alloc_flags);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+
+    result = LF(collect_pair_timing)(pt.lines, trials,
+                                     LF(probe_timing_flush),
+                                     LF(probe_timing_time), &pt,
+                                     hits, misses, callback);
+
+    // free the memory playground region and return
+    PF(region_free)(&pt.region);
+    return result;
+}
+
 unsigned long PF(calculate_threshold)(PS(dataset_t)* hits,
                                       PS(dataset_t)* misses)
 {
@@ -193,33 +397,210 @@ int PF(addr_collision_trial)(void* addr1, void* addr2,
 }
 
 
+// ========================= Latency Classification ========================= //
+// Number of target lines sampled per calibration round
+#define CLASSIFY_TARGETS 64
+
+static const char* LG(latency_names)[LIBSCA_LATENCY_COUNT] = {
+    "L1",
+    "L2",
+    "LLC",
+    "DRAM"
+};
+
+// Helper function that reads one byte from every line of a buffer, pushing
+// older lines out of any cache level smaller than it.
+static void LF(classify_sweep)(char* buf, size_t size, size_t line_size)
+{
+    for (size_t i = 0; i < size; i += line_size)
+    { *((volatile char*) (buf + i)); }
+}
+
+// Helper function that loads every target line (bringing them into the L1D),
+// then optionally sweeps a buffer to push them out to a lower level.
+static void LF(classify_place)(void** targets, char* sweep, size_t sweep_size,
+                               size_t line_size)
+{
+    for (int i = 0; i < CLASSIFY_TARGETS; i++)
+    { *((volatile char*) targets[i]); }
+    if (sweep)
+    { LF(classify_sweep)(sweep, sweep_size, line_size); }
+}
+
+PE(result_e) PF(classifier_calibrate)(PS(classifier_t)* cl,
+                                      PE(probe_e) mode,
+                                      unsigned int rounds)
+{
+    if (rounds == 0 || mode < 0 || mode >= LIBSCA_PROBE_COUNT)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // map the targets (each in its own page, at a different offset, so they
+    // spread across the L1D's sets) and a sweep buffer for each of the L1D
+    // and L2 that's twice the level's size
+    PS(config_t)* conf = PF(config_get)();
+    size_t line_size = conf->cache_levels[LIBSCA_CACHE_L1D].line_size;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t target_size = CLASSIFY_TARGETS * (page_size + line_size);
+    size_t l1_size = conf->cache_levels[LIBSCA_CACHE_L1D].size * 2;
+    size_t l2_size = conf->cache_levels[LIBSCA_CACHE_L2].size * 2;
+    PS(region_t) target_region;
+    char* l1_mem = NULL;
+    char* l2_mem = NULL;
+    PE(result_e) result = PF(region_init)(&target_region, target_size,
+                                          conf->mem_alloc_flags);
+    if (result != LIBSCA_SUCCESS)
+    { goto classifier_calibrate_cleanup; }
+    char* target_mem = target_region.base;
+    l1_mem = LF(mem_map)(l1_size, LIBSCA_MEM_POPULATE, NULL);
+    l2_mem = LF(mem_map)(l2_size, LIBSCA_MEM_POPULATE, NULL);
+    result = LIBSCA_ALLOC_FAILURE;
+    if (!l1_mem || !l2_mem)
+    { goto classifier_calibrate_cleanup; }
+
+    void* targets[CLASSIFY_TARGETS];
+    size_t order[CLASSIFY_TARGETS];
+    for (int i = 0; i < CLASSIFY_TARGETS; i++)
+    {
+        targets[i] = target_mem + (i * (page_size + line_size));
+        order[i] = (size_t) i;
+    }
+
+    PS(dataset_t) samples[LIBSCA_LATENCY_COUNT];
+    for (int l = 0; l < LIBSCA_LATENCY_COUNT; l++)
+    {
+        PF(dataset_init_width)(&samples[l], rounds * CLASSIFY_TARGETS,
+                               sizeof(uint16_t));
+    }
+
+    for (unsigned int r = 0; r < rounds; r++)
+    {
+        for (int l = 0; l < LIBSCA_LATENCY_COUNT; l++)
+        {
+            // pin every target to this level
+            if (l == LIBSCA_LATENCY_L1)
+            { LF(classify_place)(targets, NULL, 0, line_size); }
+            else if (l == LIBSCA_LATENCY_L2)
+            { LF(classify_place)(targets, l1_mem, l1_size, line_size); }
+            else if (l == LIBSCA_LATENCY_LLC)
+            { LF(classify_place)(targets, l2_mem, l2_size, line_size); }
+            else
+            {
+                for (int i = 0; i < CLASSIFY_TARGETS; i++)
+                { LF(mem_flush)(targets[i]); }
+            }
+
+            // then time a probe of each one, in a random order
+            __sync_synchronize();
+            PF(rand_shuffle)(order, CLASSIFY_TARGETS, NULL);
+            for (int i = 0; i < CLASSIFY_TARGETS; i++)
+            {
+                unsigned long cycles = PF(probe)(targets[order[i]], mode);
+                PF(dataset_add)(&samples[l], cycles);
+            }
+        }
+        PF(yield)();
+    }
+
+    // deeper levels can't be faster than shallower ones; if a level's median
+    // comes out lower (or equal), it can't be told apart from the one above it
+    cl->mode = mode;
+    for (int l = 0; l < LIBSCA_LATENCY_COUNT; l++)
+    {
+        unsigned long median = PF(dataset_median)(&samples[l]);
+        if (l > 0 && median < cl->medians[l - 1])
+        { median = cl->medians[l - 1]; }
+        cl->medians[l] = median;
+        PF(dataset_free)(&samples[l]);
+    }
+
+    // place each boundary halfway between neighboring medians; the last band
+    // is unbounded
+    for (int l = 0; l < LIBSCA_LATENCY_COUNT - 1; l++)
+    { cl->bounds[l] = (cl->medians[l] + cl->medians[l + 1]) / 2; }
+    cl->bounds[LIBSCA_LATENCY_COUNT - 1] = ULONG_MAX;
+    result = LIBSCA_SUCCESS;
+
+    classifier_calibrate_cleanup:
+    PF(region_free)(&target_region);
+    if (l1_mem)
+    { LF(mem_unmap)(l1_mem, l1_size, LIBSCA_MEM_POPULATE); }
+    if (l2_mem)
+    { LF(mem_unmap)(l2_mem, l2_size, LIBSCA_MEM_POPULATE); }
+    return result;
+}
+
+PE(latency_e) PF(classify)(PS(classifier_t)* cl, unsigned long cycles)
+{
+    for (int l = 0; l < LIBSCA_LATENCY_COUNT - 1; l++)
+    {
+        if (cycles <= cl->bounds[l])
+        { return (PE(latency_e)) l; }
+    }
+    return LIBSCA_LATENCY_DRAM;
+}
+
+void PF(classify_batch)(PS(classifier_t)* cl, unsigned long* cycles,
+                        size_t count, PE(latency_e)* levels, size_t* counts)
+{
+    if (counts)
+    { memset(counts, 0, LIBSCA_LATENCY_COUNT * sizeof(size_t)); }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        PE(latency_e) level = PF(classify)(cl, cycles[i]);
+        if (levels)
+        { levels[i] = level; }
+        if (counts)
+        { counts[level]++; }
+    }
+}
+
+const char* PF(latency_name)(PE(latency_e) level)
+{
+    if (level < 0 || level >= LIBSCA_LATENCY_COUNT)
+    { return NULL; }
+    return LG(latency_names)[level];
+}
+
+
 // ============================ Cache Arithmetic ============================ //
-size_t PF(addr_line_size)()
+size_t PF(cache_sets)(PE(cache_level_e) level)
+{
+    // use the reported number of sets, if we have it (it can't be derived
+    // for caches whose set count isn't a power of two, like sliced LLCs)
+    PS(config_t)* conf = PF(config_get)();
+    PS(cache_geometry_t)* geo = &conf->cache_levels[level];
+    if (geo->sets > 0)
+    { return geo->sets; }
+
+    size_t lines = geo->size / geo->line_size;
+    return lines / geo->associativity;
+}
+
+size_t PF(addr_line_size)(PE(cache_level_e) level)
 {
     // the "line offset" of an address is used to point to a specific byte
     // within a CPU cache line. It's calculated simply by finding the log base 2
     // of the cache line size (since we need that many bits to represent every
     // possible byte in the line)
     PS(config_t)* conf = PF(config_get)();
-    return (size_t) LF(log2)(conf->cache_line_size - 1);
+    return (size_t) LF(log2)(conf->cache_levels[level].line_size - 1);
 }
 
-size_t PF(addr_set_size)()
+size_t PF(addr_set_size)(PE(cache_level_e) level)
 {
     // the "set index" dictates what cache set a given address is placed into in
     // the CPU cache. It requires 2^S bits of a memory address, where S
     // represents the number of sets in the cache. So, to find the number of
     // bits required, we first must compute the number of cache sets:
-    PS(config_t)* conf = PF(config_get)();
-    size_t lines = conf->cache_size / conf->cache_line_size;
-    size_t sets = lines / conf->cache_associativity;
+    size_t sets = PF(cache_sets)(level);
 
     // with this value, we can simply take the log base 2 to determine how many
     // bits it would take to represent the number of available sets
     return (size_t) LF(log2)(sets - 1);
 }
 
-size_t PF(addr_tag_size)()
+size_t PF(addr_tag_size)(PE(cache_level_e) level)
 {
     // the "tag" of an address is comprised all all the remaining bits that
     // aren't a part of the "set index" or "line offset". It's used to determine
@@ -227,41 +608,41 @@ size_t PF(addr_tag_size)()
     // calculate this simply by subtracting the other two metrics' sizes from
     // the size of this system's memory addresses
     size_t addrsize = sizeof(void*) * 8;
-    size_t set_index_size = PF(addr_set_size)();
-    size_t line_offset_size = PF(addr_line_size)();
+    size_t set_index_size = PF(addr_set_size)(level);
+    size_t line_offset_size = PF(addr_line_size)(level);
     return addrsize - (set_index_size + line_offset_size);
 }
 
-long PF(addr_line_bits)(void* addr)
+long PF(addr_line_bits)(void* addr, PE(cache_level_e) level)
 {
     // build a bitmask that places 1s on the bits we want to extract (the low
     // bits of the address)
-    size_t s = PF(addr_line_size)();
+    size_t s = PF(addr_line_size)(level);
     size_t mask = LF(bitmask)(0, s - 1);
 
     // AND with the mask and return
     return (int) ((size_t) addr & mask);
 }
 
-long PF(addr_set_bits)(void* addr)
+long PF(addr_set_bits)(void* addr, PE(cache_level_e) level)
 {
     // build a bitmask that places 1s on the bits we want to extract (the middle
     // bits between the line offset and tag)
-    size_t size = PF(addr_set_size)();
-    size_t los = PF(addr_line_size)();
+    size_t size = PF(addr_set_size)(level);
+    size_t los = PF(addr_line_size)(level);
     size_t mask = LF(bitmask)(los, los + (size - 1));
 
     // AND with the mask, shift down, and return
     return (int) (((size_t) addr & mask) >> los);
 }
 
-long PF(addr_tag_bits)(void* addr)
+long PF(addr_tag_bits)(void* addr, PE(cache_level_e) level)
 {
     // build a bitmask that places 1s on the bits we want to extract (the high
     // bits after the set index)
-    size_t size = PF(addr_tag_size)();
-    size_t los = PF(addr_line_size)();
-    size_t sis = PF(addr_set_size)();
+    size_t size = PF(addr_tag_size)(level);
+    size_t los = PF(addr_line_size)(level);
+    size_t sis = PF(addr_set_size)(level);
     size_t shift = los + sis;
     size_t mask = LF(bitmask)(shift, shift + size - 1);
 
@@ -269,21 +650,19 @@ long PF(addr_tag_bits)(void* addr)
     return (long) (((size_t) addr & mask) >> shift);
 }
 
-int PF(addr_collision_check)(void* addr1, void* addr2)
+int PF(addr_collision_check)(void* addr1, void* addr2, PE(cache_level_e) level)
 {
     // two addresses will collide in the cache if they have the same set index
     // and the same tag
-    long tag1 = PF(addr_tag_bits)(addr1);
-    long tag2 = PF(addr_tag_bits)(addr2);
+    long tag1 = PF(addr_tag_bits)(addr1, level);
+    long tag2 = PF(addr_tag_bits)(addr2, level);
     if (tag1 != tag2)
     { return 0; }
 
-    long set1 = PF(addr_set_bits)(addr1);
-    long set2 = PF(addr_set_bits)(addr2);
+    long set1 = PF(addr_set_bits)(addr1, level);
+    long set2 = PF(addr_set_bits)(addr2, level);
     if (set1 != set2)
     { return 0; }
 
     return 1;
 }
-
-
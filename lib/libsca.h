@@ -12,10 +12,22 @@
 #include "config.h"
 #include "stats.h"
 #include "utils.h"
+#include "pagemap.h"
+#include "slice.h"
+#include "evset.h"
+#include "primeprobe.h"
+#include "geometry.h"
+#include "region.h"
+#include "hitvec.h"
 
 
 // ============================= Library Setup ============================== //
-// Initializes the library. Returns 0 on success or an error number on failure.
+// Initializes the library. This discovers the CPU cache hierarchy (using the
+// CPUID instruction, sysfs, and sysconf(), in that order of preference) and
+// stores each level's geometry in the library config. A level is taken from
+// the first source that describes it; levels that can't be discovered keep the
+// config's defaults.
+// Always returns 0.
 int PF(init)();
 
 
@@ -31,9 +43,28 @@ unsigned long PF(flush_write)(void* addr, char new_value);
 
 
 // ======================= Cache Timing Measurements ======================== //
+// Enum representing the instructions that can be used to probe the state of a
+// cache line. Loads must wait for their data to arrive, while prefetches
+// don't retire a load at all, so prefetch-based probes (i.e. Prefetch+Reload)
+// can be issued back-to-back at a much higher rate.
+typedef enum LE(probe)
+{
+    LIBSCA_PROBE_LOAD,          // timed load
+    LIBSCA_PROBE_PREFETCH,      // timed 'prefetcht0'
+    LIBSCA_PROBE_PREFETCHNTA,   // timed 'prefetchnta'
+    LIBSCA_PROBE_PREFETCHW,     // timed 'prefetchw'
+    LIBSCA_PROBE_COUNT,         // ------------------------------------------
+} PE(probe_e);
+
 // Retrieves the current processor cycle count and returns it.
 unsigned long PF(cycles)();
 
+// Retrieves the current processor cycle count and returns it, writing the ID
+// of the CPU it was read on into '*cpu'. Bracketing a measurement with two
+// calls reveals whether the thread migrated to another CPU partway through
+// (in which case the measurement should be discarded).
+unsigned long PF(cycles_cpu)(unsigned int* cpu);
+
 // Loads a single byte of memory from 'src' into '*byte'. The number of CPU
 // clock cycles the load takes is recorded and returned.
 // If 'byte' is NULL, it won't be touched.
@@ -43,6 +74,36 @@ unsigned long PF(load)(void* src, char* byte);
 // the store takes is recorded and returned.
 unsigned long PF(store)(void* dst, char byte);
 
+// Issues a software prefetch ('prefetcht0') for the given address. The number
+// of CPU clock cycles the prefetch takes is recorded and returned.
+unsigned long PF(prefetch)(void* addr);
+
+// Issues a non-temporal software prefetch ('prefetchnta') for the given
+// address. The number of CPU clock cycles the prefetch takes is returned.
+unsigned long PF(prefetchnta)(void* addr);
+
+// Issues a software prefetch with intent to write ('prefetchw') for the given
+// address. The number of CPU clock cycles the prefetch takes is returned.
+unsigned long PF(prefetchw)(void* addr);
+
+// Probes the given address using the instruction specified by 'mode' and
+// returns the number of CPU clock cycles it took.
+unsigned long PF(probe)(void* addr, PE(probe_e) mode);
+
+// Performs the same probe as 'probe()', but first warms the TLB entry for the
+// address' page (by loading from another line of the page, so the probed line
+// itself isn't cached). The timed probe then never includes a page walk, which
+// otherwise makes misses to pages outside the TLB look slower than they are.
+unsigned long PF(probe_warm)(void* addr, PE(probe_e) mode);
+
+// Returns a string name for the given probe mode (ex: "load", "prefetch").
+// Returns NULL if the mode is invalid.
+const char* PF(probe_name)(PE(probe_e) mode);
+
+// Parses a probe mode from the given string (using the names returned by
+// 'probe_name()'). Returns LIBSCA_PROBE_COUNT if the name isn't recognized.
+PE(probe_e) PF(probe_parse)(const char* name);
+
 // Performs a large number of memory accesses and cache flushes to measure and
 // return statistics on cache hit/miss timing.
 // The 'trials' parameter indicates the number of trials to perform. The more
@@ -52,6 +113,11 @@ unsigned long PF(store)(void* dst, char byte);
 // collection. Each dataset will contain a number of measurements (in CPU
 // cycles) for cache hits and cache misses. The dataset API can be used to
 // compute statistics on this data.
+// Samples are passed through an outlier filter (see 'filter_accept()') as
+// they're collected, and pairs taken while the thread migrated between CPUs
+// are dropped; each dataset's 'discarded' field counts the samples rejected.
+// The datasets use compact 16-bit entries, so read them through the dataset
+// functions (such as 'dataset_get()') rather than their 'data' arrays.
 // The caller is responsible for invoking dataset_free() on each of the returned
 // datasets.
 // The 'callback' function, if non-NULL, will be invoked each time a measurement
@@ -63,6 +129,33 @@ PE(result_e) PF(collect_timing)(unsigned int trials,
                                 PS(dataset_t)* misses,
                                 void (*callback)(unsigned long, unsigned long));
 
+// Performs the same measurements as 'collect_timing()', but uses the given
+// probe mode to take each measurement. This is used to calibrate a hit/miss
+// threshold for prefetch-based probes, whose timings differ greatly from
+// those of loads.
+PE(result_e) PF(collect_probe_timing)(PE(probe_e) mode,
+                                      unsigned int trials,
+                                      PS(dataset_t)* hits,
+                                      PS(dataset_t)* misses,
+                                      void (*callback)(unsigned long, unsigned long));
+
+// Helper function that takes the samples for the timing collection functions
+// (such as 'collect_probe_timing()'). Each of the 'trials' trials calls
+// 'flush()' to get all 'lines' targets out of the cache, then visits the
+// targets in a random order and calls 'time()' on each one twice: first with
+// 'miss' set, then without. The datasets are initialized, filtered, and
+// passed to 'callback' as described for 'collect_timing()'.
+// Returns a result enum.
+PE(result_e) LF(collect_pair_timing)(size_t lines, unsigned int trials,
+                                     void (*flush)(void* arg),
+                                     unsigned long (*time)(size_t index,
+                                                           int miss,
+                                                           void* arg),
+                                     void* arg,
+                                     PS(dataset_t)* hits,
+                                     PS(dataset_t)* misses,
+                                     void (*callback)(unsigned long, unsigned long));
+
 // Takes in datasets of cache hit and cache miss times (such as the ones
 // returned from collect_timing()) and estimates a threshold to use when determining
 // if a timed memory load was a cache hit or not.
@@ -79,35 +172,100 @@ int PF(addr_collision_trial)(void* addr1, void* addr2,
                              unsigned int trials);
 
 
+// ========================= Latency Classification ========================= //
+// Enum representing where in the memory hierarchy a probed line was found.
+typedef enum LE(latency)
+{
+    LIBSCA_LATENCY_L1,          // L1 data cache hit
+    LIBSCA_LATENCY_L2,          // L2 cache hit
+    LIBSCA_LATENCY_LLC,         // last-level cache hit
+    LIBSCA_LATENCY_DRAM,        // served from main memory
+    LIBSCA_LATENCY_COUNT,       // ------------------------------------------
+} PE(latency_e);
+
+// A multi-level latency classifier. Rather than a single hit/miss threshold,
+// this holds a band of probe latencies (in cycles) for each level: a sample
+// belongs to the first level whose upper bound it doesn't exceed.
+typedef struct LS(classifier)
+{
+    PE(probe_e) mode;                               // calibrated probe mode
+    unsigned long medians[LIBSCA_LATENCY_COUNT];    // median of each level
+    unsigned long bounds[LIBSCA_LATENCY_COUNT];     // upper bound of each band
+} PS(classifier_t);
+
+// Calibrates the classifier for the given probe mode by timing accesses to
+// lines pinned in each level: lines are loaded and probed again (L1), loaded
+// then pushed out of the L1D by sweeping a buffer twice its size (L2), loaded
+// then pushed out of the L2 the same way (LLC), or flushed (DRAM).
+// Each of the 'rounds' rounds takes one sample per level from each of a
+// number of target lines. The bands' boundaries are placed halfway between
+// neighboring levels' medians. (Levels that can't be told apart, such as L1
+// and L2 under some prefetch probes, end up with an empty band.)
+// Returns a result enum.
+PE(result_e) PF(classifier_calibrate)(PS(classifier_t)* cl,
+                                      PE(probe_e) mode,
+                                      unsigned int rounds);
+
+// Classifies a single probe latency and returns the level it belongs to.
+PE(latency_e) PF(classify)(PS(classifier_t)* cl, unsigned long cycles);
+
+// Classifies 'count' probe latencies, writing each one's level into 'levels'
+// (if non-NULL) and the number of samples in each level into 'counts' (if
+// non-NULL; it must hold LIBSCA_LATENCY_COUNT entries).
+void PF(classify_batch)(PS(classifier_t)* cl, unsigned long* cycles,
+                        size_t count, PE(latency_e)* levels, size_t* counts);
+
+// Returns a string name for the given level (ex: "L1", "DRAM").
+// Returns NULL if the level is invalid.
+const char* PF(latency_name)(PE(latency_e) level);
+
+
 // ============================ Cache Arithmetic ============================ //
+// The functions below take the cache level to compute values for. They operate
+// on virtual addresses, which is only accurate for the virtually-indexed L1
+// caches (whose set index bits lie within the page offset). For the L2 and
+// LLC, use the pagemap (and slice) functions, which translate addresses to
+// physical addresses first.
+
+// Computes and returns the number of sets in the given cache level, based on
+// the library's config fields.
+size_t PF(cache_sets)(PE(cache_level_e) level);
+
 // Computes and returns the number of bits required to represent the cache line
 // offset for a memory address, based on the library's config fields.
-size_t PF(addr_line_size)();
+size_t PF(addr_line_size)(PE(cache_level_e) level);
 
 // Computes and returns the number of bits required to represent the cache set
 // index for a memory address, based on the library's config fields.
-size_t PF(addr_set_size)();
+size_t PF(addr_set_size)(PE(cache_level_e) level);
 
 // Computes and returns the number of bits required to represent the cache tag
 // for a memory address, based on the library's config fields.
-size_t PF(addr_tag_size)();
+size_t PF(addr_tag_size)(PE(cache_level_e) level);
 
 // Extracts and returns the bits from the given address that represent the CPU
 // cache line offset.
-long PF(addr_line_bits)(void* addr);
+long PF(addr_line_bits)(void* addr, PE(cache_level_e) level);
 
 // Extracts and returns the bits from the given address that represent the CPU
 // cache set index.
-long PF(addr_set_bits)(void* addr);
+long PF(addr_set_bits)(void* addr, PE(cache_level_e) level);
 
 // Extracts and returns the bits from the given address that represent the CPU
 // cache tag.
-long PF(addr_tag_bits)(void* addr);
+long PF(addr_tag_bits)(void* addr, PE(cache_level_e) level);
 
 // Examines two addresses and uses arithmetic to determine if the two addresses
-// will collide in the CPU cache.
+// will collide in the given level of the CPU cache.
 // Returns 1 if they collide, and 0 if not.
-int PF(addr_collision_check)(void* addr1, void* addr2);
+int PF(addr_collision_check)(void* addr1, void* addr2, PE(cache_level_e) level);
 
-#endif
+// Modules built on top of the API above
+#include "spectre.h"
+#include "channel.h"
+#include "leakage.h"
+#include "footprint.h"
+#include "icache.h"
+#include "tlb.h"
 
+#endif
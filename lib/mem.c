@@ -4,6 +4,9 @@
 
 // Standard imports
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 // Local imports
 #include "isa.h"
@@ -15,12 +18,115 @@
 #include <x86intrin.h>
 #endif
 
+// MAP_HUGETLB maps pages of the system's default huge page size (which may be
+// 1 GiB) unless a size is encoded in the flags, so 2 MiB is always requested
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
 
 // =========================== Memory Allocation ============================ //
 void* LF(mem_alloc_lines)(size_t size_lines)
 {
     PS(config_t)* config = PF(config_get)();
-    return malloc(size_lines * config->cache_line_size);
+    return LF(mem_map)(size_lines * config->cache_levels[LIBSCA_CACHE_L1D].line_size,
+                       config->mem_alloc_flags, NULL);
+}
+
+void LF(mem_free_lines)(void* mem, size_t size_lines)
+{
+    PS(config_t)* config = PF(config_get)();
+    LF(mem_unmap)(mem, size_lines * config->cache_levels[LIBSCA_CACHE_L1D].line_size,
+                  config->mem_alloc_flags);
+}
+
+size_t LF(mem_map_size)(size_t size_bytes, int flags)
+{
+    // round up to a multiple of the page size we're using (huge-page-backed
+    // regions must be a multiple of the huge page size)
+    size_t align = flags & LIBSCA_MEM_HUGEPAGE ?
+                   LIBSCA_HUGEPAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = ((size_bytes + align - 1) / align) * align;
+    return size > 0 ? size : align;
+}
+
+void* LF(mem_map)(size_t size_bytes, int flags, int* mapped_huge)
+{
+    size_t size = LF(mem_map_size)(size_bytes, flags);
+    int prot = PROT_READ | PROT_WRITE;
+    int mflags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (flags & LIBSCA_MEM_POPULATE)
+    { mflags |= MAP_POPULATE; }
+    if (mapped_huge)
+    { *mapped_huge = 0; }
+
+    uint8_t* mem = MAP_FAILED;
+    if (flags & LIBSCA_MEM_HUGEPAGE)
+    {
+        // first, try to map explicitly-reserved 2 MiB huge pages. This fails
+        // if the system doesn't have enough of them reserved
+        mem = mmap(NULL, size, prot, mflags | MAP_HUGETLB | MAP_HUGE_2MB,
+                   -1, 0);
+        if (mem != MAP_FAILED && mapped_huge)
+        { *mapped_huge = 1; }
+
+        // otherwise, fall back to regular pages. We over-allocate by one huge
+        // page so we can trim the region down to a 2 MiB-aligned one, which
+        // is required for the kernel to use transparent huge pages for it
+        if (mem == MAP_FAILED)
+        {
+            size_t extra = LIBSCA_HUGEPAGE_SIZE;
+            uint8_t* raw = mmap(NULL, size + extra, prot,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED)
+            { return NULL; }
+
+            // unmap the unaligned head and the leftover tail
+            uintptr_t aligned = ((uintptr_t) raw + extra - 1) & ~(extra - 1);
+            size_t head = aligned - (uintptr_t) raw;
+            if (head > 0)
+            { munmap(raw, head); }
+            if (extra - head > 0)
+            { munmap((uint8_t*) aligned + size, extra - head); }
+            mem = (uint8_t*) aligned;
+
+            #ifdef MADV_HUGEPAGE
+            madvise(mem, size, MADV_HUGEPAGE);
+            #endif
+        }
+    }
+    else
+    { mem = mmap(NULL, size, prot, mflags, -1, 0); }
+
+    if (mem == MAP_FAILED)
+    { return NULL; }
+
+    // MAP_POPULATE isn't guaranteed to fault in writable pages (and wasn't
+    // used at all for the fallback mapping above), so write to every page
+    // to make sure each one is backed by its own physical frame
+    if (flags & LIBSCA_MEM_POPULATE)
+    {
+        size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+        for (size_t off = 0; off < size; off += page_size)
+        { mem[off] = 0; }
+    }
+
+    // lock the pages into memory, if requested (we don't treat failure as
+    // fatal; the region is still usable, just swappable)
+    if (flags & LIBSCA_MEM_LOCK)
+    { mlock(mem, size); }
+
+    return mem;
+}
+
+void LF(mem_unmap)(void* mem, size_t size_bytes, int flags)
+{
+    if (!mem)
+    { return; }
+    munmap(mem, LF(mem_map_size)(size_bytes, flags));
 }
 
 void* LF(mem_alloc_bytes)(size_t size_bytes)
@@ -51,6 +157,20 @@ unsigned long LF(mem_flush_overwrite)(void* addr, char new_value)
     return LF(mem_flush)(addr);
 }
 
+void LF(mem_warm_page)(void* addr)
+{
+    uintptr_t half = (uintptr_t) sysconf(_SC_PAGESIZE) / 2;
+    *(volatile char*) ((uintptr_t) addr ^ half);
+
+    // wait for the load to finish, so the translation is in place before
+    // whatever the caller times next
+    #if (ISA == ISA_X86)
+    _mm_lfence();
+    #else
+    #error "Unsupported ISA"
+    #endif
+}
+
 
 // ============================= Timed Accesses ============================= //
 unsigned long LF(mem_cycles)()
@@ -68,6 +188,21 @@ unsigned long LF(mem_cycles)()
     return (unsigned long) cycles;
 }
 
+unsigned long LF(mem_cycles_cpu)(unsigned int* cpu)
+{
+    register uint64_t cycles = 0;
+
+    #if (ISA == ISA_X86)
+    unsigned int aux = 0;
+    cycles = __rdtscp(&aux);
+    *cpu = aux & 0xfff;
+    #else
+    #error "Unsupported ISA"
+    #endif
+
+    return (unsigned long) cycles;
+}
+
 // Timed load.
 unsigned long LF(mem_load_cycles)(void* src, char* byte)
 {
@@ -115,3 +250,67 @@ unsigned long LF(mem_store_cycles)(void* dst, char byte)
     return (unsigned long) (cycles2 - cycles1);
 }
 
+
+// Timed prefetch (T0 hint).
+unsigned long LF(mem_prefetch_cycles)(void* addr)
+{
+    register uint64_t cycles1 = 0;
+    register uint64_t cycles2 = 0;
+
+    // take clock-cycle sample 1
+    cycles1 = LF(mem_cycles)();
+
+    // issue the prefetch
+    #if (ISA == ISA_X86)
+    _mm_prefetch((const char*) addr, _MM_HINT_T0);
+    #else
+    #error "Unsupported ISA"
+    #endif
+
+    // take clock-cycle sample 2
+    cycles2 = LF(mem_cycles)();
+    return (unsigned long) (cycles2 - cycles1);
+}
+
+// Timed prefetch (NTA hint).
+unsigned long LF(mem_prefetchnta_cycles)(void* addr)
+{
+    register uint64_t cycles1 = 0;
+    register uint64_t cycles2 = 0;
+
+    // take clock-cycle sample 1
+    cycles1 = LF(mem_cycles)();
+
+    // issue the prefetch
+    #if (ISA == ISA_X86)
+    _mm_prefetch((const char*) addr, _MM_HINT_NTA);
+    #else
+    #error "Unsupported ISA"
+    #endif
+
+    // take clock-cycle sample 2
+    cycles2 = LF(mem_cycles)();
+    return (unsigned long) (cycles2 - cycles1);
+}
+
+// Timed prefetch (write intent).
+unsigned long LF(mem_prefetchw_cycles)(void* addr)
+{
+    register uint64_t cycles1 = 0;
+    register uint64_t cycles2 = 0;
+
+    // take clock-cycle sample 1
+    cycles1 = LF(mem_cycles)();
+
+    // issue the prefetch (we use inline assembly here, since the intrinsic
+    // requires the compiler to be told the CPU supports PRFCHW)
+    #if (ISA == ISA_X86)
+    __asm__ volatile("prefetchw (%0)" : : "r" (addr) : "memory");
+    #else
+    #error "Unsupported ISA"
+    #endif
+
+    // take clock-cycle sample 2
+    cycles2 = LF(mem_cycles)();
+    return (unsigned long) (cycles2 - cycles1);
+}
@@ -13,9 +13,43 @@
 
 
 // =========================== Memory Allocation ============================ //
-// Allocates memory given the number of desired cache lines.
+// The size of a huge page, in bytes. This is the size 'mem_map()' asks for
+// explicitly, whatever the system's default huge page size is.
+#define LIBSCA_HUGEPAGE_SIZE (2ul * 1024ul * 1024ul)
+
+// Allocates memory given the number of desired cache lines. The memory is
+// mapped according to the library config's 'mem_alloc_flags' (see
+// 'mem_map()') and is always line- and page-aligned.
+// The returned memory must be freed with 'mem_free_lines()', using the same
+// number of lines (and without changing the config's flags in between).
 void* LF(mem_alloc_lines)(size_t size_lines);
 
+// Frees memory returned by 'mem_alloc_lines()'.
+void LF(mem_free_lines)(void* mem, size_t size_lines);
+
+// Returns the number of bytes 'mem_map()' will actually map when asked for
+// 'size_bytes' with the given LIBSCA_MEM_* flags.
+size_t LF(mem_map_size)(size_t size_bytes, int flags);
+
+// Maps a page-aligned, anonymous memory region of at least 'size_bytes' bytes.
+// The 'flags' parameter takes LIBSCA_MEM_* flags:
+//  - LIBSCA_MEM_HUGEPAGE   Attempts to back the region with 2 MiB huge pages
+//                          (via MAP_HUGETLB). If none are reserved, this falls
+//                          back to a 2 MiB-aligned region that's advised to
+//                          use transparent huge pages instead.
+//  - LIBSCA_MEM_POPULATE   Pre-faults every page, so first-touch faults don't
+//                          occur later inside timed accesses.
+//  - LIBSCA_MEM_LOCK       Locks the region into memory. (This is best-effort;
+//                          it's silently skipped if RLIMIT_MEMLOCK is too low.)
+// If 'mapped_huge' is non-NULL, it's set to 1 if the region is guaranteed to
+// be backed by huge pages (MAP_HUGETLB succeeded), and 0 otherwise.
+// Returns NULL on failure.
+void* LF(mem_map)(size_t size_bytes, int flags, int* mapped_huge);
+
+// Unmaps a region returned by 'mem_map()'. The size and flags must match the
+// ones used to map the region.
+void LF(mem_unmap)(void* mem, size_t size_bytes, int flags);
+
 // Allocates memory given the number of desired bytes.
 void* LF(mem_alloc_bytes)(size_t size_bytes);
 
@@ -32,12 +66,23 @@ unsigned long LF(mem_flush)(void* addr);
 // Returns the number of clock cycles the flush operation took.
 unsigned long LF(mem_flush_overwrite)(void* addr, char new_value);
 
+// Loads a byte from the line half a page away from 'addr' (within the same
+// 4 KiB page). This brings the page's translation into the TLB without
+// caching the line 'addr' is in, so a timed access to 'addr' right after it
+// doesn't include a page walk.
+void LF(mem_warm_page)(void* addr);
+
 
 // ============================= Timed Accesses ============================= //
 // Invokes the ISA-specific instruction(s) to retrieve the current number of
 // clock cycles executed. Returns the value as an unsigned long.
 unsigned long LF(mem_cycles)();
 
+// Same as 'mem_cycles()', but also writes the ID of the CPU the timestamp was
+// read on into '*cpu'. (On x86, this is the TSC_AUX value that 'rdtscp'
+// returns alongside the timestamp, which Linux sets to the CPU number.)
+unsigned long LF(mem_cycles_cpu)(unsigned int* cpu);
+
 // Loads a single byte of memory from 'src' into the memory pointed at by
 // 'byte'. Uses architecture-specific timing instructions to measure the
 // number of clock cycles that occurred during the load and returns the number.
@@ -49,5 +94,24 @@ unsigned long LF(mem_load_cycles)(void* src, char* byte);
 // cycles that occurred during the store and returns the number.
 unsigned long LF(mem_store_cycles)(void* dst, char byte);
 
+// Issues a software prefetch ('prefetcht0') for the cache line containing
+// 'addr'. Uses architecture-specific timing instructions to measure the number
+// of clock cycles the prefetch instruction took and returns the number.
+// The prefetch never faults. The cycles counted span from one 'rdtscp' to the
+// next, so they cover the prefetch up to its retirement (which 'rdtscp' waits
+// for), not necessarily until its data arrives. Retirement still waits on the
+// address translation and, on many microarchitectures, on the cache lookup,
+// so the count varies with where the line lives, but how far hits and misses
+// separate has to be calibrated on each machine.
+unsigned long LF(mem_prefetch_cycles)(void* addr);
+
+// Same as 'mem_prefetch_cycles()', but uses the non-temporal hint
+// ('prefetchnta'), which minimizes pollution of the outer cache levels.
+unsigned long LF(mem_prefetchnta_cycles)(void* addr);
+
+// Same as 'mem_prefetch_cycles()', but prefetches the line with intent to write
+// ('prefetchw'), which requests the line in an exclusive state.
+unsigned long LF(mem_prefetchw_cycles)(void* addr);
+
 #endif
 
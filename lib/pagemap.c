@@ -0,0 +1,164 @@
+// Implements the functions prototyped in pagemap.h.
+
+// Imports
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// Local imports
+#include "libsca.h"
+#include "pagemap.h"
+#include "mem.h"
+#include "utils.h"
+
+// Pagemap entry fields (see the kernel's admin-guide/mm/pagemap.rst)
+#define PAGEMAP_ENTRY_PFN_MASK  ((1ull << 55) - 1)
+#define PAGEMAP_ENTRY_PRESENT   (1ull << 63)
+#define PAGEMAP_FRAME_SHIFT     12
+
+
+// ============================== Translation =============================== //
+PE(result_e) PF(pagemap_init)(PS(pagemap_t)* pm, void* addr, size_t size,
+                              int huge)
+{
+    if (!addr || size == 0)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // pagemap entries are indexed by 4 KiB virtual page number; we read one
+    // entry for every page in the region (for huge pages, only the first 4 KiB
+    // of each huge page is read, since the rest are contiguous)
+    size_t frame_size = (size_t) 1 << PAGEMAP_FRAME_SHIFT;
+    pm->page_size = huge ? LIBSCA_HUGEPAGE_SIZE : frame_size;
+    pm->base = (uintptr_t) addr & ~(pm->page_size - 1);
+    pm->size = ((uintptr_t) addr + size) - pm->base;
+    pm->pages = (pm->size + pm->page_size - 1) / pm->page_size;
+    pm->pfns = calloc(pm->pages, sizeof(uint64_t));
+    if (!pm->pfns)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    // until we read a real frame number, we only know the page offset
+    pm->known_bits = (size_t) LF(log2)(pm->page_size - 1);
+
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0)
+    { return LIBSCA_SUCCESS; }
+
+    // read each page's entry
+    size_t found = 0;
+    for (size_t i = 0; i < pm->pages; i++)
+    {
+        uintptr_t vaddr = pm->base + (i * pm->page_size);
+        off_t offset = (off_t) (vaddr >> PAGEMAP_FRAME_SHIFT) *
+                       sizeof(uint64_t);
+        uint64_t entry = 0;
+        if (pread(fd, &entry, sizeof(entry), offset) != sizeof(entry))
+        { break; }
+
+        // skip pages that aren't present; without CAP_SYS_ADMIN, present
+        // pages report a frame number of zero, so they're skipped as well
+        if (!(entry & PAGEMAP_ENTRY_PRESENT))
+        { continue; }
+        pm->pfns[i] = entry & PAGEMAP_ENTRY_PFN_MASK;
+        found += pm->pfns[i] != 0;
+    }
+    close(fd);
+
+    // if we found any real frame numbers, every bit is known
+    if (found > 0)
+    { pm->known_bits = sizeof(uintptr_t) * 8; }
+    return LIBSCA_SUCCESS;
+}
+
+void PF(pagemap_free)(PS(pagemap_t)* pm)
+{
+    free(pm->pfns);
+    pm->pfns = NULL;
+    pm->pages = 0;
+}
+
+int PF(pagemap_is_physical)(PS(pagemap_t)* pm)
+{ return pm->known_bits == sizeof(uintptr_t) * 8; }
+
+size_t PF(pagemap_translate)(PS(pagemap_t)* pm, void* addr, uintptr_t* phys)
+{
+    uintptr_t vaddr = (uintptr_t) addr;
+    uintptr_t offset = vaddr - pm->base;
+    size_t page = offset / pm->page_size;
+    uintptr_t page_offset = offset % pm->page_size;
+    size_t offset_bits = (size_t) LF(log2)(pm->page_size - 1);
+
+    // if the address is outside the region or its frame is unknown, we're left
+    // with the page offset
+    if (vaddr < pm->base || page >= pm->pages || pm->pfns[page] == 0)
+    {
+        *phys = page_offset;
+        return offset_bits;
+    }
+
+    *phys = (uintptr_t) (pm->pfns[page] << PAGEMAP_FRAME_SHIFT) + page_offset;
+    return pm->known_bits;
+}
+
+uintptr_t PF(pagemap_phys)(PS(pagemap_t)* pm, void* addr)
+{
+    uintptr_t phys = 0;
+    PF(pagemap_translate)(pm, addr, &phys);
+    return phys;
+}
+
+long PF(pagemap_set_bits)(PS(pagemap_t)* pm, void* addr,
+                          PE(cache_level_e) level)
+{
+    // the LLC's set count spans all of its slices, so it can't be used to find
+    // the set index within one
+    if (level == LIBSCA_CACHE_LLC)
+    { return -1; }
+
+    uintptr_t phys = 0;
+    size_t known = PF(pagemap_translate)(pm, addr, &phys);
+
+    // compute the line offset and set index sizes for this cache level
+    size_t los = PF(addr_line_size)(level);
+    size_t sis = PF(addr_set_size)(level);
+    if (los + sis > known)
+    { return -1; }
+
+    // shift down and mask off the set index
+    return (long) ((phys >> los) & (((uintptr_t) 1 << sis) - 1));
+}
+
+long PF(pagemap_tag_bits)(PS(pagemap_t)* pm, void* addr,
+                          PE(cache_level_e) level)
+{
+    if (level == LIBSCA_CACHE_LLC)
+    { return -1; }
+
+    uintptr_t phys = 0;
+    size_t known = PF(pagemap_translate)(pm, addr, &phys);
+    if (known < sizeof(uintptr_t) * 8)
+    { return -1; }
+
+    // everything above the set index is the tag
+    size_t los = PF(addr_line_size)(level);
+    size_t sis = PF(addr_set_size)(level);
+    return (long) (phys >> (los + sis));
+}
+
+size_t PF(pagemap_collect_set)(PS(pagemap_t)* pm, PE(cache_level_e) level,
+                               long set, void** out, size_t out_len)
+{
+    if (set < 0 || level == LIBSCA_CACHE_LLC)
+    { return 0; }
+
+    PS(config_t)* conf = PF(config_get)();
+    size_t line_size = conf->cache_levels[level].line_size;
+
+    size_t count = 0;
+    for (uintptr_t a = pm->base; a < pm->base + pm->size && count < out_len;
+         a += line_size)
+    {
+        if (PF(pagemap_set_bits)(pm, (void*) a, level) == set)
+        { out[count++] = (void*) a; }
+    }
+    return count;
+}
@@ -0,0 +1,91 @@
+// This module defines a virtual-to-physical address translation cache built on
+// top of Linux's /proc/self/pagemap interface. The L1 caches are indexed with
+// bits that lie within the page offset, so virtual addresses are good enough
+// for them; the L2 and last-level caches use physical address bits above the
+// page offset, so computing set indices for them requires a translation.
+
+#ifndef LIBSCA_PAGEMAP_H
+#define LIBSCA_PAGEMAP_H
+
+// Imports
+#include <stdint.h>
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+#include "config.h"
+
+
+// ============================== Translation =============================== //
+// Caches the physical frame numbers of every page in a memory region. The
+// table is read from /proc/self/pagemap once, when the pagemap is initialized.
+//
+// Reading physical frame numbers requires CAP_SYS_ADMIN. Without it, the
+// kernel reports every frame number as zero; in that case the pagemap degrades
+// to only knowing the low physical address bits that are shared with the
+// virtual address (the page offset). For huge-page-backed regions, that's the
+// low 21 bits, which covers the set index of most L2s (and of each slice of
+// most LLCs).
+typedef struct LS(pagemap)
+{
+    uintptr_t base;     // virtual address of the first page in the region
+    size_t size;        // size of the region (in bytes)
+    size_t page_size;   // size of the pages backing the region
+    size_t pages;       // number of entries in 'pfns'
+    uint64_t* pfns;     // 4 KiB frame number of the start of each page
+    size_t known_bits;  // number of low physical address bits that are known
+} PS(pagemap_t);
+
+// Initializes a pagemap for the region of 'size' bytes starting at 'addr'.
+// If 'huge' is non-zero, the region is assumed to be backed by 2 MiB huge
+// pages (i.e. mapped with MAP_HUGETLB), and only one entry per huge page is
+// kept.
+// Every page in the region should already be faulted in (i.e. the region was
+// allocated with LIBSCA_MEM_POPULATE); pages that aren't present are treated
+// as having an unknown frame number.
+// Returns a result enum. (If the pagemap only knows the page offset bits, this
+// still succeeds; check 'known_bits'.)
+PE(result_e) PF(pagemap_init)(PS(pagemap_t)* pm, void* addr, size_t size,
+                              int huge);
+
+// Frees the pagemap's memory.
+void PF(pagemap_free)(PS(pagemap_t)* pm);
+
+// Returns non-zero if the pagemap holds real physical frame numbers (and thus
+// every physical address bit is known).
+int PF(pagemap_is_physical)(PS(pagemap_t)* pm);
+
+// Translates the given virtual address (which must lie within the pagemap's
+// region) to a physical address. Only the low 'known_bits' bits of the result
+// are meaningful; the rest are zero.
+uintptr_t PF(pagemap_phys)(PS(pagemap_t)* pm, void* addr);
+
+// Translates the given virtual address into '*phys' and returns the number of
+// low physical address bits that are known for it. (Pages whose frame number
+// is unknown, or addresses outside the region, only have their page offset
+// bits known.)
+size_t PF(pagemap_translate)(PS(pagemap_t)* pm, void* addr, uintptr_t* phys);
+
+// Extracts and returns the bits from the given address' physical address that
+// represent its set index within the given cache level.
+// Returns -1 if the set index depends on physical bits the pagemap doesn't
+// know, or if 'level' is LIBSCA_CACHE_LLC: a sliced LLC's set index is taken
+// within one slice, and the configured set count covers every slice (use
+// 'slice_hash()' along with the index bits of a single slice instead).
+long PF(pagemap_set_bits)(PS(pagemap_t)* pm, void* addr,
+                          PE(cache_level_e) level);
+
+// Extracts and returns the bits from the given address' physical address that
+// represent its tag within the given cache level.
+// Returns -1 if the pagemap doesn't know every physical address bit, or if
+// 'level' is LIBSCA_CACHE_LLC (see 'pagemap_set_bits()').
+long PF(pagemap_tag_bits)(PS(pagemap_t)* pm, void* addr,
+                          PE(cache_level_e) level);
+
+// Walks the pagemap's region one cache line at a time and writes the address of
+// every line whose physical set index (in the given cache level) equals 'set'
+// into 'out', stopping once 'out_len' addresses have been written.
+// Returns the number of addresses written (always 0 for LIBSCA_CACHE_LLC).
+size_t PF(pagemap_collect_set)(PS(pagemap_t)* pm, PE(cache_level_e) level,
+                               long set, void** out, size_t out_len);
+
+#endif
@@ -0,0 +1,185 @@
+// Implements the functions prototyped in primeprobe.h.
+
+// Imports
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local imports
+#include "libsca.h"
+#include "primeprobe.h"
+#include "mem.h"
+
+
+// ============================== Prime+Probe =============================== //
+// Helper function that allocates the engine's head/tail arrays.
+static PE(result_e) LF(primeprobe_alloc)(PS(primeprobe_t)* pp, size_t sets)
+{
+    memset(pp, 0, sizeof(PS(primeprobe_t)));
+    pp->heads = calloc(sets, sizeof(PS(pp_line_t)*));
+    pp->tails = calloc(sets, sizeof(PS(pp_line_t)*));
+    if (!pp->heads || !pp->tails)
+    {
+        free(pp->heads);
+        free(pp->tails);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+    pp->sets = sets;
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function that links the given lines together into set 'set'.
+static void LF(primeprobe_link)(PS(primeprobe_t)* pp, size_t set,
+                                void** lines, size_t count)
+{
+    PS(pp_line_t)* prev = NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        PS(pp_line_t)* line = lines[i];
+        line->prev = prev;
+        line->next = NULL;
+        if (prev)
+        { prev->next = line; }
+        else
+        { pp->heads[set] = line; }
+        prev = line;
+    }
+    pp->tails[set] = prev;
+}
+
+PE(result_e) PF(primeprobe_init)(PS(primeprobe_t)* pp)
+{
+    PS(config_t)* conf = PF(config_get)();
+    PS(cache_geometry_t)* l1d = &conf->cache_levels[LIBSCA_CACHE_L1D];
+    size_t sets = PF(cache_sets)(LIBSCA_CACHE_L1D);
+    size_t ways = l1d->associativity;
+    PE(result_e) result = LF(primeprobe_alloc)(pp, sets);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+
+    // allocate a buffer the size of the cache; the line for set 's' in way 'w'
+    // lives 'w' strides of (sets * line_size) bytes into it
+    pp->mem_size = l1d->size;
+    pp->mem = LF(mem_map)(pp->mem_size, LIBSCA_MEM_POPULATE, NULL);
+    if (!pp->mem)
+    {
+        PF(primeprobe_free)(pp);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+
+    void* lines[ways];
+    size_t stride = sets * l1d->line_size;
+    for (size_t s = 0; s < sets; s++)
+    {
+        for (size_t w = 0; w < ways; w++)
+        { lines[w] = (char*) pp->mem + (w * stride) + (s * l1d->line_size); }
+        LF(primeprobe_link)(pp, s, lines, ways);
+    }
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function used in qsort() to compare two line addresses.
+static int LF(primeprobe_line_cmp)(const void* a, const void* b)
+{
+    uintptr_t ia = *((uintptr_t*) a);
+    uintptr_t ib = *((uintptr_t*) b);
+    if (ia == ib) { return 0; }
+    return ia < ib ? -1 : 1;
+}
+
+// Helper function that sets '*overlap' to non-zero if any two lines of the
+// given eviction sets overlap (eviction sets built from a shared pool can
+// share lines), which would make linking one set overwrite another's links.
+// The lines are sorted, so only neighbors need comparing.
+// Returns a result enum.
+static PE(result_e) LF(primeprobe_overlap)(PS(evset_t)* evsets, size_t count,
+                                           int* overlap)
+{
+    size_t total = 0;
+    for (size_t s = 0; s < count; s++)
+    { total += evsets[s].size; }
+    uintptr_t* addrs = malloc((total > 0 ? total : 1) * sizeof(uintptr_t));
+    if (!addrs)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    size_t k = 0;
+    for (size_t s = 0; s < count; s++)
+    {
+        for (size_t i = 0; i < evsets[s].size; i++)
+        { addrs[k++] = (uintptr_t) evsets[s].lines[i]; }
+    }
+    qsort(addrs, total, sizeof(uintptr_t), LF(primeprobe_line_cmp));
+    *overlap = 0;
+    for (size_t i = 1; i < total && !*overlap; i++)
+    { *overlap = addrs[i] - addrs[i - 1] < sizeof(PS(pp_line_t)); }
+    free(addrs);
+    return LIBSCA_SUCCESS;
+}
+
+PE(result_e) PF(primeprobe_init_evsets)(PS(primeprobe_t)* pp,
+                                        PS(evset_t)* evsets, size_t count)
+{
+    int overlap;
+    PE(result_e) result = LF(primeprobe_overlap)(evsets, count, &overlap);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+    if (overlap)
+    { return LIBSCA_INVALID_INPUT; }
+
+    result = LF(primeprobe_alloc)(pp, count);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+
+    for (size_t s = 0; s < count; s++)
+    { LF(primeprobe_link)(pp, s, evsets[s].lines, evsets[s].size); }
+    return LIBSCA_SUCCESS;
+}
+
+void PF(primeprobe_free)(PS(primeprobe_t)* pp)
+{
+    if (pp->mem)
+    { LF(mem_unmap)(pp->mem, pp->mem_size, LIBSCA_MEM_POPULATE); }
+    free(pp->heads);
+    free(pp->tails);
+    memset(pp, 0, sizeof(PS(primeprobe_t)));
+}
+
+// Helper function that walks a set's list in the current direction. Each step
+// depends on the pointer loaded by the previous one, so the loads serialize.
+static inline void LF(primeprobe_walk)(PS(primeprobe_t)* pp, size_t set)
+{
+    PS(pp_line_t)* line;
+    if (pp->reverse)
+    {
+        line = pp->tails[set];
+        while (line)
+        { line = *((PS(pp_line_t)* volatile*) &line->prev); }
+    }
+    else
+    {
+        line = pp->heads[set];
+        while (line)
+        { line = *((PS(pp_line_t)* volatile*) &line->next); }
+    }
+}
+
+void PF(primeprobe_prime)(PS(primeprobe_t)* pp)
+{
+    for (size_t s = 0; s < pp->sets; s++)
+    { LF(primeprobe_walk)(pp, s); }
+}
+
+unsigned long PF(primeprobe_probe_set)(PS(primeprobe_t)* pp, size_t set)
+{
+    unsigned long cycles1 = LF(mem_cycles)();
+    LF(primeprobe_walk)(pp, set);
+    unsigned long cycles2 = LF(mem_cycles)();
+    return cycles2 - cycles1;
+}
+
+void PF(primeprobe_probe_all)(PS(primeprobe_t)* pp, unsigned long* latencies)
+{
+    for (size_t s = 0; s < pp->sets; s++)
+    { latencies[s] = PF(primeprobe_probe_set)(pp, s); }
+    pp->reverse = !pp->reverse;
+}
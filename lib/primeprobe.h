@@ -0,0 +1,78 @@
+// This module implements a Prime+Probe engine. Unlike Flush+Reload, Prime+Probe
+// doesn't require memory shared with the victim: the attacker fills ("primes")
+// cache sets with its own lines, lets the victim run, then times how long it
+// takes to access ("probe") its lines again. Sets the victim touched will have
+// had some of the attacker's lines evicted, so probing them takes longer.
+//
+// Each set's lines are linked together into a list (each line holds pointers
+// to the next and previous lines in its set). Traversing a list is a chain of
+// dependent loads, so the CPU can't reorder or overlap them, and timing a
+// whole set takes just two timestamps rather than one pair per line.
+
+#ifndef LIBSCA_PRIMEPROBE_H
+#define LIBSCA_PRIMEPROBE_H
+
+// Imports
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+#include "config.h"
+#include "evset.h"
+
+
+// ============================== Prime+Probe =============================== //
+// A single line in a set's list. This structure is written into the first
+// bytes of each of the lines themselves.
+typedef struct LS(pp_line)
+{
+    struct LS(pp_line)* next;   // next line in the set (NULL at the tail)
+    struct LS(pp_line)* prev;   // previous line in the set (NULL at the head)
+} PS(pp_line_t);
+
+// Represents a group of monitored cache sets.
+typedef struct LS(primeprobe)
+{
+    PS(pp_line_t)** heads;      // first line of each set's list
+    PS(pp_line_t)** tails;      // last line of each set's list
+    size_t sets;                // number of monitored sets
+    void* mem;                  // memory owned by the engine (may be NULL)
+    size_t mem_size;            // size of 'mem' (in bytes)
+    int reverse;                // non-zero if traversals run tail-to-head
+} PS(primeprobe_t);
+
+// Initializes the engine to monitor every set of the L1 data cache. The L1D is
+// virtually indexed, so a buffer the size of the cache contains exactly
+// 'associativity' lines for each set; this allocates one and links its lines.
+// Returns a result enum.
+PE(result_e) PF(primeprobe_init)(PS(primeprobe_t)* pp);
+
+// Initializes the engine to monitor one set per eviction set given (e.g. ones
+// built with 'evset_build()', for L2 or LLC sets). The eviction sets' lines
+// are linked in place, so their first 16 bytes are overwritten and they must
+// remain mapped until the engine is freed. No line may appear in more than one
+// set (or twice in one); otherwise, LIBSCA_INVALID_INPUT is returned.
+// Returns a result enum.
+PE(result_e) PF(primeprobe_init_evsets)(PS(primeprobe_t)* pp,
+                                        PS(evset_t)* evsets, size_t count);
+
+// Frees the engine's memory.
+void PF(primeprobe_free)(PS(primeprobe_t)* pp);
+
+// Primes every monitored set by traversing all of its lines.
+void PF(primeprobe_prime)(PS(primeprobe_t)* pp);
+
+// Probes a single set and returns the number of cycles it took to traverse.
+// Like 'probe_all()', this also re-primes the set, but it does not change the
+// traversal direction.
+unsigned long PF(primeprobe_probe_set)(PS(primeprobe_t)* pp, size_t set);
+
+// Probes every monitored set, writing each set's traversal latency (in cycles)
+// into 'latencies' (which must hold 'pp->sets' entries).
+// Probing a set also leaves it primed for the next round. Afterwards, the
+// traversal direction is flipped: the next round walks each list in the
+// opposite order, so it touches the lines least likely to have been evicted by
+// its own previous accesses first (this reduces self-eviction under LRU-like
+// replacement policies).
+void PF(primeprobe_probe_all)(PS(primeprobe_t)* pp, unsigned long* latencies);
+
+#endif
@@ -0,0 +1,57 @@
+// Implements the functions prototyped in region.h.
+
+// Imports
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Local imports
+#include "region.h"
+#include "mem.h"
+
+// Granularity at which 'region_warm()' touches pages
+#define REGION_WARM_STRIDE 4096
+
+
+// ========================== Measurement Regions =========================== //
+PE(result_e) PF(region_init)(PS(region_t)* r, size_t size, int flags)
+{
+    memset(r, 0, sizeof(PS(region_t)));
+    if (size == 0)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // map the usable pages with one guard page on either side
+    flags |= LIBSCA_MEM_POPULATE;
+    r->page_size = flags & LIBSCA_MEM_HUGEPAGE ?
+                   LIBSCA_HUGEPAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+    r->size = LF(mem_map_size)(size, flags);
+    r->map_size = r->size + (2 * r->page_size);
+    r->flags = flags;
+    r->map = LF(mem_map)(r->map_size, flags, &r->huge);
+    if (!r->map)
+    { return LIBSCA_ALLOC_FAILURE; }
+    r->base = (char*) r->map + r->page_size;
+
+    // revoke all access to the guard pages
+    void* tail = (char*) r->base + r->size;
+    if (mprotect(r->map, r->page_size, PROT_NONE) ||
+        mprotect(tail, r->page_size, PROT_NONE))
+    {
+        PF(region_free)(r);
+        return LIBSCA_FAILURE;
+    }
+    return LIBSCA_SUCCESS;
+}
+
+void PF(region_free)(PS(region_t)* r)
+{
+    if (r->map)
+    { LF(mem_unmap)(r->map, r->map_size, r->flags); }
+    memset(r, 0, sizeof(PS(region_t)));
+}
+
+void PF(region_warm)(PS(region_t)* r)
+{
+    for (size_t off = 0; off < r->size; off += REGION_WARM_STRIDE)
+    { *((volatile char*) r->base + off); }
+}
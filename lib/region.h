@@ -0,0 +1,48 @@
+// This module implements measurement regions: memory that's safe to time
+// accesses to. A region is page-aligned (and so line-aligned), pre-faulted so
+// no page faults land inside timed accesses, optionally locked into memory,
+// and surrounded by inaccessible guard pages, so a stray access past either
+// end faults instead of silently touching (and caching) a neighboring region.
+
+#ifndef LIBSCA_REGION_H
+#define LIBSCA_REGION_H
+
+// Imports
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+#include "config.h"
+
+
+// ========================== Measurement Regions =========================== //
+// Represents a single measurement region.
+typedef struct LS(region)
+{
+    void* base;                 // start of the usable memory (page-aligned)
+    size_t size;                // size of the usable memory (in bytes)
+    size_t page_size;           // size of the pages (and guards) around it
+    int huge;                   // 1 if backed by reserved huge pages
+    void* map;                  // start of the whole mapping (with guards)
+    size_t map_size;            // size of the whole mapping (with guards)
+    int flags;                  // LIBSCA_MEM_* flags it was mapped with
+} PS(region_t);
+
+// Maps a region of at least 'size' bytes (rounded up to a whole number of
+// pages). The 'flags' are the LIBSCA_MEM_* flags accepted by the config's
+// 'mem_alloc_flags' (LIBSCA_MEM_POPULATE is always applied). With
+// LIBSCA_MEM_HUGEPAGE, the guard pages are huge pages too, so the region
+// stays 2 MiB-aligned.
+// The region must be freed with 'region_free()'.
+// Returns a result enum.
+PE(result_e) PF(region_init)(PS(region_t)* r, size_t size, int flags);
+
+// Frees the region's memory (including its guard pages).
+void PF(region_free)(PS(region_t)* r);
+
+// Warms the TLB for the region by reading one byte from the start of each of
+// its 4 KiB pages, so the first timed access to each page doesn't include a
+// page walk. This brings those bytes' lines into the cache, so it should be
+// called before the region's lines are flushed, not after.
+void PF(region_warm)(PS(region_t)* r);
+
+#endif
@@ -0,0 +1,393 @@
+// Implements the functions prototyped in slice.h.
+
+// Imports
+#include <stdlib.h>
+#include <string.h>
+
+// Local imports
+#include "libsca.h"
+#include "slice.h"
+#include "mem.h"
+#include "utils.h"
+
+// Published slice hash masks (Maurice et al., "Reverse Engineering Intel
+// Last-Level Cache Complex Addressing Using Performance Counters")
+#define SLICE_MASK_O0 0x1b5f575440ull
+#define SLICE_MASK_O1 0x2eb5faa880ull
+#define SLICE_MASK_O2 0x3cccc93100ull
+
+// Highest physical address bit slice discovery will examine.
+#define SLICE_DISCOVER_MAX_BIT 40
+
+
+// ============================== Slice Model =============================== //
+PE(result_e) PF(slice_model_known)(PS(slice_model_t)* model, size_t slices)
+{
+    memset(model, 0, sizeof(PS(slice_model_t)));
+    model->masks[0] = SLICE_MASK_O0;
+    model->masks[1] = SLICE_MASK_O1;
+    model->masks[2] = SLICE_MASK_O2;
+
+    switch (slices)
+    {
+        case 1: model->bits = 0; break;
+        case 2: model->bits = 1; break;
+        case 4: model->bits = 2; break;
+        case 8: model->bits = 3; break;
+        default:
+            model->bits = 0;
+            return LIBSCA_INVALID_INPUT;
+    }
+
+    // clear out the masks we aren't using
+    for (size_t i = model->bits; i < LIBSCA_SLICE_MAX_BITS; i++)
+    { model->masks[i] = 0; }
+    return LIBSCA_SUCCESS;
+}
+
+size_t PF(slice_count)(PS(slice_model_t)* model)
+{ return (size_t) 1 << model->bits; }
+
+unsigned int PF(slice_hash)(PS(slice_model_t)* model, uintptr_t phys)
+{
+    // each output bit is the parity of the address bits selected by its mask
+    unsigned int slice = 0;
+    for (size_t i = 0; i < model->bits; i++)
+    {
+        unsigned int parity = __builtin_parityll(phys & model->masks[i]);
+        slice |= parity << i;
+    }
+    return slice;
+}
+
+// Helper function that returns the mask of physical address bits the model
+// depends on.
+static uint64_t LF(slice_used_bits)(PS(slice_model_t)* model)
+{
+    uint64_t used = 0;
+    for (size_t i = 0; i < model->bits; i++)
+    { used |= model->masks[i]; }
+    return used;
+}
+
+long PF(slice_bits)(PS(slice_model_t)* model, PS(pagemap_t)* pm, void* addr)
+{
+    // make sure we know every physical address bit the hash depends on
+    uintptr_t phys = 0;
+    size_t known = PF(pagemap_translate)(pm, addr, &phys);
+    uint64_t used = LF(slice_used_bits)(model);
+    if (known < 64 && (used >> known) != 0)
+    { return -1; }
+
+    return (long) PF(slice_hash)(model, phys);
+}
+
+long PF(slice_set_bits)(PS(slice_model_t)* model, PS(pagemap_t)* pm,
+                        void* addr)
+{
+    // each slice holds an equal share of the LLC's sets
+    size_t sets = PF(cache_sets)(LIBSCA_CACHE_LLC) / PF(slice_count)(model);
+    size_t los = PF(addr_line_size)(LIBSCA_CACHE_LLC);
+    size_t sis = (size_t) LF(log2)(sets - 1);
+
+    uintptr_t phys = 0;
+    size_t known = PF(pagemap_translate)(pm, addr, &phys);
+    if (los + sis > known)
+    { return -1; }
+
+    return (long) ((phys >> los) & (((uintptr_t) 1 << sis) - 1));
+}
+
+int PF(slice_collision_check)(PS(slice_model_t)* model, PS(pagemap_t)* pm,
+                              void* addr1, void* addr2)
+{
+    long set1 = PF(slice_set_bits)(model, pm, addr1);
+    long set2 = PF(slice_set_bits)(model, pm, addr2);
+    long slice1 = PF(slice_bits)(model, pm, addr1);
+    long slice2 = PF(slice_bits)(model, pm, addr2);
+    if (set1 < 0 || set2 < 0 || slice1 < 0 || slice2 < 0)
+    { return -1; }
+
+    return set1 == set2 && slice1 == slice2;
+}
+
+
+// ============================ Slice Discovery ============================= //
+// Pairs a page's frame number with its index in the pagemap.
+typedef struct LS(slice_frame)
+{
+    uint64_t pfn;
+    size_t page;
+} LS(slice_frame_t);
+
+// State used while discovering the slice function.
+typedef struct LS(slice_discovery)
+{
+    PS(pagemap_t)* pm;
+    LS(slice_frame_t)* frames;  // the pagemap's frames, sorted by frame number
+    size_t frame_count;
+    uint8_t* sweep;             // buffer used to evict from the private caches
+    size_t sweep_size;
+    size_t line_size;
+    unsigned long tolerance;
+    unsigned int trials;
+} LS(slice_discovery_t);
+
+// Helper function used in qsort() and bsearch() to compare two frames.
+static int LF(slice_frame_cmp)(const void* a, const void* b)
+{
+    uint64_t pa = ((LS(slice_frame_t)*) a)->pfn;
+    uint64_t pb = ((LS(slice_frame_t)*) b)->pfn;
+    if (pa == pb) { return 0; }
+    return pa < pb ? -1 : 1;
+}
+
+// Finds two addresses in the pagemap's region whose physical addresses differ
+// by exactly the bits in 'delta'. Returns 1 if a pair was found, 0 otherwise.
+static int LF(slice_find_pair)(LS(slice_discovery_t)* sd, uint64_t delta,
+                               void** x, void** y)
+{
+    PS(pagemap_t)* pm = sd->pm;
+    uint64_t delta_lo = delta & (pm->page_size - 1);
+    uint64_t delta_hi = delta & ~((uint64_t) pm->page_size - 1);
+
+    // if the bits lie within the page offset, any page will do
+    if (delta_hi == 0)
+    {
+        *x = (void*) pm->base;
+        *y = (void*) (pm->base + delta_lo);
+        return 1;
+    }
+
+    // otherwise, look for two frames whose numbers differ by the high bits
+    uint64_t frame_delta = delta_hi >> 12;
+    for (size_t i = 0; i < sd->frame_count; i++)
+    {
+        LS(slice_frame_t) key = { .pfn = sd->frames[i].pfn ^ frame_delta };
+        LS(slice_frame_t)* match = bsearch(&key, sd->frames, sd->frame_count,
+                                           sizeof(LS(slice_frame_t)),
+                                           LF(slice_frame_cmp));
+        if (match)
+        {
+            *x = (void*) (pm->base + sd->frames[i].page * pm->page_size);
+            *y = (void*) (pm->base + match->page * pm->page_size + delta_lo);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Determines if the two addresses are served by the same LLC slice, by
+// comparing their median LLC access latencies. Both addresses are timed in the
+// same trial, right after evicting them from the private caches, so drift in
+// the measurements affects both equally.
+static int LF(slice_same)(LS(slice_discovery_t)* sd, void* x, void* y)
+{
+    PS(dataset_t) lx;
+    PS(dataset_t) ly;
+    PF(dataset_init)(&lx, sd->trials);
+    PF(dataset_init)(&ly, sd->trials);
+
+    for (unsigned int t = 0; t < sd->trials; t++)
+    {
+        // bring both lines into the cache, then push them out of the private
+        // caches by sweeping a buffer that's larger than the L2 (but small
+        // enough to leave them in the LLC)
+        LF(mem_load_cycles)(x, NULL);
+        LF(mem_load_cycles)(y, NULL);
+        for (size_t off = 0; off < sd->sweep_size; off += sd->line_size)
+        { *((volatile uint8_t*) sd->sweep + off); }
+
+        // alternate which address is timed first
+        if (t % 2)
+        {
+            PF(dataset_add)(&lx, LF(mem_load_cycles)(x, NULL));
+            PF(dataset_add)(&ly, LF(mem_load_cycles)(y, NULL));
+        }
+        else
+        {
+            PF(dataset_add)(&ly, LF(mem_load_cycles)(y, NULL));
+            PF(dataset_add)(&lx, LF(mem_load_cycles)(x, NULL));
+        }
+    }
+
+    long mx = PF(dataset_median)(&lx);
+    long my = PF(dataset_median)(&ly);
+    PF(dataset_free)(&lx);
+    PF(dataset_free)(&ly);
+
+    long diff = mx > my ? mx - my : my - mx;
+    return diff <= (long) sd->tolerance;
+}
+
+// Determines if the slice hash of the given bit difference is zero (i.e. two
+// addresses that differ by 'delta' map to the same slice). Returns 1 if so, 0
+// if not, and -1 if no such pair of addresses could be found.
+static int LF(slice_delta_same)(LS(slice_discovery_t)* sd, uint64_t delta)
+{
+    void* x = NULL;
+    void* y = NULL;
+    if (!LF(slice_find_pair)(sd, delta, &x, &y))
+    { return -1; }
+    return LF(slice_same)(sd, x, y);
+}
+
+PE(result_e) PF(slice_discover)(PS(slice_model_t)* model, PS(pagemap_t)* pm,
+                                unsigned long tolerance, unsigned int trials)
+{
+    if (trials == 0 || !pm->pfns)
+    { return LIBSCA_INVALID_INPUT; }
+    memset(model, 0, sizeof(PS(slice_model_t)));
+
+    PS(config_t)* conf = PF(config_get)();
+    LS(slice_discovery_t) sd = {
+        .pm = pm,
+        .line_size = conf->cache_levels[LIBSCA_CACHE_LLC].line_size,
+        .tolerance = tolerance,
+        .trials = trials
+    };
+
+    // build a sorted table of the region's frames for pair lookups
+    sd.frames = malloc(pm->pages * sizeof(LS(slice_frame_t)));
+    if (!sd.frames)
+    { return LIBSCA_ALLOC_FAILURE; }
+    for (size_t i = 0; i < pm->pages; i++)
+    {
+        if (pm->pfns[i] == 0)
+        { continue; }
+        sd.frames[sd.frame_count].pfn = pm->pfns[i];
+        sd.frames[sd.frame_count++].page = i;
+    }
+    qsort(sd.frames, sd.frame_count, sizeof(LS(slice_frame_t)),
+          LF(slice_frame_cmp));
+
+    // allocate the sweep buffer: twice the L2, capped to a quarter of the LLC
+    size_t l2_size = conf->cache_levels[LIBSCA_CACHE_L2].size;
+    size_t llc_size = conf->cache_levels[LIBSCA_CACHE_LLC].size;
+    sd.sweep_size = MIN(l2_size * 2, llc_size / 4);
+    sd.sweep = LF(mem_map)(sd.sweep_size, LIBSCA_MEM_POPULATE, NULL);
+    if (!sd.sweep)
+    {
+        free(sd.frames);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+
+    // STEP 1. For every known address bit, find out whether flipping it alone
+    // changes the slice. Bits that do are grouped into classes of bits that
+    // flip the slice in the same way (flipping two bits of the same class
+    // together leaves the slice unchanged)
+    size_t los = (size_t) LF(log2)(sd.line_size - 1);
+    size_t max_bit = MIN(pm->known_bits, SLICE_DISCOVER_MAX_BIT);
+    size_t class_of[SLICE_DISCOVER_MAX_BIT];
+    size_t class_rep[1 << LIBSCA_SLICE_MAX_BITS];
+    size_t class_count = 0;
+    PE(result_e) result = LIBSCA_SUCCESS;
+    for (size_t b = 0; b < SLICE_DISCOVER_MAX_BIT; b++)
+    { class_of[b] = (size_t) -1; }
+
+    for (size_t b = max_bit; b < SLICE_DISCOVER_MAX_BIT; b++)
+    { model->untested |= (uint64_t) 1 << b; }
+
+    for (size_t b = los; b < max_bit && result == LIBSCA_SUCCESS; b++)
+    {
+        // only a bit that was actually tested can be ruled out; one with no
+        // pair of addresses to test it with is recorded as untested
+        uint64_t bit = (uint64_t) 1 << b;
+        int same = LF(slice_delta_same)(&sd, bit);
+        if (same < 0)
+        {
+            model->untested |= bit;
+            continue;
+        }
+        if (same == 1)
+        { continue; }
+
+        // look for an existing class this bit belongs to
+        for (size_t k = 0; k < class_count; k++)
+        {
+            uint64_t rep = (uint64_t) 1 << class_rep[k];
+            if (LF(slice_delta_same)(&sd, bit | rep) == 1)
+            {
+                class_of[b] = k;
+                break;
+            }
+        }
+        if (class_of[b] != (size_t) -1)
+        { continue; }
+
+        // otherwise, start a new class (a linear function with N output bits
+        // can produce at most 2^N - 1 distinct non-zero differences)
+        if (class_count == (1 << LIBSCA_SLICE_MAX_BITS) - 1)
+        {
+            result = LIBSCA_FAILURE;
+            break;
+        }
+        class_rep[class_count] = b;
+        class_of[b] = class_count++;
+    }
+
+    // STEP 2. Assign each class an output vector. A class whose difference
+    // equals the XOR of some existing basis classes gets that combination;
+    // otherwise it becomes a new basis vector (i.e. a new output bit)
+    unsigned int class_vec[1 << LIBSCA_SLICE_MAX_BITS];
+    size_t basis[LIBSCA_SLICE_MAX_BITS];
+    size_t basis_count = 0;
+    for (size_t k = 0; k < class_count && result == LIBSCA_SUCCESS; k++)
+    {
+        uint64_t rep = (uint64_t) 1 << class_rep[k];
+        int found = 0;
+        for (unsigned int subset = 1; subset < (1u << basis_count); subset++)
+        {
+            uint64_t delta = rep;
+            unsigned int vec = 0;
+            for (size_t j = 0; j < basis_count; j++)
+            {
+                if (!(subset & (1u << j)))
+                { continue; }
+                delta |= (uint64_t) 1 << class_rep[basis[j]];
+                vec ^= class_vec[basis[j]];
+            }
+            if (LF(slice_delta_same)(&sd, delta) == 1)
+            {
+                class_vec[k] = vec;
+                found = 1;
+                break;
+            }
+        }
+        if (found)
+        { continue; }
+
+        if (basis_count == LIBSCA_SLICE_MAX_BITS)
+        {
+            result = LIBSCA_FAILURE;
+            break;
+        }
+        class_vec[k] = 1u << basis_count;
+        basis[basis_count++] = k;
+    }
+
+    // STEP 3. Build one mask per output bit from the bits' class vectors
+    if (result == LIBSCA_SUCCESS)
+    {
+        model->bits = basis_count;
+        for (size_t b = los; b < max_bit; b++)
+        {
+            if (class_of[b] == (size_t) -1)
+            { continue; }
+            for (size_t i = 0; i < basis_count; i++)
+            {
+                if (class_vec[class_of[b]] & (1u << i))
+                { model->masks[i] |= (uint64_t) 1 << b; }
+            }
+        }
+    }
+
+    // a model missing any bit the known hash functions use is a guess
+    uint64_t published = SLICE_MASK_O0 | SLICE_MASK_O1 | SLICE_MASK_O2;
+    if (result == LIBSCA_SUCCESS && (model->untested & published))
+    { result = LIBSCA_FAILURE; }
+
+    LF(mem_unmap)(sd.sweep, sd.sweep_size, LIBSCA_MEM_POPULATE);
+    free(sd.frames);
+    return result;
+}
@@ -0,0 +1,89 @@
+// This module models the slice selection function of sliced last-level caches.
+// Intel LLCs are split into one slice per core (or per core pair), and each
+// physical address is mapped to a slice by an undocumented hash. For
+// power-of-two slice counts, the hash is linear: each output bit is the parity
+// (XOR) of the physical address bits selected by a mask. Two addresses only
+// conflict in the LLC if they share both a set index and a slice.
+
+#ifndef LIBSCA_SLICE_H
+#define LIBSCA_SLICE_H
+
+// Imports
+#include <stdint.h>
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+#include "pagemap.h"
+
+// Maximum number of hash output bits (up to 2^N slices) the model supports.
+#define LIBSCA_SLICE_MAX_BITS 4
+
+
+// ============================== Slice Model =============================== //
+// Represents a linear slice selection function.
+typedef struct LS(slice_model)
+{
+    size_t bits;                            // number of hash output bits
+    uint64_t masks[LIBSCA_SLICE_MAX_BITS];  // address mask per output bit
+    uint64_t untested;                      // bits discovery couldn't test
+} PS(slice_model_t);
+
+// Fills in the model with the published hash masks for an LLC with the given
+// number of slices (1, 2, 4, or 8). These were reverse-engineered for Intel
+// Sandy Bridge through Skylake client parts (Maurice et al., RAID 2015).
+// Returns LIBSCA_INVALID_INPUT for slice counts that have no known linear
+// function.
+PE(result_e) PF(slice_model_known)(PS(slice_model_t)* model, size_t slices);
+
+// Returns the number of slices described by the model.
+size_t PF(slice_count)(PS(slice_model_t)* model);
+
+// Computes the slice the given physical address maps to.
+unsigned int PF(slice_hash)(PS(slice_model_t)* model, uintptr_t phys);
+
+// Computes the slice the given virtual address maps to, using the pagemap to
+// translate it. Returns -1 if the model depends on physical address bits the
+// pagemap doesn't know.
+long PF(slice_bits)(PS(slice_model_t)* model, PS(pagemap_t)* pm, void* addr);
+
+// Computes the set index of the given virtual address within its LLC slice.
+// Returns -1 if the set index depends on physical address bits the pagemap
+// doesn't know.
+long PF(slice_set_bits)(PS(slice_model_t)* model, PS(pagemap_t)* pm,
+                        void* addr);
+
+// Uses arithmetic to determine if the two addresses will collide in the LLC
+// (i.e. they map to the same slice and the same set within it).
+// Returns 1 if they collide, 0 if not, and -1 if it can't be determined with
+// the physical address bits the pagemap knows.
+int PF(slice_collision_check)(PS(slice_model_t)* model, PS(pagemap_t)* pm,
+                              void* addr1, void* addr2);
+
+
+// ============================ Slice Discovery ============================= //
+// Infers the slice hash masks by timing LLC accesses to pairs of addresses
+// within the pagemap's region that differ in known physical address bits.
+//
+// An LLC access is served by the slice the line maps to, and slices sit at
+// different distances from the requesting core, so the latency of an access
+// that misses the private caches depends on its slice. Because the hash is
+// linear, two addresses land in the same slice exactly when the hash of the
+// bits they differ in is zero. By comparing latencies of address pairs that
+// differ in one bit, then in pairs and small groups of bits, the routine
+// recovers the masks (up to a relabeling of the slices, which doesn't matter
+// for predicting conflicts).
+//
+// 'tolerance' is the maximum difference (in cycles) between two median
+// latencies for them to be considered the same slice, and 'trials' is the
+// number of timed accesses used for each median.
+// Only the physical address bits the pagemap knows can be inferred; with
+// huge-page offsets alone, that's bits 6 through 20. A bit is also left
+// untested if no two frames in the region differ in it alone. Untested bits
+// are recorded in the model's 'untested' mask (and left out of its masks), and
+// if any of them is used by the published hash functions, the model can't be
+// trusted, so LIBSCA_FAILURE is returned (with the partial model filled in).
+// Returns a result enum.
+PE(result_e) PF(slice_discover)(PS(slice_model_t)* model, PS(pagemap_t)* pm,
+                                unsigned long tolerance, unsigned int trials);
+
+#endif
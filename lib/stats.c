@@ -5,61 +5,206 @@
 // Imports
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <limits.h>
 
 // Local imports
+#include "isa.h"
 #include "stats.h"
+#include "config.h"
 #include "utils.h"
 
+// ISA-specific imports
+#if (ISA == ISA_X86)
+#include <emmintrin.h>
+#endif
+
+// Fewest values worth radix sorting (qsort() is used below this)
+#define STATS_RADIX_MIN 256
+// Widest range of values that's counted (with a histogram) rather than sorted
+#define STATS_COUNTING_MAX_RANGE 65536
+// Fewest values worth giving their own thread
+#define STATS_PARALLEL_MIN 65536
+
 
 // ================================ Datasets ================================ //
+// Sentinels stored in place of values that don't fit a narrow entry (each is
+// the largest value of its width, so the representable ranges are [0, 65534]
+// and [INT32_MIN, INT32_MAX - 1])
+#define STATS_SENTINEL16 UINT16_MAX
+#define STATS_SENTINEL32 INT32_MAX
+
 int PF(dataset_init)(PS(dataset_t)* ds, size_t initial_size)
+{ return PF(dataset_init_width)(ds, initial_size, sizeof(long)); }
+
+int PF(dataset_init_width)(PS(dataset_t)* ds, size_t initial_size,
+                           unsigned int width)
 {
-    ds->data = malloc(initial_size * sizeof(long));
+    memset(ds, 0, sizeof(PS(dataset_t)));
+    if (width != sizeof(long) && width != sizeof(int32_t) &&
+        width != sizeof(uint16_t))
+    { return LIBSCA_INVALID_INPUT; }
+
+    ds->data = malloc(initial_size * width);
     if (!ds->data)
     { return LIBSCA_ALLOC_FAILURE; }
 
-    ds->size = 0;
     ds->capacity = initial_size;
+    ds->width = width;
     return LIBSCA_SUCCESS;
 }
 
 void PF(dataset_reset)(PS(dataset_t)* ds)
-{ ds->size = 0; }
+{
+    ds->size = 0;
+    ds->discarded = 0;
+    ds->overflow_size = 0;
+}
 
 void PF(dataset_free)(PS(dataset_t)* ds)
 {
     free(ds->data);
+    free(ds->overflow);
+    ds->data = NULL;
+    ds->overflow = NULL;
     ds->size = 0;
     ds->capacity = 0;
+    ds->discarded = 0;
+    ds->overflow_size = 0;
+    ds->overflow_capacity = 0;
 }
 
-int PF(dataset_add)(PS(dataset_t)* ds, long value)
+// Helper function that records a value too wide for the dataset's entries in
+// its overflow table.
+static int LF(dataset_add_overflow)(PS(dataset_t)* ds, size_t index,
+                                    long value)
 {
-    // if there's room, add and return
-    if (ds->capacity > 0 && ds->size < ds->capacity)
+    if (ds->overflow_size == ds->overflow_capacity)
     {
-        ds->data[ds->size++] = value;
-        return LIBSCA_SUCCESS;
+        size_t new_cap = (ds->overflow_capacity + 1) * 2;
+        PS(dataset_overflow_t)* overflow =
+            realloc(ds->overflow, new_cap * sizeof(PS(dataset_overflow_t)));
+        if (!overflow)
+        { return LIBSCA_ALLOC_FAILURE; }
+        ds->overflow = overflow;
+        ds->overflow_capacity = new_cap;
     }
 
-    // otherwise, reallocate the buffer, roughly doubling in size
-    size_t new_cap = (ds->capacity + 1) * 2;
-    ds->data = realloc(ds->data, new_cap * sizeof(long));
-    if (!ds->data)
-    { return LIBSCA_ALLOC_FAILURE; }
+    ds->overflow[ds->overflow_size].index = index;
+    ds->overflow[ds->overflow_size].value = value;
+    ds->overflow_size++;
+    return LIBSCA_SUCCESS;
+}
 
-    // update capacity and add
-    ds->capacity = new_cap;
-    ds->data[ds->size++] = value;
+// Helper function that writes a value into the slot at the given index,
+// spilling it into the overflow table if it doesn't fit. (Overflow entries
+// must be written in increasing order of index.)
+static int LF(dataset_put)(PS(dataset_t)* ds, size_t index, long value)
+{
+    if (ds->width == sizeof(uint16_t))
+    {
+        if (value >= 0 && value < STATS_SENTINEL16)
+        {
+            ds->data16[index] = (uint16_t) value;
+            return LIBSCA_SUCCESS;
+        }
+        ds->data16[index] = STATS_SENTINEL16;
+        return LF(dataset_add_overflow)(ds, index, value);
+    }
+    if (ds->width == sizeof(int32_t))
+    {
+        if (value >= INT32_MIN && value < STATS_SENTINEL32)
+        {
+            ds->data32[index] = (int32_t) value;
+            return LIBSCA_SUCCESS;
+        }
+        ds->data32[index] = STATS_SENTINEL32;
+        return LF(dataset_add_overflow)(ds, index, value);
+    }
+    ds->data[index] = value;
     return LIBSCA_SUCCESS;
 }
 
+int PF(dataset_add)(PS(dataset_t)* ds, long value)
+{
+    // if there's no room, reallocate the buffer, roughly doubling in size
+    if (ds->size >= ds->capacity)
+    {
+        size_t new_cap = (ds->capacity + 1) * 2;
+        void* data = realloc(ds->data, new_cap * ds->width);
+        if (!data)
+        { return LIBSCA_ALLOC_FAILURE; }
+        ds->data = data;
+        ds->capacity = new_cap;
+    }
+
+    int result = LF(dataset_put)(ds, ds->size, value);
+    if (result == LIBSCA_SUCCESS)
+    { ds->size++; }
+    return result;
+}
+
+// Helper function that looks up the value of a narrow entry holding a
+// sentinel, by binary-searching the overflow table (which is kept in order of
+// index).
+static long LF(dataset_overflow_value)(PS(dataset_t)* ds, size_t index)
+{
+    size_t low = 0;
+    size_t high = ds->overflow_size;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (ds->overflow[mid].index < index)
+        { low = mid + 1; }
+        else
+        { high = mid; }
+    }
+    return low < ds->overflow_size ? ds->overflow[low].value : 0;
+}
+
+long PF(dataset_get)(PS(dataset_t)* ds, size_t index)
+{
+    if (ds->width == sizeof(uint16_t))
+    {
+        uint16_t v = ds->data16[index];
+        return v == STATS_SENTINEL16 ? LF(dataset_overflow_value)(ds, index) : v;
+    }
+    if (ds->width == sizeof(int32_t))
+    {
+        int32_t v = ds->data32[index];
+        return v == STATS_SENTINEL32 ? LF(dataset_overflow_value)(ds, index) : v;
+    }
+    return ds->data[index];
+}
+
+// Helper function that copies the dataset's entries into a new array of
+// 64-bit values. Returns NULL on failure.
+static long* LF(dataset_widen)(PS(dataset_t)* ds)
+{
+    long* values = malloc((ds->size > 0 ? ds->size : 1) * sizeof(long));
+    if (!values)
+    { return NULL; }
+    for (size_t i = 0; i < ds->size; i++)
+    { values[i] = PF(dataset_get)(ds, i); }
+    return values;
+}
+
+// Helper function that overwrites the dataset's entries with 'n' values (which
+// must fit in its current capacity), rebuilding the overflow table.
+static void LF(dataset_store)(PS(dataset_t)* ds, long* values, size_t n)
+{
+    ds->overflow_size = 0;
+    for (size_t i = 0; i < n; i++)
+    { LF(dataset_put)(ds, i, values[i]); }
+    ds->size = n;
+}
+
 ssize_t PF(dataset_find)(PS(dataset_t)* ds, long value)
 {
-    for (ssize_t i = 0; i < ds->size; i++)
+    for (size_t i = 0; i < ds->size; i++)
     {
-        if (ds->data[i] == value)
-        { return i; }
+        if (PF(dataset_get)(ds, i) == value)
+        { return (ssize_t) i; }
     }
     return -1;
 }
@@ -76,9 +221,296 @@ static int LF(dataset_sort_cmp)(const void* a, const void* b)
     return ia < ib ? -1 : 1;
 }
 
+// Helper function that returns the radix sort digit (byte) of 'value' at bit
+// offset 'shift', relative to the minimum value being sorted.
+static inline unsigned int LF(stats_digit)(long value, long min, int shift)
+{ return (((unsigned long) value - (unsigned long) min) >> shift) & 0xff; }
+
+// Helper function that sorts 'n' values in place. Timing samples are almost
+// always small, non-negative integers packed into a narrow range, so rather
+// than comparison-sorting them:
+//  - Values spanning a range no larger than the number of values (or
+//    STATS_COUNTING_MAX_RANGE) are counting-sorted in a single pass.
+//  - Everything else is LSD radix-sorted one byte at a time, relative to the
+//    minimum value (so negative values sort correctly, and only the bytes the
+//    range actually spans need a pass).
+// 'tmp' must hold 'n' values. If it's NULL (or there are very few values),
+// this falls back to qsort().
+static void LF(stats_sort)(long* data, size_t n, long* tmp)
+{
+    if (n < STATS_RADIX_MIN || !tmp)
+    {
+        qsort(data, n, sizeof(long), LF(dataset_sort_cmp));
+        return;
+    }
+
+    long min = data[0];
+    long max = data[0];
+    for (size_t i = 1; i < n; i++)
+    {
+        if (data[i] < min) { min = data[i]; }
+        if (data[i] > max) { max = data[i]; }
+    }
+    unsigned long range = (unsigned long) max - (unsigned long) min;
+
+    // counting sort: tally each value, then write them back out in order
+    if (range < STATS_COUNTING_MAX_RANGE && range <= n)
+    {
+        size_t* counts = calloc(range + 1, sizeof(size_t));
+        if (counts)
+        {
+            for (size_t i = 0; i < n; i++)
+            { counts[(unsigned long) data[i] - (unsigned long) min]++; }
+            size_t k = 0;
+            for (unsigned long v = 0; v <= range; v++)
+            {
+                for (size_t c = 0; c < counts[v]; c++)
+                { data[k++] = (long) ((unsigned long) min + v); }
+            }
+            free(counts);
+            return;
+        }
+    }
+
+    // radix sort: one stable scatter per byte of the range
+    long* src = data;
+    long* dst = tmp;
+    for (int shift = 0; shift < 64 && (range >> shift) > 0; shift += 8)
+    {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < n; i++)
+        { counts[LF(stats_digit)(src[i], min, shift)]++; }
+
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++)
+        {
+            size_t c = counts[d];
+            counts[d] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++)
+        { dst[counts[LF(stats_digit)(src[i], min, shift)]++] = src[i]; }
+
+        long* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != data)
+    { memcpy(data, src, n * sizeof(long)); }
+}
+
+// Helper function that folds the minimum, maximum, and sum of 'n' 16-bit
+// entries (skipping sentinels) into '*min', '*max', and '*sum'. On x86, eight
+// entries are reduced at a time with SSE2.
+static void LF(stats_reduce16)(const uint16_t* data, size_t n, long* min,
+                               long* max, long* sum)
+{
+    long lo = *min;
+    long hi = *max;
+    long total = *sum;
+    size_t i = 0;
+
+    #if (ISA == ISA_X86)
+    // SSE2 only compares signed 16-bit lanes, so entries are biased by 0x8000
+    // (which maps [0, 65535] onto [-32768, 32767] in the same order). The
+    // sentinel is the largest entry, so it never lowers a lane's minimum; it's
+    // zeroed before taking the maximum and the sum.
+    const __m128i bias = _mm_set1_epi16((short) 0x8000);
+    const __m128i sentinel = _mm_set1_epi16((short) STATS_SENTINEL16);
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmin = _mm_xor_si128(sentinel, bias);
+    __m128i vmax = bias;
+    __m128i sum_low = zero;
+    __m128i sum_high = zero;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+        __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi16(v, sentinel), v);
+        vmin = _mm_min_epi16(vmin, _mm_xor_si128(v, bias));
+        vmax = _mm_max_epi16(vmax, _mm_xor_si128(valid, bias));
+
+        // the low and high bytes of each entry are summed separately (into
+        // two 64-bit lanes each), so the sums can't overflow
+        sum_low = _mm_add_epi64(sum_low,
+                                _mm_sad_epu8(_mm_and_si128(valid, low_bytes),
+                                             zero));
+        sum_high = _mm_add_epi64(sum_high,
+                                 _mm_sad_epu8(_mm_srli_epi16(valid, 8), zero));
+    }
+
+    uint16_t mins[8];
+    uint16_t maxes[8];
+    uint64_t lows[2];
+    uint64_t highs[2];
+    _mm_storeu_si128((__m128i*) mins, _mm_xor_si128(vmin, bias));
+    _mm_storeu_si128((__m128i*) maxes, _mm_xor_si128(vmax, bias));
+    _mm_storeu_si128((__m128i*) lows, sum_low);
+    _mm_storeu_si128((__m128i*) highs, sum_high);
+
+    // a lane whose minimum is still the sentinel never saw a valid entry (and
+    // its maximum of zero is only meaningful if some other lane did)
+    int seen = 0;
+    for (int j = 0; j < 8; j++)
+    {
+        if (mins[j] != STATS_SENTINEL16)
+        {
+            seen = 1;
+            lo = MIN(lo, (long) mins[j]);
+        }
+    }
+    for (int j = 0; seen && j < 8; j++)
+    { hi = MAX(hi, (long) maxes[j]); }
+    total += (long) (lows[0] + lows[1] + ((highs[0] + highs[1]) << 8));
+    #endif
+
+    for (; i < n; i++)
+    {
+        long v = data[i];
+        int valid = v != STATS_SENTINEL16;
+        lo = valid && v < lo ? v : lo;
+        hi = valid && v > hi ? v : hi;
+        total += valid ? v : 0;
+    }
+
+    *min = lo;
+    *max = hi;
+    *sum = total;
+}
+
+// Helper function that finds the range of a 16-bit dataset's entries (not
+// including its overflow values), for sizing a histogram. Returns zero if
+// there are no 16-bit entries, or if their range is wider than the number of
+// entries (in which case sorting them is cheaper than counting them).
+static int LF(dataset_range16)(PS(dataset_t)* ds, long* min, long* max)
+{
+    long sum = 0;
+    *min = LONG_MAX;
+    *max = LONG_MIN;
+    LF(stats_reduce16)(ds->data16, ds->size, min, max, &sum);
+    return *min <= *max && (size_t) (*max - *min) <= ds->size;
+}
+
+// Helper function that counting-sorts a dataset of 16-bit entries in place,
+// without widening it. Overflowing values all sort outside the 16-bit range
+// (negative ones before it and large ones after it), so the sorted overflow
+// values are placed around the sorted 16-bit entries. The histogram only spans
+// the entries' range; returns LIBSCA_FAILURE (leaving the dataset untouched)
+// if that's wider than the number of entries.
+static int LF(dataset_sort16)(PS(dataset_t)* ds)
+{
+    long min, max;
+    if (!LF(dataset_range16)(ds, &min, &max))
+    { return LIBSCA_FAILURE; }
+    size_t* counts = calloc(max - min + 1, sizeof(size_t));
+    if (!counts)
+    { return LIBSCA_ALLOC_FAILURE; }
+    for (size_t i = 0; i < ds->size; i++)
+    {
+        if (ds->data16[i] != STATS_SENTINEL16)
+        { counts[ds->data16[i] - min]++; }
+    }
+
+    // sort the overflow values (there are few of them) and find how many are
+    // negative
+    size_t spill = ds->overflow_size;
+    long* overflow = malloc((spill > 0 ? spill : 1) * sizeof(long));
+    if (!overflow)
+    {
+        free(counts);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+    for (size_t i = 0; i < spill; i++)
+    { overflow[i] = ds->overflow[i].value; }
+    qsort(overflow, spill, sizeof(long), LF(dataset_sort_cmp));
+    size_t negative = 0;
+    while (negative < spill && overflow[negative] < 0)
+    { negative++; }
+
+    // lay out the negative overflows, the 16-bit entries, then the rest
+    size_t k = 0;
+    ds->overflow_size = 0;
+    for (size_t i = 0; i < negative; i++)
+    { LF(dataset_put)(ds, k++, overflow[i]); }
+    for (long v = min; v <= max; v++)
+    {
+        for (size_t c = 0; c < counts[v - min]; c++)
+        { ds->data16[k++] = (uint16_t) v; }
+    }
+    for (size_t i = negative; i < spill; i++)
+    { LF(dataset_put)(ds, k++, overflow[i]); }
+
+    free(overflow);
+    free(counts);
+    return LIBSCA_SUCCESS;
+}
+
 void PF(dataset_sort)(PS(dataset_t)* ds)
 {
-    qsort(ds->data, ds->size, sizeof(long), LF(dataset_sort_cmp));
+    if (ds->width == sizeof(uint16_t) &&
+        LF(dataset_sort16)(ds) == LIBSCA_SUCCESS)
+    { return; }
+
+    // other narrow entries are widened, sorted, and narrowed again
+    long* values = ds->width == sizeof(long) ? ds->data : LF(dataset_widen)(ds);
+    if (!values)
+    { return; }
+    long* tmp = malloc(ds->size * sizeof(long));
+    LF(stats_sort)(values, ds->size, tmp);
+    free(tmp);
+    if (values != ds->data)
+    {
+        LF(dataset_store)(ds, values, ds->size);
+        free(values);
+    }
+}
+
+// Helper function that computes the minimum, maximum, and sum of the dataset
+// in a single pass. 16-bit entries (the width timing samples are collected
+// in) are reduced with SSE2; wider entries are reduced one at a time.
+static void LF(dataset_reduce)(PS(dataset_t)* ds, long* min, long* max,
+                               long* sum)
+{
+    long lo = LONG_MAX;
+    long hi = LONG_MIN;
+    long total = 0;
+    size_t n = ds->size;
+    if (ds->width == sizeof(uint16_t))
+    { LF(stats_reduce16)(ds->data16, n, &lo, &hi, &total); }
+    else if (ds->width == sizeof(int32_t))
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            long v = ds->data32[i];
+            int valid = v != STATS_SENTINEL32;
+            lo = valid && v < lo ? v : lo;
+            hi = valid && v > hi ? v : hi;
+            total += valid ? v : 0;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            long v = ds->data[i];
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+            total += v;
+        }
+    }
+
+    // fold in the overflow values
+    for (size_t i = 0; i < ds->overflow_size; i++)
+    {
+        long v = ds->overflow[i].value;
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+        total += v;
+    }
+
+    *min = lo;
+    *max = hi;
+    *sum = total;
 }
 
 long PF(dataset_min)(PS(dataset_t)* ds)
@@ -86,13 +518,9 @@ long PF(dataset_min)(PS(dataset_t)* ds)
     if (ds->size == 0)
     { return 0; }
 
-    long result = ds->data[0];
-    for (size_t i = 0; i < ds->size; i++)
-    {
-        if (ds->data[i] < result)
-        { result = ds->data[i]; }
-    }
-    return result;
+    long min, max, sum;
+    LF(dataset_reduce)(ds, &min, &max, &sum);
+    return min;
 }
 
 long PF(dataset_max)(PS(dataset_t)* ds)
@@ -100,13 +528,9 @@ long PF(dataset_max)(PS(dataset_t)* ds)
     if (ds->size == 0)
     { return 0; }
 
-    long result = ds->data[0];
-    for (size_t i = 0; i < ds->size; i++)
-    {
-        if (ds->data[i] > result)
-        { result = ds->data[i]; }
-    }
-    return result;
+    long min, max, sum;
+    LF(dataset_reduce)(ds, &min, &max, &sum);
+    return max;
 }
 
 long PF(dataset_average)(PS(dataset_t)* ds)
@@ -114,29 +538,472 @@ long PF(dataset_average)(PS(dataset_t)* ds)
     if (ds->size == 0)
     { return 0; }
 
-    long result = 0;
-    for (size_t i = 0; i < ds->size; i++)
-    { result += ds->data[i]; }
-    return result / ds->size;
+    long min, max, sum;
+    LF(dataset_reduce)(ds, &min, &max, &sum);
+    return sum / (long) ds->size;
 }
 
 long PF(dataset_median)(PS(dataset_t)* ds)
+{ return PF(dataset_percentile)(ds, 0.5); }
+
+int PF(dataset_merge)(PS(dataset_t)* dst, PS(dataset_t)* srcs, size_t count)
 {
-    if (ds->size == 0)
+    // grow the destination once, up front
+    size_t total = dst->size;
+    for (size_t i = 0; i < count; i++)
+    { total += srcs[i].size; }
+    if (total > dst->capacity)
+    {
+        void* data = realloc(dst->data, total * dst->width);
+        if (!data)
+        { return LIBSCA_ALLOC_FAILURE; }
+        dst->data = data;
+        dst->capacity = total;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // 64-bit entries can be copied wholesale; anything else goes through
+        // the overflow-aware path, one entry at a time
+        PS(dataset_t)* src = &srcs[i];
+        if (dst->width == sizeof(long) && src->width == sizeof(long))
+        {
+            memcpy(dst->data + dst->size, src->data, src->size * sizeof(long));
+            dst->size += src->size;
+        }
+        else
+        {
+            for (size_t j = 0; j < src->size; j++)
+            {
+                int result = PF(dataset_add)(dst, PF(dataset_get)(src, j));
+                if (result != LIBSCA_SUCCESS)
+                { return result; }
+            }
+        }
+        dst->discarded += src->discarded;
+    }
+    return LIBSCA_SUCCESS;
+}
+
+
+// =========================== Parallel Reduction =========================== //
+// Work assigned to a single thread by the parallel functions below. Each job
+// covers the values in [start, end) of 'src'.
+typedef struct LS(stats_job)
+{
+    long* src;                  // values to operate on
+    long* dst;                  // output (sorting and merging only)
+    size_t start;               // first index of the job's range
+    size_t mid;                 // end of the first run (merging only)
+    size_t end;                 // end of the job's range
+    long min;                   // smallest value in the range
+    long max;                   // largest value in the range
+    size_t* counts;             // histogram (counting only)
+} LS(stats_job_t);
+
+// Helper function that runs 'fn' on each of the 'count' jobs, one per thread.
+// The first job runs on the calling thread, as do any whose threads couldn't
+// be created.
+static void LF(stats_run)(void* (*fn)(void*), LS(stats_job_t)* jobs,
+                          size_t count)
+{
+    pthread_t tids[count];
+    int started[count];
+    for (size_t i = 1; i < count; i++)
+    { started[i] = !pthread_create(&tids[i], NULL, fn, &jobs[i]); }
+
+    fn(&jobs[0]);
+    for (size_t i = 1; i < count; i++)
+    {
+        if (started[i])
+        { pthread_join(tids[i], NULL); }
+        else
+        { fn(&jobs[i]); }
+    }
+}
+
+// Helper function that splits [0, n) into 'count' roughly-equal jobs.
+static void LF(stats_split)(LS(stats_job_t)* jobs, size_t count,
+                            long* src, long* dst, size_t n)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        memset(&jobs[i], 0, sizeof(LS(stats_job_t)));
+        jobs[i].src = src;
+        jobs[i].dst = dst;
+        jobs[i].start = (n * i) / count;
+        jobs[i].end = (n * (i + 1)) / count;
+    }
+}
+
+// Thread functions for the parallel sort: sorting a chunk in place (using the
+// matching chunk of 'dst' as scratch space), and merging two adjacent sorted
+// runs from 'src' into 'dst'.
+static void* LF(stats_sort_worker)(void* arg)
+{
+    LS(stats_job_t)* job = arg;
+    LF(stats_sort)(job->src + job->start, job->end - job->start,
+                   job->dst + job->start);
+    return NULL;
+}
+
+static void* LF(stats_merge_worker)(void* arg)
+{
+    LS(stats_job_t)* job = arg;
+    size_t a = job->start;
+    size_t b = job->mid;
+    size_t k = job->start;
+    while (a < job->mid && b < job->end)
+    {
+        if (job->src[a] <= job->src[b])
+        { job->dst[k++] = job->src[a++]; }
+        else
+        { job->dst[k++] = job->src[b++]; }
+    }
+    while (a < job->mid)
+    { job->dst[k++] = job->src[a++]; }
+    while (b < job->end)
+    { job->dst[k++] = job->src[b++]; }
+    return NULL;
+}
+
+// Thread functions for the parallel percentile: finding a chunk's range, and
+// building a histogram of a chunk relative to 'min'.
+static void* LF(stats_range_worker)(void* arg)
+{
+    LS(stats_job_t)* job = arg;
+    job->min = job->src[job->start];
+    job->max = job->src[job->start];
+    for (size_t i = job->start; i < job->end; i++)
+    {
+        if (job->src[i] < job->min) { job->min = job->src[i]; }
+        if (job->src[i] > job->max) { job->max = job->src[i]; }
+    }
+    return NULL;
+}
+
+static void* LF(stats_count_worker)(void* arg)
+{
+    LS(stats_job_t)* job = arg;
+    for (size_t i = job->start; i < job->end; i++)
+    { job->counts[(unsigned long) job->src[i] - (unsigned long) job->min]++; }
+    return NULL;
+}
+
+// Helper function that clamps the number of threads so each one gets at least
+// STATS_PARALLEL_MIN values.
+static unsigned int LF(stats_threads)(size_t n, unsigned int threads)
+{
+    if (threads == 0)
+    { threads = 1; }
+    if (n / STATS_PARALLEL_MIN < threads)
+    { threads = n / STATS_PARALLEL_MIN > 0 ? n / STATS_PARALLEL_MIN : 1; }
+    return threads;
+}
+
+int PF(dataset_sort_parallel)(PS(dataset_t)* ds, unsigned int threads)
+{
+    size_t n = ds->size;
+    threads = LF(stats_threads)(n, threads);
+    if (threads == 1 || ds->width != sizeof(long))
+    {
+        PF(dataset_sort)(ds);
+        return LIBSCA_SUCCESS;
+    }
+
+    long* tmp = malloc(n * sizeof(long));
+    if (!tmp)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    // sort each chunk independently
+    LS(stats_job_t) jobs[threads];
+    LF(stats_split)(jobs, threads, ds->data, tmp, n);
+    LF(stats_run)(LF(stats_sort_worker), jobs, threads);
+
+    // then merge neighboring runs pairwise (in parallel) until one remains,
+    // swapping the source and destination buffers after each round
+    size_t runs = threads;
+    size_t bounds[threads + 1];
+    for (size_t i = 0; i < threads; i++)
+    { bounds[i] = jobs[i].start; }
+    bounds[threads] = n;
+
+    long* src = ds->data;
+    long* dst = tmp;
+    while (runs > 1)
+    {
+        size_t merges = runs / 2;
+        for (size_t i = 0; i < merges; i++)
+        {
+            memset(&jobs[i], 0, sizeof(LS(stats_job_t)));
+            jobs[i].src = src;
+            jobs[i].dst = dst;
+            jobs[i].start = bounds[2 * i];
+            jobs[i].mid = bounds[(2 * i) + 1];
+            jobs[i].end = bounds[(2 * i) + 2];
+        }
+        LF(stats_run)(LF(stats_merge_worker), jobs, merges);
+
+        // an odd run out is carried over as-is
+        if (runs % 2)
+        {
+            size_t start = bounds[runs - 1];
+            memcpy(dst + start, src + start, (n - start) * sizeof(long));
+        }
+
+        // every other boundary disappears
+        size_t next = 0;
+        for (size_t i = 0; i < runs; i += 2)
+        { bounds[next++] = bounds[i]; }
+        runs = next;
+        bounds[runs] = n;
+
+        long* swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != ds->data)
+    { memcpy(ds->data, src, n * sizeof(long)); }
+    free(tmp);
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function that finds the value of the given rank in a dataset of
+// narrow (16- or 32-bit) entries. 16-bit entries are histogrammed in place
+// (over their range, if it's no wider than the number of entries), with the
+// overflow values (which all lie outside the 16-bit range) ranked around
+// them; everything else is ranked in a sorted, widened copy.
+static long LF(dataset_percentile_narrow)(PS(dataset_t)* ds, size_t rank)
+{
+    long min, max;
+    if (ds->width == sizeof(int32_t) || !LF(dataset_range16)(ds, &min, &max))
+    {
+        PS(dataset_t) copy = {
+            .data = LF(dataset_widen)(ds),
+            .size = ds->size,
+            .capacity = ds->size,
+            .width = sizeof(long)
+        };
+        if (!copy.data)
+        { return 0; }
+        PF(dataset_sort)(&copy);
+        long result = copy.data[rank];
+        free(copy.data);
+        return result;
+    }
+
+    // sort the overflow values, splitting them into those below and above the
+    // 16-bit range
+    size_t spill = ds->overflow_size;
+    long* overflow = malloc((spill > 0 ? spill : 1) * sizeof(long));
+    if (!overflow)
     { return 0; }
+    for (size_t i = 0; i < spill; i++)
+    { overflow[i] = ds->overflow[i].value; }
+    qsort(overflow, spill, sizeof(long), LF(dataset_sort_cmp));
+    size_t negative = 0;
+    while (negative < spill && overflow[negative] < 0)
+    { negative++; }
+    size_t above = ds->size - (spill - negative);
+    if (rank < negative || rank >= above)
+    {
+        long result = overflow[rank < negative ? rank : negative + rank - above];
+        free(overflow);
+        return result;
+    }
+    free(overflow);
 
-    // create a copy of the dataset's array and sort it
-    long* copy = malloc(ds->size * sizeof(long));
-    memcpy(copy, ds->data, ds->size * sizeof(long));
-    qsort(copy, ds->size, sizeof(long), LF(dataset_sort_cmp));
-    
-    // compute the middle index and return it
-    size_t mid = ds->size / 2;
-    long result = copy[mid];
-    free(copy);
+    size_t* counts = calloc(max - min + 1, sizeof(size_t));
+    if (!counts)
+    { return 0; }
+    for (size_t i = 0; i < ds->size; i++)
+    {
+        if (ds->data16[i] != STATS_SENTINEL16)
+        { counts[ds->data16[i] - min]++; }
+    }
+    size_t seen = negative;
+    long result = 0;
+    for (long v = min; v <= max; v++)
+    {
+        seen += counts[v - min];
+        if (seen > rank)
+        {
+            result = v;
+            break;
+        }
+    }
+    free(counts);
     return result;
 }
 
+long PF(dataset_percentile)(PS(dataset_t)* ds, double p)
+{ return PF(dataset_percentile_parallel)(ds, p, 1); }
+
+long PF(dataset_percentile_parallel)(PS(dataset_t)* ds, double p,
+                                     unsigned int threads)
+{
+    size_t n = ds->size;
+    if (n == 0)
+    { return 0; }
+    if (p < 0.0) { p = 0.0; }
+    if (p > 1.0) { p = 1.0; }
+    size_t rank = (size_t) (p * n);
+    if (rank >= n)
+    { rank = n - 1; }
+    if (ds->width != sizeof(long))
+    { return LF(dataset_percentile_narrow)(ds, rank); }
+
+    // find the range of the values
+    threads = LF(stats_threads)(n, threads);
+    LS(stats_job_t) jobs[threads];
+    LF(stats_split)(jobs, threads, ds->data, NULL, n);
+    LF(stats_run)(LF(stats_range_worker), jobs, threads);
+    long min = jobs[0].min;
+    long max = jobs[0].max;
+    for (unsigned int t = 1; t < threads; t++)
+    {
+        if (jobs[t].min < min) { min = jobs[t].min; }
+        if (jobs[t].max > max) { max = jobs[t].max; }
+    }
+    unsigned long range = (unsigned long) max - (unsigned long) min;
+
+    // if the range is narrow enough (and no wider than the number of values,
+    // so clearing and walking the histogram doesn't cost more than sorting
+    // would), histogram the values (one histogram per thread, summed
+    // afterwards) and walk the histogram to the rank we want; this needs
+    // neither a copy of the data nor a sort
+    if (range < STATS_COUNTING_MAX_RANGE && range <= n)
+    {
+        int ok = 1;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            jobs[t].min = min;
+            jobs[t].counts = calloc(range + 1, sizeof(size_t));
+            ok = ok && jobs[t].counts;
+        }
+        long result = 0;
+        if (ok)
+        {
+            LF(stats_run)(LF(stats_count_worker), jobs, threads);
+            size_t seen = 0;
+            for (unsigned long v = 0; v <= range; v++)
+            {
+                for (unsigned int t = 0; t < threads; t++)
+                { seen += jobs[t].counts[v]; }
+                if (seen > rank)
+                {
+                    result = (long) ((unsigned long) min + v);
+                    break;
+                }
+            }
+        }
+        for (unsigned int t = 0; t < threads; t++)
+        { free(jobs[t].counts); }
+        if (ok)
+        { return result; }
+    }
+
+    // otherwise, sort a copy of the values
+    PS(dataset_t) copy = {
+        .data = malloc(n * sizeof(long)),
+        .size = n,
+        .capacity = n,
+        .width = sizeof(long)
+    };
+    if (!copy.data)
+    { return 0; }
+    memcpy(copy.data, ds->data, n * sizeof(long));
+    PF(dataset_sort_parallel)(&copy, threads);
+    long result = copy.data[rank];
+    free(copy.data);
+    return result;
+}
+
+
+// =========================== Outlier Filtering ============================ //
+// Minimum number of samples in a filter's window before it starts rejecting
+// samples based on their distance from the median
+#define FILTER_MIN_SAMPLES 8
+// Scale factor that makes the MAD a consistent estimator of the standard
+// deviation for normally-distributed data
+#define FILTER_MAD_SCALE 1.4826
+
+void PF(filter_init)(PS(filter_t)* f)
+{
+    PS(config_t)* conf = PF(config_get)();
+    memset(f, 0, sizeof(PS(filter_t)));
+    f->mad_cutoff = conf->filter_mad_cutoff;
+    f->max_cycles = conf->filter_max_cycles;
+}
+
+// Helper function that returns the median of 'count' values (reordering them
+// in the process). The window is small, so an insertion sort is plenty.
+static long LF(filter_median)(long* values, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        long v = values[i];
+        size_t j = i;
+        for (; j > 0 && values[j - 1] > v; j--)
+        { values[j] = values[j - 1]; }
+        values[j] = v;
+    }
+    return values[count / 2];
+}
+
+int PF(filter_accept)(PS(filter_t)* f, long value)
+{
+    if (f->max_cycles > 0 && value > (long) f->max_cycles)
+    { return 0; }
+
+    // once the window holds enough samples, compute its median and MAD and
+    // reject samples too far from the median (the MAD is floored at one
+    // cycle, since a window of identical samples would otherwise reject
+    // anything that differs at all)
+    if (f->mad_cutoff > 0.0 && f->count >= FILTER_MIN_SAMPLES)
+    {
+        long values[LIBSCA_FILTER_WINDOW];
+        memcpy(values, f->window, f->count * sizeof(long));
+        long median = LF(filter_median)(values, f->count);
+        for (size_t i = 0; i < f->count; i++)
+        { values[i] = labs(values[i] - median); }
+        long mad = LF(filter_median)(values, f->count);
+
+        double limit = f->mad_cutoff * FILTER_MAD_SCALE * (mad > 0 ? mad : 1);
+        if (labs(value - median) > limit)
+        {
+            // a full window of consecutive rejections means the stream has
+            // moved, not that every sample is an outlier
+            if (++f->rejected_run >= LIBSCA_FILTER_WINDOW)
+            {
+                f->count = 0;
+                f->next = 0;
+                f->rejected_run = 0;
+            }
+            return 0;
+        }
+    }
+
+    // accept the sample into the window
+    f->rejected_run = 0;
+    f->window[f->next] = value;
+    f->next = (f->next + 1) % LIBSCA_FILTER_WINDOW;
+    if (f->count < LIBSCA_FILTER_WINDOW)
+    { f->count++; }
+    return 1;
+}
+
+int PF(dataset_add_filtered)(PS(dataset_t)* ds, PS(filter_t)* f, long value)
+{
+    if (!PF(filter_accept)(f, value))
+    {
+        ds->discarded++;
+        return LIBSCA_SUCCESS;
+    }
+    return PF(dataset_add)(ds, value);
+}
+
 
 // ============================== Counter Sets ============================== //
 int PF(countset_init)(PS(countset_t)* cs, size_t initial_size)
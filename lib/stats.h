@@ -5,24 +5,59 @@
 #define LIBSCA_STATS_H
 
 // Imports
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
 #include "symbols.h"
 #include "error.h"
 
 
 // ================================ Datasets ================================ //
+// An entry in a dataset's overflow table (see below).
+typedef struct LS(dataset_overflow)
+{
+    size_t index;       // index of the entry in the dataset
+    long value;         // the entry's full value
+} PS(dataset_overflow_t);
+
 // Essentially a wrapper for an array that comes with a function interface for
 // allocating, freeing, adding, and doing mathematical operations.
+//
+// Entries are stored as 64-bit integers by default, but timing samples rarely
+// need more than 16 bits, so a dataset can instead be created with 32- or
+// 16-bit entries (which quarters the memory, and memory bandwidth, of large
+// sample arrays). Values too large (or negative, for 16-bit entries) to fit
+// are stored as a sentinel (the width's largest value), with the real value
+// kept in a small side table of overflow entries. This is all hidden behind
+// the functions below; use 'dataset_get()' rather than indexing the arrays
+// of a dataset whose width might not be 64 bits.
 typedef struct LS(dataset)
 {
-    long* data;         // dynamically-allocated array
+    union
+    {
+        long* data;         // dynamically-allocated array (64-bit entries)
+        int32_t* data32;    // the same array, for 32-bit entries
+        uint16_t* data16;   // the same array, for 16-bit entries
+    };
     size_t size;        // current used size
     size_t capacity;    // current capacity
+    size_t discarded;   // number of samples rejected by a filter
+    unsigned int width; // size of each entry (8, 4, or 2 bytes)
+    PS(dataset_overflow_t)* overflow;   // values that don't fit the width
+    size_t overflow_size;       // number of used 'overflow' entries
+    size_t overflow_capacity;   // capacity of 'overflow'
 } PS(dataset_t);
 
 // Allocates memory for the dataset given the initial size (in 64-bit integers,
 // not in bytes).
 int PF(dataset_init)(PS(dataset_t)* ds, size_t initial_size);
 
+// Same as 'dataset_init()', but stores each entry in 'width' bytes (8, 4, or
+// 2) rather than in a 64-bit integer.
+// Returns a result enum.
+int PF(dataset_init_width)(PS(dataset_t)* ds, size_t initial_size,
+                           unsigned int width);
+
 // Resets a dataset to allow for memory reuse.
 void PF(dataset_reset)(PS(dataset_t)* ds);
 
@@ -32,11 +67,16 @@ void PF(dataset_free)(PS(dataset_t)* ds);
 // Adds an entry to the dataset, increasing capacity if necessary.
 int PF(dataset_add)(PS(dataset_t)* ds, long value);
 
+// Returns the entry at the given index (which must be less than the size).
+long PF(dataset_get)(PS(dataset_t)* ds, size_t index);
+
 // Searches the dataset for the first occurrence of 'value' and returns it.
 // Returns -1 if the value couldn't be found, and the index if it was found.
 ssize_t PF(dataset_find)(PS(dataset_t)* ds, long value);
 
-// Sorts the dataset's entries.
+// Sorts the dataset's entries. Datasets of timing samples (small integers in a
+// narrow range) are counting-sorted, and others are radix-sorted; neither
+// compares entries against each other.
 void PF(dataset_sort)(PS(dataset_t)* ds);
 
 // Computes the min of the dataset and returns it.
@@ -51,6 +91,74 @@ long PF(dataset_average)(PS(dataset_t)* ds);
 // Computes the median of the dataset and returns it.
 long PF(dataset_median)(PS(dataset_t)* ds);
 
+// Computes the 'p'th percentile of the dataset (with 'p' in [0.0, 1.0]) and
+// returns it. (The dataset isn't modified; narrow ranges of values are
+// histogrammed rather than sorted.)
+long PF(dataset_percentile)(PS(dataset_t)* ds, double p);
+
+// Appends the entries of each of the 'count' datasets in 'srcs' to 'dst' (and
+// adds up their 'discarded' counts). This is used to combine the datasets
+// collected by several threads.
+// Returns a result enum.
+int PF(dataset_merge)(PS(dataset_t)* dst, PS(dataset_t)* srcs, size_t count);
+
+
+// =========================== Parallel Reduction =========================== //
+// The functions below split the work on very large datasets (hundreds of
+// millions of samples) across 'threads' threads. Datasets too small to
+// benefit (and datasets with entries narrower than 64 bits, whose
+// single-threaded paths are already bandwidth-friendly) are processed on the
+// calling thread alone.
+
+// Sorts the dataset's entries: each thread sorts a chunk, then the chunks are
+// merged pairwise (also in parallel).
+// Returns a result enum.
+int PF(dataset_sort_parallel)(PS(dataset_t)* ds, unsigned int threads);
+
+// Computes the 'p'th percentile of the dataset (with 'p' in [0.0, 1.0]): each
+// thread histograms a chunk, or, if the values span too wide a range, a copy
+// of the dataset is sorted in parallel.
+long PF(dataset_percentile_parallel)(PS(dataset_t)* ds, double p,
+                                     unsigned int threads);
+
+
+// =========================== Outlier Filtering ============================ //
+// Number of recently-accepted samples a filter keeps to estimate the median
+// and median absolute deviation (MAD) of the stream.
+#define LIBSCA_FILTER_WINDOW 32
+
+// An online filter for streams of timing samples. Interrupts and context
+// switches produce samples that are orders of magnitude larger than real cache
+// misses; a filter discards any sample that lies too far from the median of
+// the recent samples it's accepted, measured in (scaled) MADs, which unlike the
+// mean and standard deviation aren't dragged around by the outliers themselves.
+typedef struct LS(filter)
+{
+    long window[LIBSCA_FILTER_WINDOW];  // ring buffer of accepted samples
+    size_t count;               // number of valid entries in 'window'
+    size_t next;                // next slot of 'window' to overwrite
+    size_t rejected_run;        // consecutive rejections (see 'filter_accept')
+    double mad_cutoff;          // maximum distance from the median (in MADs)
+    unsigned long max_cycles;   // samples above this are always rejected
+} PS(filter_t);
+
+// Initializes a filter using the cutoffs in the library config
+// ('filter_mad_cutoff' and 'filter_max_cycles').
+void PF(filter_init)(PS(filter_t)* f);
+
+// Decides whether to keep a sample. Returns 1 if it was accepted and 0 if it
+// was rejected as an outlier. The first few samples (until the window holds
+// enough of them for a meaningful median) are only checked against the
+// 'max_cycles' ceiling. If a full window's worth of samples is rejected in a
+// row, the stream's distribution is assumed to have shifted, and the window
+// is cleared so the filter can re-learn it.
+int PF(filter_accept)(PS(filter_t)* f, long value);
+
+// Adds a sample to the dataset if the filter accepts it; otherwise, it's
+// counted in the dataset's 'discarded' field.
+// Returns a result enum.
+int PF(dataset_add_filtered)(PS(dataset_t)* ds, PS(filter_t)* f, long value);
+
 
 // ============================== Counter Sets ============================== //
 // A data structure used to count the occurrences of certain numbers.
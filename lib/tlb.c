@@ -0,0 +1,407 @@
+// Implements the functions prototyped in tlb.h.
+
+// Imports
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Local imports
+#include "libsca.h"
+#include "tlb.h"
+#include "mem.h"
+
+// Smallest number of pages swept
+#define TLB_MIN_PAGES 4
+// Minimum number of timed hops per measurement (small page counts are walked
+// several times over, so the timestamps' overhead is amortized)
+#define TLB_MIN_HOPS 262144
+// Number of times each measurement is repeated (the fastest one is kept, which
+// filters out interrupts and other noise)
+#define TLB_REPEATS 3
+// Largest associativity tried
+#define TLB_MAX_WAYS 32
+// A point whose translation cost is this many times its plateau's (and at
+// least TLB_JUMP_CYCLES above it) begins a jump to the next level; the jump
+// ends once a point is within TLB_SETTLE_CYCLES of the one before it
+#define TLB_JUMP 2.0
+#define TLB_JUMP_CYCLES 3.0
+#define TLB_SETTLE_CYCLES 1.5
+// Number of steps a level's capacity is refined in, between the last point of
+// the sweep below it and the first one past it
+#define TLB_REFINE_STEPS 8
+
+// Largest number of plateaus tracked on the latency curve
+#define TLB_MAX_PLATEAUS 6
+
+
+// ============================ Pointer Chasing ============================= //
+// Helper function that fills 'order' with the indexes 0 through 'count - 1',
+// in a random order.
+static void LF(tlb_shuffle)(size_t* order, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    { order[i] = i; }
+    PF(rand_shuffle)(order, count, NULL);
+}
+
+// Helper function that links the nodes at the given offsets of 'buf' (in
+// order) into a single cycle and returns its first node.
+static void** LF(tlb_link)(char* buf, size_t* offsets, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    { *(void**) (buf + offsets[i]) = buf + offsets[(i + 1) % count]; }
+    return (void**) (buf + offsets[0]);
+}
+
+// Helper function that walks a linked set of 'nodes' nodes and returns the
+// average number of cycles per hop. The set is walked once untimed to warm up
+// the caches and TLB (and fault in any pages that aren't yet), then timed
+// several times (keeping the fastest).
+static double LF(tlb_walk)(void** start, size_t nodes)
+{
+    size_t hops = nodes < TLB_MIN_HOPS ? TLB_MIN_HOPS : nodes;
+    void** p = start;
+    for (size_t i = 0; i < nodes; i++)
+    { p = (void**) *p; }
+
+    double best = 0.0;
+    for (int r = 0; r < TLB_REPEATS; r++)
+    {
+        // each load depends on the previous one, so they can't overlap
+        unsigned long cycles1 = LF(mem_cycles)();
+        for (size_t i = 0; i < hops; i++)
+        { p = (void**) *p; }
+        unsigned long cycles2 = LF(mem_cycles)();
+
+        double cycles = (double) (cycles2 - cycles1) / hops;
+        if (r == 0 || cycles < best)
+        { best = cycles; }
+    }
+
+    // hand the final pointer to the compiler so the loops aren't optimized out
+    __asm__ volatile("" : : "r" (p) : "memory");
+    return best;
+}
+
+double PF(tlb_chase)(void* buf, size_t pages, size_t page_size,
+                     size_t spacing, double* baseline)
+{
+    size_t line_size = PF(config_get)()->cache_levels[LIBSCA_CACHE_L1D].line_size;
+    if (!buf || pages == 0 || spacing == 0 || line_size < sizeof(void*) ||
+        page_size < (size_t) sysconf(_SC_PAGESIZE))
+    { return 0.0; }
+
+    size_t* order = malloc(pages * sizeof(size_t));
+    size_t* offsets = malloc(pages * sizeof(size_t));
+    if (!order || !offsets)
+    {
+        free(order);
+        free(offsets);
+        return 0.0;
+    }
+
+    // one line per page, visited in a random order (so neither the cache nor
+    // the TLB prefetchers can predict the next page). Each page's line is one
+    // line further in than the last one's, so they don't pile up in one set
+    LF(tlb_shuffle)(order, pages);
+    for (size_t i = 0; i < pages; i++)
+    {
+        offsets[i] = (order[i] * spacing * page_size) +
+                     ((order[i] * line_size) % page_size);
+    }
+    double cycles = LF(tlb_walk)(LF(tlb_link)(buf, offsets, pages), pages);
+
+    // the baseline packs the same number of lines into consecutive blocks,
+    // visited in a random order (so they're no easier to prefetch than the
+    // lines above). Each block's translation is reused by all of its lines,
+    // so as long as the blocks fit in the first-level TLB, nearly every
+    // access hits it
+    if (baseline)
+    {
+        LF(tlb_shuffle)(order, pages);
+        for (size_t i = 0; i < pages; i++)
+        { offsets[i] = order[i] * line_size; }
+        *baseline = LF(tlb_walk)(LF(tlb_link)(buf, offsets, pages), pages);
+    }
+
+    free(order);
+    free(offsets);
+    return cycles;
+}
+
+
+// =============================== TLB Probing ============================== //
+// Helper function that returns a point's translation cost (its latency less
+// its baseline's).
+static inline double LF(tlb_cost)(PS(tlb_point_t)* point)
+{ return point->cycles - point->baseline; }
+
+// Helper function that sweeps page counts from TLB_MIN_PAGES up to
+// 'max_pages', alternating between powers of two and 1.5x powers of two (so
+// common capacities like 1536 entries are measured exactly).
+static PE(result_e) LF(tlb_sweep)(PS(tlb_probe_t)* tp, void* buf,
+                                  size_t max_pages)
+{
+    // count the points first
+    size_t count = 0;
+    for (size_t pages = TLB_MIN_PAGES; pages <= max_pages; pages *= 2)
+    { count += (pages + (pages / 2) <= max_pages) ? 2 : 1; }
+
+    tp->points = calloc(count, sizeof(PS(tlb_point_t)));
+    if (!tp->points)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    for (size_t pages = TLB_MIN_PAGES; pages <= max_pages; pages *= 2)
+    {
+        size_t counts[2] = {pages, pages + (pages / 2)};
+        for (int i = 0; i < 2 && counts[i] <= max_pages; i++)
+        {
+            PS(tlb_point_t)* point = &tp->points[tp->point_count];
+            point->pages = counts[i];
+            point->cycles = PF(tlb_chase)(buf, counts[i], tp->page_size, 1,
+                                          &point->baseline);
+            if (point->cycles == 0.0)
+            { return LIBSCA_ALLOC_FAILURE; }
+            tp->point_count++;
+        }
+    }
+    return LIBSCA_SUCCESS;
+}
+
+// Helper function that splits the translation cost curve into plateaus. The
+// first plateaus are assigned to the TLB levels (in order) and the last one
+// to page walks.
+static void LF(tlb_plateaus)(PS(tlb_probe_t)* tp, void* buf)
+{
+    size_t starts[TLB_MAX_PLATEAUS];
+    double costs[TLB_MAX_PLATEAUS];
+    size_t plateaus = 0;
+
+    // walk the curve, tracking the current plateau's mean cost; once a point
+    // jumps well above it, the plateau ends, and the next one begins once the
+    // curve settles again. (The first level's cost is near zero, so a jump
+    // must clear both a ratio and a number of cycles.)
+    double sum = 0.0;
+    size_t n = 0;
+    int rising = 0;
+    for (size_t i = 0; i < tp->point_count; i++)
+    {
+        double cost = LF(tlb_cost)(&tp->points[i]);
+        if (rising)
+        {
+            if (cost > LF(tlb_cost)(&tp->points[i - 1]) + TLB_SETTLE_CYCLES)
+            { continue; }
+            rising = 0;
+        }
+
+        // (noise can push a cost slightly below zero, which the ratio
+        // shouldn't be taken against)
+        double mean = n > 0 ? sum / n : cost;
+        double floor = MAX(mean, 0.0);
+        if (n > 0 && cost > floor * TLB_JUMP && cost > floor + TLB_JUMP_CYCLES)
+        {
+            rising = 1;
+            n = 0;
+            continue;
+        }
+
+        // start a new plateau, or add to the current one
+        if (n == 0)
+        {
+            if (plateaus == TLB_MAX_PLATEAUS)
+            { break; }
+            starts[plateaus++] = i;
+            sum = 0.0;
+        }
+        sum += cost;
+        n++;
+        costs[plateaus - 1] = sum / n;
+    }
+    if (plateaus == 0)
+    { return; }
+
+    // whatever the curve ends on is treated as page walks (if the sweep ended
+    // mid-jump, its last point is the best estimate available)
+    tp->walk_latency = rising ?
+                       LF(tlb_cost)(&tp->points[tp->point_count - 1]) :
+                       costs[plateaus - 1];
+    size_t levels = rising ? plateaus : plateaus - 1;
+    if (levels > LIBSCA_TLB_LEVEL_COUNT)
+    { levels = LIBSCA_TLB_LEVEL_COUNT; }
+
+    // a level's capacity lies between the last point whose cost stays below
+    // halfway to the next level's and the first one past it; the gap between
+    // them is then narrowed down with a few more measurements. (With a
+    // cyclic traversal, a level starts missing as soon as it's full, though
+    // the pages of the probe's own code and stack compete for entries too,
+    // so this may come up a few entries short.)
+    for (size_t l = 0; l < levels; l++)
+    {
+        double next = (l + 1 < plateaus) ? costs[l + 1] : tp->walk_latency;
+        double threshold = (costs[l] + next) / 2.0;
+        // (a lone point past the threshold, with the next one back below it,
+        // is taken to be noise)
+        size_t i = starts[l];
+        while (i < tp->point_count - 1 &&
+               (LF(tlb_cost)(&tp->points[i]) <= threshold ||
+                LF(tlb_cost)(&tp->points[i + 1]) <= threshold))
+        { i++; }
+
+        size_t low = i > 0 ? tp->points[i - 1].pages : 0;
+        size_t high = tp->points[i].pages;
+        size_t capacity = low;
+        for (size_t s = 1; s < TLB_REFINE_STEPS && low > 0; s++)
+        {
+            double baseline = 0.0;
+            size_t pages = low + ((high - low) * s / TLB_REFINE_STEPS);
+            double cycles = PF(tlb_chase)(buf, pages, tp->page_size, 1,
+                                          &baseline);
+            if (cycles - baseline > threshold)
+            { break; }
+            capacity = pages;
+        }
+
+        tp->levels[l].entries = capacity;
+        tp->levels[l].latency = costs[l];
+    }
+    tp->levels_found = levels;
+}
+
+// Helper function that infers a level's associativity by chasing through 'k'
+// pages spaced by the largest power of two no greater than its capacity. If
+// the level's number of sets is a power of two, that spacing is a multiple of
+// it, so every page maps to the same set, and the cost jumps past 'threshold'
+// once 'k' exceeds the number of ways.
+static size_t LF(tlb_ways)(PS(tlb_probe_t)* tp, void* buf, size_t span,
+                           size_t capacity, double threshold)
+{
+    size_t spacing = 1;
+    while (spacing * 2 <= capacity)
+    { spacing *= 2; }
+
+    for (size_t k = 1; k <= TLB_MAX_WAYS && k * spacing <= span; k++)
+    {
+        double baseline = 0.0;
+        double cycles = PF(tlb_chase)(buf, k, tp->page_size, spacing,
+                                      &baseline);
+        if (cycles == 0.0)
+        { return 0; }
+        if (cycles - baseline > threshold)
+        { return k > 1 ? k - 1 : 0; }
+    }
+    return 0;
+}
+
+PE(result_e) PF(tlb_probe)(PS(tlb_probe_t)* tp, size_t max_pages, int huge)
+{
+    memset(tp, 0, sizeof(PS(tlb_probe_t)));
+    if (max_pages < TLB_MIN_PAGES * 2)
+    { return LIBSCA_INVALID_INPUT; }
+
+    // huge pages are mapped (and faulted in) up front. 4 KiB pages are
+    // faulted in as they're first touched, so the associativity tests can
+    // spread a few pages across a much larger span; they're also kept from
+    // being merged into transparent huge pages
+    size_t span = max_pages;
+    int flags = LIBSCA_MEM_HUGEPAGE | LIBSCA_MEM_POPULATE;
+    tp->page_size = LIBSCA_HUGEPAGE_SIZE;
+    if (!huge)
+    {
+        flags = 0;
+        tp->page_size = (size_t) sysconf(_SC_PAGESIZE);
+        size_t spacing = 1;
+        while (spacing * 2 <= max_pages)
+        { spacing *= 2; }
+        span = MAX(max_pages, spacing * TLB_MAX_WAYS);
+    }
+    size_t size = span * tp->page_size;
+    int reserved = 0;
+    void* buf = LF(mem_map)(size, flags, &reserved);
+    if (!buf)
+    { return LIBSCA_ALLOC_FAILURE; }
+
+    // transparent huge pages aren't guaranteed (and a probe over 4 KiB pages
+    // spaced 2 MiB apart would just measure one set of the 4 KiB TLBs), so
+    // huge page probes need reserved ones
+    if (huge && !reserved)
+    {
+        LF(mem_unmap)(buf, size, flags);
+        return LIBSCA_ALLOC_FAILURE;
+    }
+    #ifdef MADV_NOHUGEPAGE
+    if (!huge)
+    { madvise(buf, size, MADV_NOHUGEPAGE); }
+    #endif
+
+    // sweep the page counts and split the curve into levels
+    PE(result_e) result = LF(tlb_sweep)(tp, buf, max_pages);
+    if (result != LIBSCA_SUCCESS)
+    {
+        LF(mem_unmap)(buf, size, flags);
+        PF(tlb_free)(tp);
+        return result;
+    }
+    LF(tlb_plateaus)(tp, buf);
+    if (tp->levels_found == 0)
+    {
+        LF(mem_unmap)(buf, size, flags);
+        PF(tlb_free)(tp);
+        return LIBSCA_FAILURE;
+    }
+
+    for (size_t l = 0; l < tp->levels_found; l++)
+    {
+        // a lookup counts as a miss once it's closer to the next level's
+        // cost than this one's
+        double next = (l + 1 < tp->levels_found) ? tp->levels[l + 1].latency :
+                                                   tp->walk_latency;
+        double threshold = (tp->levels[l].latency + next) / 2.0;
+        tp->levels[l].associativity = LF(tlb_ways)(tp, buf, span,
+                                                   tp->levels[l].entries,
+                                                   threshold);
+    }
+
+    LF(mem_unmap)(buf, size, flags);
+    return LIBSCA_SUCCESS;
+}
+
+void PF(tlb_print)(PS(tlb_probe_t)* tp, FILE* fp)
+{
+    fprintf(fp, "Latency curve (%lu-byte pages):\n", tp->page_size);
+    fprintf(fp, "  %10s %10s %10s %12s\n", "pages", "cycles", "baseline",
+            "translation");
+    for (size_t i = 0; i < tp->point_count; i++)
+    {
+        PS(tlb_point_t)* point = &tp->points[i];
+        fprintf(fp, "  %10lu %10.2f %10.2f %12.2f\n", point->pages,
+                point->cycles, point->baseline, LF(tlb_cost)(point));
+    }
+
+    static const char* names[LIBSCA_TLB_LEVEL_COUNT] = { "dTLB", "STLB" };
+    fprintf(fp, "Inferred geometry:\n");
+    for (size_t i = 0; i < tp->levels_found; i++)
+    {
+        PS(tlb_geometry_t)* geo = &tp->levels[i];
+        fprintf(fp, "  %-4s %6lu entries, ", names[i], geo->entries);
+        if (geo->associativity)
+        { fprintf(fp, "%2lu-way, ", geo->associativity); }
+        else
+        { fprintf(fp, " ?-way, "); }
+        fprintf(fp, "%+.2f cycles\n", geo->latency);
+    }
+    fprintf(fp, "  Walk %+.2f cycles\n", tp->walk_latency);
+}
+
+void PF(tlb_free)(PS(tlb_probe_t)* tp)
+{
+    free(tp->points);
+    tp->points = NULL;
+    tp->point_count = 0;
+}
+
+void PF(tlb_warm)(void* const* addrs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    { LF(mem_warm_page)(addrs[i]); }
+}
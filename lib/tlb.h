@@ -0,0 +1,113 @@
+// This module implements empirical TLB probing. Like the cache geometry probe,
+// it infers the translation hierarchy from latency curves: a randomized
+// pointer-chasing traversal that touches one line in each of N pages stays
+// fast while N pages fit in the first-level data TLB, slows by a few cycles
+// once they spill into the second-level (shared) TLB, and slows further once
+// every access needs a page walk.
+//
+// The lines touched across N pages are also N lines of cache, so each point
+// is paired with a baseline traversal of the same number of lines packed into
+// as few pages as possible. The difference between the two is the cost of
+// translation alone, which keeps the L1D filling up from passing for a TLB
+// level.
+//
+// Probes can be run over 4 KiB pages or 2 MiB huge pages. (Under a hypervisor
+// that backs guest memory with 4 KiB pages, the TLBs cache huge pages as
+// 4 KiB pieces, and a huge page probe only finds the 4 KiB TLBs' sets.) The
+// probed lines of the timing routines elsewhere in the library are usually a
+// page apart, so this also provides a way to pre-warm the translations for a
+// set of addresses without caching them (see 'probe_warm()' for single
+// probes).
+
+#ifndef LIBSCA_TLB_H
+#define LIBSCA_TLB_H
+
+// Imports
+#include <stdio.h>
+#include <stddef.h>
+#include "symbols.h"
+#include "error.h"
+
+
+// ============================== TLB Probing =============================== //
+// Enum representing the levels of the data TLB hierarchy.
+typedef enum LE(tlb_level)
+{
+    LIBSCA_TLB_L1D,             // first-level data TLB ("dTLB")
+    LIBSCA_TLB_L2,              // second-level, shared TLB ("STLB")
+    LIBSCA_TLB_LEVEL_COUNT,     // ------------------------------------------
+} PE(tlb_level_e);
+
+// A single point on a TLB latency curve.
+typedef struct LS(tlb_point)
+{
+    size_t pages;               // number of pages touched
+    double cycles;              // average cycles per access (one per page)
+    double baseline;            // average cycles per access (packed lines)
+} PS(tlb_point_t);
+
+// The inferred geometry of a single TLB level.
+typedef struct LS(tlb_geometry)
+{
+    size_t entries;             // number of entries (pages it can map)
+    size_t associativity;       // number of ways (0 if unknown)
+    double latency;             // extra cycles per access when it hits
+} PS(tlb_geometry_t);
+
+// The results of probing the TLB.
+typedef struct LS(tlb_probe)
+{
+    size_t page_size;               // size of the pages probed (in bytes)
+    PS(tlb_point_t)* points;        // latency-vs-pages curve
+    size_t point_count;             // number of entries in 'points'
+    size_t levels_found;            // number of TLB levels inferred
+    PS(tlb_geometry_t) levels[LIBSCA_TLB_LEVEL_COUNT]; // inferred geometry
+    double walk_latency;            // extra cycles per access for a page walk
+} PS(tlb_probe_t);
+
+// Measures the average latency (in cycles per access) of a randomized
+// pointer-chasing traversal that touches one line in each of 'pages' pages of
+// 'page_size' bytes, spaced 'spacing' pages apart in 'buf' (which must span
+// at least 'pages * spacing' pages). Each page's line is at a different
+// offset, so they spread across the L1D's sets. If 'baseline' is non-NULL,
+// the latency of the same number of lines packed into consecutive lines of
+// 'buf' (visited in a random order, but only touching one page per 64 lines,
+// whose translations stay cached) is written into it.
+// Returns 0 if the parameters are invalid.
+double PF(tlb_chase)(void* buf, size_t pages, size_t page_size,
+                     size_t spacing, double* baseline);
+
+// Probes the data TLB hierarchy, sweeping from a few pages up to 'max_pages'
+// pages (which should be a few times larger than the last-level TLB), and
+// infers the following for each level:
+//  - Its capacity and latency: from the plateaus (and the jumps between them)
+//    of the translation cost (each point's latency less its baseline's).
+//  - Its associativity: by chasing through N pages spaced by the largest
+//    power of two no greater than its capacity (which all map to the same set
+//    if its set index is taken from the low page number bits), and finding
+//    the smallest N that no longer fits. Levels with hashed set indices, or
+//    whose ways exceed 32 (such as fully-associative ones), are left as zero.
+// If 'huge' is non-zero, the probe is run over 2 MiB huge pages, which must be
+// reserved (see /proc/sys/vm/nr_hugepages) for at least 'max_pages' of them;
+// otherwise, LIBSCA_ALLOC_FAILURE is returned. (Transparent huge pages aren't
+// guaranteed to back every page.) 4 KiB probes are mapped lazily, so their
+// associativity tests can span more than 'max_pages' pages; huge page probes
+// are confined to 'max_pages' pages.
+// Levels and fields that couldn't be inferred are left as zero.
+// The caller must free the results with 'tlb_free()'.
+// Returns a result enum.
+PE(result_e) PF(tlb_probe)(PS(tlb_probe_t)* tp, size_t max_pages, int huge);
+
+// Prints the probe's latency curve and inferred geometry to the given stream.
+void PF(tlb_print)(PS(tlb_probe_t)* tp, FILE* fp);
+
+// Frees the probe's memory.
+void PF(tlb_free)(PS(tlb_probe_t)* tp);
+
+// Warms the TLB entries for every address in 'addrs' (such as the lines of a
+// probe set), without caching the lines themselves. Only as many translations
+// as the TLB holds survive, so for large probe sets, use 'probe_warm()' to
+// warm each address just before it's timed instead.
+void PF(tlb_warm)(void* const* addrs, size_t count);
+
+#endif
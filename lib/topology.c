@@ -0,0 +1,198 @@
+// Implements the functions prototyped in topology.h.
+
+// Imports
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local imports
+#include "isa.h"
+#include "topology.h"
+
+// ISA-specific imports
+#if (ISA == ISA_X86)
+#include <cpuid.h>
+#endif
+
+// Cache types, as reported by CPUID (and named by sysfs)
+#define TOPOLOGY_TYPE_DATA          1
+#define TOPOLOGY_TYPE_INSTRUCTION   2
+#define TOPOLOGY_TYPE_UNIFIED       3
+
+// Directory (printf-format) holding sysfs' description of each cache level
+#define TOPOLOGY_SYSFS_DIR "/sys/devices/system/cpu/cpu0/cache/index%u"
+#define TOPOLOGY_MAX_INDEX 16
+
+
+// ============================ Cache Discovery ============================= //
+// Helper function that maps a cache's level and type to the library's cache
+// level enum. Returns -1 for caches the library doesn't track.
+// The highest unified level (3 or above) seen so far is tracked through
+// '*llc_level', so only the outermost cache is treated as the LLC. (If there's
+// no level 3, the L2 is copied into the LLC slot during initialization.)
+static int LF(topology_slot)(unsigned int level, unsigned int type,
+                             unsigned int* llc_level)
+{
+    if (level == 1 && type == TOPOLOGY_TYPE_DATA)
+    { return LIBSCA_CACHE_L1D; }
+    if (level == 1 && type == TOPOLOGY_TYPE_INSTRUCTION)
+    { return LIBSCA_CACHE_L1I; }
+    if (level == 2 && type != TOPOLOGY_TYPE_INSTRUCTION)
+    { return LIBSCA_CACHE_L2; }
+    if (level >= 3 && type == TOPOLOGY_TYPE_UNIFIED && level >= *llc_level)
+    {
+        *llc_level = level;
+        return LIBSCA_CACHE_LLC;
+    }
+    return -1;
+}
+
+int LF(topology_read_cpuid)(PS(config_t)* conf)
+{
+    int found = 0;
+
+    #if (ISA == ISA_X86)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+    { return 0; }
+    unsigned int max_leaf = eax;
+
+    // the vendor string is stored across EBX, EDX, and ECX (in that order)
+    char vendor[13];
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = '\0';
+
+    // Intel describes its caches with leaf 0x4; AMD (and Hygon) use leaf
+    // 0x8000001D, which has the same register layout
+    unsigned int leaf = 0;
+    if (!strcmp(vendor, "GenuineIntel") && max_leaf >= 0x4)
+    { leaf = 0x4; }
+    else if (!strcmp(vendor, "AuthenticAMD") || !strcmp(vendor, "HygonGenuine"))
+    {
+        __get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+        if (eax >= 0x8000001D)
+        { leaf = 0x8000001D; }
+    }
+    if (leaf == 0)
+    { return 0; }
+
+    // each sub-leaf describes one cache, until one reports a null type
+    unsigned int llc_level = 0;
+    for (unsigned int i = 0; i < TOPOLOGY_MAX_INDEX; i++)
+    {
+        __cpuid_count(leaf, i, eax, ebx, ecx, edx);
+        unsigned int type = eax & 0x1f;
+        if (type == 0)
+        { break; }
+
+        int slot = LF(topology_slot)((eax >> 5) & 0x7, type, &llc_level);
+        if (slot < 0)
+        { continue; }
+
+        // EBX holds the line size, physical line partitions, and ways (each
+        // minus one); ECX holds the number of sets (minus one); EDX bit 1 is
+        // set if the cache is inclusive of the lower levels
+        size_t line_size = (ebx & 0xfff) + 1;
+        size_t partitions = ((ebx >> 12) & 0x3ff) + 1;
+        size_t ways = ((ebx >> 22) & 0x3ff) + 1;
+        size_t sets = (size_t) ecx + 1;
+
+        PS(cache_geometry_t)* geo = &conf->cache_levels[slot];
+        geo->size = ways * partitions * line_size * sets;
+        geo->associativity = ways;
+        geo->line_size = line_size;
+        geo->sets = sets;
+        geo->inclusive = (edx >> 1) & 0x1;
+        found |= 1 << slot;
+    }
+    #endif
+
+    return found;
+}
+
+// Helper function that reads a single sysfs file from the given cache index's
+// directory into 'buf' (stripping the trailing newline).
+// Returns 0 on success and non-zero on failure.
+static int LF(topology_read_file)(unsigned int index, const char* name,
+                                  char* buf, size_t len)
+{
+    char path[128];
+    snprintf(path, sizeof(path), TOPOLOGY_SYSFS_DIR "/%s", index, name);
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+    { return -1; }
+
+    char* result = fgets(buf, len, fp);
+    fclose(fp);
+    if (!result)
+    { return -1; }
+
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// Helper function that reads a sysfs file containing a number. Sizes may end
+// in a 'K' or 'M' suffix. Returns 0 if the file couldn't be read.
+static size_t LF(topology_read_number)(unsigned int index, const char* name)
+{
+    char buf[64];
+    if (LF(topology_read_file)(index, name, buf, sizeof(buf)))
+    { return 0; }
+
+    char* end = NULL;
+    size_t value = strtoul(buf, &end, 10);
+    if (*end == 'K')
+    { value *= 1024; }
+    else if (*end == 'M')
+    { value *= 1024 * 1024; }
+    return value;
+}
+
+int LF(topology_read_sysfs)(PS(config_t)* conf, int known)
+{
+    int found = 0;
+    unsigned int llc_level = 0;
+    for (unsigned int i = 0; i < TOPOLOGY_MAX_INDEX; i++)
+    {
+        // determine the cache's type (the directory won't exist once we've
+        // run out of caches)
+        char type_name[32];
+        if (LF(topology_read_file)(i, "type", type_name, sizeof(type_name)))
+        { break; }
+        unsigned int type = TOPOLOGY_TYPE_UNIFIED;
+        if (!strcmp(type_name, "Data"))
+        { type = TOPOLOGY_TYPE_DATA; }
+        else if (!strcmp(type_name, "Instruction"))
+        { type = TOPOLOGY_TYPE_INSTRUCTION; }
+
+        size_t level = LF(topology_read_number)(i, "level");
+        int slot = LF(topology_slot)(level, type, &llc_level);
+        if (slot < 0)
+        { continue; }
+
+        // levels that were already described keep their geometry, and only
+        // pick up the list of CPUs sharing them
+        PS(cache_geometry_t)* geo = &conf->cache_levels[slot];
+        LF(topology_read_file)(i, "shared_cpu_list", geo->shared_cpu_list,
+                               sizeof(geo->shared_cpu_list));
+        if (known & (1 << slot))
+        { continue; }
+
+        // read the geometry; some kernels/VMs leave fields out (or zero), so
+        // only overwrite what's actually reported
+        size_t size = LF(topology_read_number)(i, "size");
+        size_t ways = LF(topology_read_number)(i, "ways_of_associativity");
+        size_t line_size = LF(topology_read_number)(i, "coherency_line_size");
+        size_t sets = LF(topology_read_number)(i, "number_of_sets");
+        if (size == 0 || ways == 0 || line_size == 0)
+        { continue; }
+        geo->size = size;
+        geo->associativity = ways;
+        geo->line_size = line_size;
+        geo->sets = sets;
+        found |= 1 << slot;
+    }
+    return found;
+}
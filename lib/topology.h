@@ -0,0 +1,26 @@
+// This module defines functions used to discover the CPU cache hierarchy at
+// library initialization.
+
+#ifndef LIBSCA_TOPOLOGY_H
+#define LIBSCA_TOPOLOGY_H
+
+// Imports
+#include "symbols.h"
+#include "config.h"
+
+
+// ============================ Cache Discovery ============================= //
+// Reads the cache hierarchy using the CPUID instruction (leaf 0x4 on Intel,
+// leaf 0x8000001D on AMD) and writes every level it finds into the config's
+// 'cache_levels'. This is the only source that reports inclusiveness.
+// Returns a bitmask with bit N set for each cache level enum value N found.
+int LF(topology_read_cpuid)(PS(config_t)* conf);
+
+// Reads the cache hierarchy from /sys/devices/system/cpu/cpu0/cache/index*/
+// and writes the geometry of every level it finds that isn't set in the
+// 'known' bitmask into the config's 'cache_levels'. The list of CPUs that share
+// each level is recorded for all levels, known or not.
+// Returns a bitmask with bit N set for each cache level enum value N filled in.
+int LF(topology_read_sysfs)(PS(config_t)* conf, int known);
+
+#endif
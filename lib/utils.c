@@ -59,6 +59,30 @@ void PF(rand_usleep)(int low, int high)
     usleep(sleep_time);
 }
 
+// Xorshift generator.
+uint64_t PF(rand_next)(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Fisher-Yates shuffle.
+void PF(rand_shuffle)(size_t* order, size_t count, uint64_t* state)
+{
+    for (size_t i = count > 0 ? count - 1 : 0; i > 0; i--)
+    {
+        size_t j = state ? PF(rand_next)(state) % (i + 1)
+                         : (size_t) PF(rand_int)(0, i + 1);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+}
+
 
 // ============================= String Helpers ============================= //
 // Integer parser.
@@ -88,6 +112,14 @@ void PF(yield)(void)
     sched_yield();
 }
 
+unsigned long PF(cycles_per_second)(void)
+{
+    unsigned long cycles1 = LF(mem_cycles)();
+    usleep(100000);
+    unsigned long cycles2 = LF(mem_cycles)();
+    return (cycles2 - cycles1) * 10;
+}
+
 char* PF(binary_string)(void* addr, size_t size_bits)
 {
     // allocate an appropriate size
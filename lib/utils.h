@@ -4,6 +4,8 @@
 #define LIBSCA_UTILS_H
 
 // Imports
+#include <stddef.h>
+#include <stdint.h>
 #include "symbols.h"
 #include "error.h"
 
@@ -31,6 +33,18 @@ int PF(rand_int)(int lower, int upper);
 // for adding a little delay to operations to shake things up.
 void PF(rand_usleep)(int low, int high);
 
+// Advances the xorshift generator at '*state' (which must be non-zero) and
+// returns its next value. Each caller owns its state, so unlike 'rand_int()',
+// a stream can be reproduced from its seed (e.g. by both ends of a covert
+// channel) and drawn from by several threads at once.
+uint64_t PF(rand_next)(uint64_t* state);
+
+// Shuffles the 'count' indexes in 'order' in place (Fisher-Yates), drawing from
+// the xorshift generator at '*state', or from 'rand_int()' if 'state' is NULL.
+// Timing loops visit their lines in a freshly shuffled order, so the hardware
+// prefetchers can't learn a stride and bring lines in ahead of the probes.
+void PF(rand_shuffle)(size_t* order, size_t count, uint64_t* state);
+
 
 // ============================= String Helpers ============================= //
 // Attempts to parse an integer from the given string and write the result into
@@ -43,6 +57,10 @@ PE(result_e) LF(str_to_int)(char* text, int* result);
 // running state. Useful for giving other programs on the system time to run.
 void PF(yield)(void);
 
+// Estimates the number of cycles (as counted by 'cycles()') that elapse per
+// second, by timing a 100 ms sleep.
+unsigned long PF(cycles_per_second)(void);
+
 // Takes in a memory address and a size (in bits) and creates a heap-allocated
 // string representing the big-endian-ordered binary stored at the address.
 // The caller must free the given string.
@@ -1,5 +1,5 @@
 // This program implements a utility for analyzing and describing the layout of
-// the L1D CPU cache built into the processor on which this runs.
+// the CPU caches built into the processor on which this runs.
 // It uses libsca to read system configurations to understand the cache
 // architecture.
 //
@@ -11,11 +11,30 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <signal.h>
+#include <unistd.h>
 #include <getopt.h>
 #include <libsca.h>
 
 // Globals
 int do_visual = 0;
+int do_probe = 0;
+int do_tlb = 0;
+int do_tlb_huge = 0;
+static int visual_sample_rate = 10000;      // Prime+Probe samples per second
+static int visual_frame_rate = 10;          // heatmap redraws per second
+static int probe_max_size = 256;            // largest geometry sweep (MiB)
+static volatile sig_atomic_t visual_running = 1;
+
+// Heatmap layout
+#define HEATMAP_COLUMNS 16
+#define HEATMAP_CELL_WIDTH 5
+#define HEATMAP_CALIBRATION_ROUNDS 1000
+
+// Number of pages swept by the TLB probe (a few times the size of a typical
+// last-level TLB, or as many huge pages as are commonly reserved)
+#define TLB_MAX_PAGES 8192
+#define TLB_MAX_HUGE_PAGES 256
 
 // Prints an escape sequence to stdout that positions the cursor in the
 // terminal.
@@ -24,86 +43,211 @@ static void position_cursor(int x, int y)
     printf("\033[%d;%dH", y, x);
 }
 
-// Creates a description of the CPU cache and prints it.
+// Creates a description of each level of the CPU cache and prints it.
 static void describe()
 {
-    // retrieve the library config and compute cache metrics
+    static const char* level_names[LIBSCA_CACHE_LEVEL_COUNT] = {
+        [LIBSCA_CACHE_L1D] = "L1D",
+        [LIBSCA_CACHE_L1I] = "L1I",
+        [LIBSCA_CACHE_L2] = "L2",
+        [LIBSCA_CACHE_LLC] = "last-level"
+    };
+
     sca_config_t* conf = sca_config_get();
-    size_t cache_size = conf->cache_size;
-    size_t cache_lsize = conf->cache_line_size;
-    size_t cache_lcount = cache_size / cache_lsize;
-    size_t cache_assoc = conf->cache_associativity;
-    size_t cache_scount = cache_lcount / cache_assoc;
-
-    // report the cache info the user
-    printf("Your CPU's L1D cache is a ");
-    if (cache_assoc > 1)
-    { printf("%lu-way set-associative cache ", cache_assoc); }
-    else
-    { printf("direct-mapped cache "); }
-    printf("with %lu total sets, %lu total %lu-byte lines, ",
-           cache_scount, cache_lcount, cache_lsize);
-    printf("and a total size of %lu bytes.\n", cache_size);
+    for (int l = 0; l < LIBSCA_CACHE_LEVEL_COUNT; l++)
+    {
+        // retrieve the level's geometry and compute cache metrics
+        sca_cache_geometry_t* geo = &conf->cache_levels[l];
+        size_t cache_size = geo->size;
+        size_t cache_lsize = geo->line_size;
+        size_t cache_lcount = cache_size / cache_lsize;
+        size_t cache_assoc = geo->associativity;
+        size_t cache_scount = sca_cache_sets(l);
+
+        // report the cache info the user
+        printf("Your CPU's %s cache is a ", level_names[l]);
+        if (cache_assoc > 1)
+        { printf("%lu-way set-associative cache ", cache_assoc); }
+        else
+        { printf("direct-mapped cache "); }
+        printf("with %lu total sets, %lu total %lu-byte lines, ",
+               cache_scount, cache_lcount, cache_lsize);
+        printf("and a total size of %lu bytes.", cache_size);
+        if (geo->inclusive >= 0 && l >= LIBSCA_CACHE_L2)
+        {
+            printf(" It is %sinclusive of the lower-level caches.",
+                   geo->inclusive ? "" : "not ");
+        }
+        if (geo->shared_cpu_list[0])
+        { printf(" It is shared by CPUs %s.", geo->shared_cpu_list); }
+        printf("\n");
+    }
 }
 
-// Visualizes the CPU cache.
-static void visualize()
+// Signal handler that stops the visualization.
+static void visualize_stop(int sig)
+{ visual_running = 0; }
+
+// Draws one frame of the heatmap. Each cell represents an L1D set and is
+// colored by the fraction of samples in which that set showed activity.
+static void render(size_t sets, unsigned long* activity,
+                   unsigned long samples, unsigned long missed)
 {
-    // TODO - this is a WIP
+    // 256-color background codes, from idle (black) to busy (bright red)
+    static const int ramp[] = {232, 236, 52, 88, 124, 160, 196};
+    static const int ramp_len = sizeof(ramp) / sizeof(ramp[0]);
 
-    // retrieve the library config and compute cache metrics
-    sca_config_t* conf = sca_config_get();
-    size_t cache_size = conf->cache_size;
-    size_t cache_lsize = conf->cache_line_size;
-    size_t cache_lcount = cache_size / cache_lsize;
-    size_t cache_assoc = conf->cache_associativity;
-    size_t cache_scount = cache_lcount / cache_assoc;
-    
-    // allocate a memory region as big as the cache
-    void* mem = malloc(cache_size);
-    if (!mem)
+    position_cursor(1, 1);
+    printf("L1D set activity: %d samples/sec, %lu samples this frame "
+           "(%lu missed). Press Ctrl-C to quit.\033[K",
+           visual_sample_rate, samples, missed);
+
+    for (size_t s = 0; s < sets; s++)
+    {
+        double rate = samples > 0 ? (double) activity[s] / (double) samples : 0.0;
+        int color = ramp[MIN((int) (rate * ramp_len), ramp_len - 1)];
+        position_cursor((int) ((s % HEATMAP_COLUMNS) * HEATMAP_CELL_WIDTH) + 1,
+                        (int) (s / HEATMAP_COLUMNS) + 3);
+        printf("\033[48;5;%dm%4lu\033[0m ", color, s);
+    }
+    fflush(stdout);
+}
+
+// Visualizes the CPU cache: continuously primes and probes every L1D set at a
+// fixed sample rate and renders a live heatmap of per-set activity (i.e. how
+// often other code running on this core evicted our lines from each set).
+static void visualize()
+{
+    sca_primeprobe_t pp;
+    if (sca_primeprobe_init(&pp) != LIBSCA_SUCCESS)
     {
-        fprintf(stderr, "Failed to allocate memory: %s\n", strerror(errno));
+        fprintf(stderr, "Failed to set up Prime+Probe.\n");
         exit(EXIT_FAILURE);
     }
-    void* mem_end = (uint8_t*) mem + cache_size - 1;
+    size_t sets = pp.sets;
+    unsigned long latencies[sets];
+    unsigned long thresholds[sets];
+    unsigned long activity[sets];
 
-    // walk down the memory region, one byte at a time, until we hit a byte
-    // whose virtual address uses set index 0 and line offset 0. We'll start
-    // from here while iterating
-    void* start = NULL;
-    for (uint8_t* byte = (uint8_t*) mem; byte < (uint8_t*) mem + cache_size; byte++)
+    // calibrate a per-set threshold: probe every set many times while (mostly)
+    // idle, and consider anything well above the median to be activity
+    sca_dataset_t baseline[sets];
+    for (size_t s = 0; s < sets; s++)
+    { sca_dataset_init(&baseline[s], HEATMAP_CALIBRATION_ROUNDS); }
+    for (int r = 0; r < HEATMAP_CALIBRATION_ROUNDS; r++)
     {
-        long set = sca_addr_set_bits(byte);
-        long loff = sca_addr_line_bits(byte);
-        if (set == 0 && loff == 0)
-        { start = byte; }
+        sca_primeprobe_probe_all(&pp, latencies);
+        for (size_t s = 0; s < sets; s++)
+        { sca_dataset_add(&baseline[s], (long) latencies[s]); }
+    }
+    for (size_t s = 0; s < sets; s++)
+    {
+        long median = sca_dataset_median(&baseline[s]);
+        thresholds[s] = (unsigned long) (median + median / 4);
+        sca_dataset_free(&baseline[s]);
     }
 
-    while (1)
+    // compute the sampling period and the number of samples per frame (a rate
+    // faster than the clock just samples back-to-back)
+    unsigned long period = MAX(sca_cycles_per_second() / visual_sample_rate, 1);
+    unsigned long frame_samples = MAX(visual_sample_rate / visual_frame_rate, 1);
+
+    // clear the screen, hide the cursor, and stop cleanly on Ctrl-C
+    signal(SIGINT, visualize_stop);
+    printf("\033[2J\033[?25l");
+
+    while (visual_running)
     {
-        // iterate through all cache lines, starting at the starting point
-        void* cursor = start;
-        for (size_t i = 0; i < cache_lcount; i++)
+        // sample for one frame. Rendering happens only between frames, so its
+        // cost never lands inside the probe loop
+        memset(activity, 0, sizeof(activity));
+        unsigned long samples = 0;
+        unsigned long missed = 0;
+        unsigned long next = sca_cycles();
+        while (samples < frame_samples && visual_running)
         {
-            // get the addresses set index and line offset
-            long tag = sca_addr_tag_bits(cursor);
-            long set = sca_addr_set_bits(cursor);
-            long loff = sca_addr_line_bits(cursor);
-            printf("0x%-20lx 0x%-16lx 0x%-4lx 0x%-4lx\n", (long) cursor, tag, set, loff);
-
-            // compute the next cache line (wrap around if necessary)
-            void* next = (uint8_t*) cursor + cache_lsize;
-            if (next > mem_end)
-            { next = start; }
-            cursor = next;
+            // wait for the next sample slot
+            unsigned long now;
+            while ((now = sca_cycles()) < next)
+            { }
+
+            sca_primeprobe_probe_all(&pp, latencies);
+            for (size_t s = 0; s < sets; s++)
+            { activity[s] += latencies[s] > thresholds[s]; }
+            samples++;
+
+            // if we fell more than a slot behind, count the slots we missed
+            // and resynchronize
+            next += period;
+            now = sca_cycles();
+            if (now > next + period)
+            {
+                missed += (now - next) / period;
+                next = now;
+            }
         }
 
-        break;  // DEBUGGING
+        render(sets, activity, samples, missed);
+    }
+
+    // restore the cursor and move it below the heatmap
+    position_cursor(1, (int) (sets / HEATMAP_COLUMNS) + 4);
+    printf("\033[?25h\n");
+    sca_primeprobe_free(&pp);
+}
+
+
+// ============================ Geometry Probing ============================ //
+// Measures the cache geometry with pointer-chasing latency sweeps, prints the
+// results, and writes them into the library config.
+// Returns 0 on success and non-zero on failure.
+static int probe()
+{
+    // sweep up to a fixed size (well past any current last-level cache),
+    // rather than trusting the reported LLC size we're trying to verify
+    size_t max_size = (size_t) probe_max_size << 20;
+
+    sca_geometry_probe_t gp;
+    printf("Probing the cache geometry (this may take a few seconds)...\n");
+    sca_result_e result = sca_geometry_probe(&gp, max_size);
+    if (result != LIBSCA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to probe the cache geometry.\n");
+        sca_geometry_free(&gp);
+        return 1;
+    }
+
+    sca_geometry_print(&gp, stdout);
+    printf("\n");
+    sca_geometry_apply(&gp);
+    sca_geometry_free(&gp);
+    return 0;
+}
+
+// Measures the TLB geometry with page-strided pointer-chasing latency sweeps
+// (over 4 KiB or 2 MiB pages) and prints the results.
+// Returns 0 on success and non-zero on failure.
+static int probe_tlb(int huge)
+{
+    sca_tlb_probe_t tp;
+    size_t max_pages = huge ? TLB_MAX_HUGE_PAGES : TLB_MAX_PAGES;
+    printf("Probing the TLB geometry (this may take a few seconds)...\n");
+    sca_result_e result = sca_tlb_probe(&tp, max_pages, huge);
+    if (result != LIBSCA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to probe the TLB geometry.\n");
+        sca_tlb_free(&tp);
+        if (huge && result == LIBSCA_ALLOC_FAILURE)
+        {
+            fprintf(stderr, "This needs %d reserved huge pages (see /proc/sys/vm/nr_hugepages).\n",
+                    TLB_MAX_HUGE_PAGES);
+        }
+        return 1;
     }
 
-    // free memory
-    free(mem);
+    sca_tlb_print(&tp, stdout);
+    sca_tlb_free(&tp);
+    return 0;
 }
 
 
@@ -115,6 +259,12 @@ static void args_parse(int argc, char** argv)
     static struct option opts[] = {
         {"help",        no_argument,        NULL,   0},
         {"visual",      no_argument,        NULL,   0},
+        {"rate",        required_argument,  NULL,   0},
+        {"fps",         required_argument,  NULL,   0},
+        {"probe",       no_argument,        NULL,   0},
+        {"probe-max",   required_argument,  NULL,   0},
+        {"tlb",         no_argument,        NULL,   0},
+        {"tlb-huge",    no_argument,        NULL,   0},
         {NULL, 0, NULL, 0}
     };
     int optidx = 0;
@@ -134,6 +284,39 @@ static void args_parse(int argc, char** argv)
         { goto args_parse_usage; }
         else if (!strcmp(opt->name, "visual"))
         { do_visual = 1; }
+        else if (!strcmp(opt->name, "probe"))
+        { do_probe = 1; }
+        else if (!strcmp(opt->name, "tlb"))
+        { do_tlb = 1; }
+        else if (!strcmp(opt->name, "tlb-huge"))
+        { do_tlb_huge = 1; }
+        else if (!strcmp(opt->name, "rate"))
+        {
+            int result = LF(str_to_int)(optarg, &visual_sample_rate);
+            if (result || visual_sample_rate <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --rate.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "probe-max"))
+        {
+            int result = LF(str_to_int)(optarg, &probe_max_size);
+            if (result || probe_max_size <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --probe-max (in MiB).");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "fps"))
+        {
+            int result = LF(str_to_int)(optarg, &visual_frame_rate);
+            if (result || visual_frame_rate <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --fps.");
+                exit(EXIT_FAILURE);
+            }
+        }
     }
     return;
     
@@ -142,6 +325,7 @@ static void args_parse(int argc, char** argv)
     printf("Cache Information Utility\n");
     printf("Usage: %s [OPTIONS]\n", argv[0]);
     printf("Use this to learn about the architecture of your CPU cache.\n");
+    printf("Use --tlb (or --tlb-huge, for 2 MiB pages) to measure the TLBs instead.\n");
     printf("\n");
 
     printf("Options:\n");
@@ -170,6 +354,15 @@ int main(int argc, char** argv)
         return EXIT_SUCCESS;
     }
 
+    // if the user asked to probe the TLBs, do that instead
+    if (do_tlb || do_tlb_huge)
+    { return probe_tlb(do_tlb_huge) ? EXIT_FAILURE : EXIT_SUCCESS; }
+
+    // if the user asked to probe the geometry, measure it and use it in place
+    // of what the system reports
+    if (do_probe && probe())
+    { return EXIT_FAILURE; }
+
     // otherwise, describe the cache
     describe();
     return EXIT_SUCCESS;
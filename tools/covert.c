@@ -0,0 +1,629 @@
+// This program benchmarks a cross-process Flush+Reload covert channel. A
+// sender and a receiver process share a file-backed mapping; time is divided
+// into fixed-length slots (synchronized on the timestamp counter), and in
+// each slot the sender transmits one bit per shared line by either touching
+// the line or leaving it alone. The receiver times a load of each line late in
+// the slot (a fast load means the sender touched it), then flushes it again.
+// The bits are sent as a stream of frames, coded with the library's framing
+// and forward error correction layer, so the receiver can report goodput
+// (payload bits per second that survived the channel, after correction)
+// alongside the raw bit rate, bit error rate, and effective capacity, for a
+// range of slot lengths and line counts. The tool can also benchmark how fast
+// frames are encoded and decoded.
+//
+// By default the tool forks, running the sender in the child process; the two
+// roles can also be run as separate processes (start the sender first).
+
+// Imports
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sched.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <emmintrin.h>
+#include <libsca.h>
+
+// Roles this process can play
+#define ROLE_BOTH 0
+#define ROLE_SENDER 1
+#define ROLE_RECEIVER 2
+
+// Globals
+static int role = ROLE_BOTH;
+static char* file_path = "/tmp/libsca-covert";
+static int seed = 0;                // seeds the transmitted bits
+static int cache_threshold = 0;     // hit threshold (0 = calibrate)
+static int symbols = 2000;          // slots transmitted per configuration
+static int slot_cycles = 0;         // slot length to test (0 = sweep)
+static int line_count = 0;          // lines (bits per slot) to test (0 = sweep)
+static sca_fec_e fec = LIBSCA_FEC_HAMMING74;    // code applied to frames
+static int interleave = 8;          // codewords interleaved together
+static int frame_len = 32;          // payload bytes per frame
+static int bench = 0;               // benchmark encoding and decoding instead
+
+// Configurations swept by default
+static const int sweep_slots[] = {2000, 5000, 10000, 20000, 50000, 100000};
+static const int sweep_lines[] = {1, 4, 8};
+#define SWEEP_SLOTS_LEN (sizeof(sweep_slots) / sizeof(sweep_slots[0]))
+#define SWEEP_LINES_LEN (sizeof(sweep_lines) / sizeof(sweep_lines[0]))
+
+// Shared mapping layout: a control page, followed by one page per line (so
+// the hardware prefetchers never pull in a neighboring line)
+#define PAGE_SIZE 4096
+#define MAX_LINES LIBSCA_CHANNEL_MAX_LINES
+#define MAP_SIZE ((MAX_LINES + 1) * PAGE_SIZE)
+
+// Delay between the receiver publishing a configuration and its first slot
+#define START_DELAY_MS 50
+
+// Frames coded by each pass of the encoding and decoding benchmark
+#define BENCH_FRAMES 20000
+
+
+// ============================= Shared Channel ============================= //
+// The control page, written by the receiver and read by the sender. The
+// receiver fills in a configuration, then bumps 'round' to publish it.
+typedef struct control
+{
+    volatile uint64_t round;        // configuration number (0 = none yet)
+    volatile uint64_t done;         // set when the benchmark is over
+    volatile uint64_t start;        // timestamp at which slot 0 begins
+    volatile uint64_t slot_cycles;  // length of each slot
+    volatile uint64_t lines;        // bits (lines) per slot
+    volatile uint64_t symbols;      // number of slots
+    volatile uint64_t seed;         // seeds the transmitted bits
+    volatile uint64_t fec;          // code applied to frames
+    volatile uint64_t interleave;   // codewords interleaved together
+    volatile uint64_t frame_len;    // payload bytes per frame
+} control_t;
+
+static uint8_t* shared;
+static control_t* control;
+
+// Returns the address of the given shared line.
+static inline uint8_t* line_addr(int line)
+{ return shared + ((line + 1) * PAGE_SIZE) + ((line * 320) % PAGE_SIZE); }
+
+// Maps the shared file, creating it if necessary. Exits on failure.
+static void channel_map()
+{
+    int fd = open(file_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, MAP_SIZE))
+    {
+        fprintf(stderr, "Failed to open %s.\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+    shared = mmap(NULL, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map %s.\n", file_path);
+        exit(EXIT_FAILURE);
+    }
+    control = (control_t*) shared;
+}
+
+// Fills 'bits' with back-to-back frames of random payloads (generated from
+// 'state'), padding the end with 0s once another whole frame won't fit. Each
+// frame's payload is also stored in 'payloads', if it's non-NULL.
+// Returns the number of frames stored.
+static size_t build_stream(sca_channel_t* ch, uint64_t state, size_t len,
+                           uint8_t* bits, size_t nbits, uint8_t* payloads)
+{
+    size_t frame_bits = sca_channel_frame_bits(ch, len);
+    size_t frames = nbits / frame_bits;
+    uint8_t payload[LIBSCA_CHANNEL_MAX_PAYLOAD];
+    for (size_t f = 0; f < frames; f++)
+    {
+        for (size_t i = 0; i < len; i++)
+        { payload[i] = (uint8_t) sca_rand_next(&state); }
+        sca_channel_encode(ch, payload, len, bits + (f * frame_bits));
+        if (payloads)
+        { memcpy(payloads + (f * len), payload, len); }
+    }
+    memset(bits + (frames * frame_bits), 0, nbits - (frames * frame_bits));
+    return frames;
+}
+
+// Waits until the timestamp counter reaches 'target'. The CPU is yielded
+// while waiting, in case the sender is running on the same CPU.
+static inline void wait_until(uint64_t target)
+{
+    while (sca_cycles() < target)
+    { sched_yield(); }
+}
+
+// Sets up a link over the first 'lines' shared lines.
+static void link_init(sca_channel_link_t* link, uint64_t slot, uint64_t lines,
+                      uint64_t shuffle)
+{
+    for (uint64_t l = 0; l < lines; l++)
+    { link->lines[l] = line_addr((int) l); }
+    link->line_count = lines;
+    link->slot_cycles = slot;
+    link->threshold = (unsigned long) cache_threshold;
+    link->shuffle = shuffle;
+}
+
+
+// ================================= Sender ================================= //
+// Transmits every configuration the receiver publishes, until it's done.
+static void sender()
+{
+    uint64_t seen = 0;
+    while (!control->done)
+    {
+        // sleep (rather than spin) until the next configuration, so we don't
+        // steal the receiver's CPU while it prepares
+        if (control->round == seen)
+        {
+            usleep(100);
+            continue;
+        }
+        __sync_synchronize();
+        seen = control->round;
+        uint64_t start = control->start;
+        uint64_t lines = control->lines;
+        size_t nbits = control->symbols * lines;
+        sca_channel_t ch;
+        sca_channel_init(&ch, (sca_fec_e) control->fec,
+                         (unsigned int) control->interleave);
+
+        uint8_t* bits = malloc(nbits);
+        if (!bits)
+        {
+            fprintf(stderr, "Failed to allocate the bit stream.\n");
+            exit(EXIT_FAILURE);
+        }
+        build_stream(&ch, control->seed, control->frame_len, bits, nbits,
+                     NULL);
+        sca_channel_link_t link;
+        link_init(&link, control->slot_cycles, lines, 0);
+        sca_channel_transmit(&link, start, bits, nbits);
+        free(bits);
+    }
+}
+
+
+// ================================ Receiver ================================ //
+// The results of receiving one configuration.
+typedef struct result
+{
+    uint64_t bits;          // bits decoded
+    uint64_t errors;        // bits decoded incorrectly
+    uint64_t missed;        // slots we sampled too late to decode (erasures)
+    uint64_t frames;        // frames sent
+    uint64_t delivered;     // frames received with the correct payload
+    uint64_t corrected;     // bits fixed by the error correcting code
+} result_t;
+
+// Helper function that computes the binary entropy of 'p'.
+static double entropy(double p)
+{
+    if (p <= 0.0 || p >= 1.0)
+    { return 0.0; }
+    return -(p * log2(p)) - ((1.0 - p) * log2(1.0 - p));
+}
+
+// Publishes a configuration to the sender, then receives it.
+static result_t receive(uint64_t slot, uint64_t lines, unsigned long cps)
+{
+    result_t res = {0, 0, 0, 0, 0, 0};
+    uint64_t state = (uint64_t) seed * 2654435761ul + slot + lines + 1;
+    sca_channel_t ch;
+    sca_channel_init(&ch, fec, (unsigned int) interleave);
+
+    // build the stream the sender will transmit, so we can check what we get
+    size_t nbits = (size_t) symbols * lines;
+    uint8_t* expected = malloc(nbits);
+    uint8_t* received = malloc(nbits);
+    uint8_t* erased = malloc(symbols);
+    uint8_t* payloads = malloc((nbits / sca_channel_frame_bits(&ch, 0) + 1) *
+                               frame_len);
+    if (!expected || !received || !erased || !payloads)
+    {
+        fprintf(stderr, "Failed to allocate the bit streams.\n");
+        exit(EXIT_FAILURE);
+    }
+    res.frames = build_stream(&ch, state, frame_len, expected, nbits,
+                              payloads);
+
+    // publish the configuration
+    uint64_t start = sca_cycles() + ((cps / 1000) * START_DELAY_MS);
+    control->start = start;
+    control->slot_cycles = slot;
+    control->lines = lines;
+    control->symbols = (uint64_t) symbols;
+    control->seed = state;
+    control->fec = fec;
+    control->interleave = interleave;
+    control->frame_len = frame_len;
+    __sync_synchronize();
+    control->round++;
+
+    sca_channel_link_t link;
+    link_init(&link, slot, lines, state ^ 0x9e3779b97f4a7c15ul);
+    res.missed = sca_channel_receive(&link, start, received, nbits, erased);
+
+    // count the raw errors in the slots we sampled
+    for (size_t k = 0; k < (size_t) symbols; k++)
+    {
+        if (erased[k])
+        { continue; }
+        res.bits += lines;
+        for (size_t i = k * lines; i < (k + 1) * lines; i++)
+        { res.errors += received[i] != expected[i]; }
+    }
+
+    // decode every frame we can find. Slots are never dropped (only zeroed),
+    // so a frame's position tells us which of the sent frames it should be
+    size_t frame_bits = sca_channel_frame_bits(&ch, frame_len);
+    size_t pos = 0;
+    while (pos < nbits)
+    {
+        uint8_t payload[LIBSCA_CHANNEL_MAX_PAYLOAD];
+        size_t len = 0;
+        size_t corrected = 0;
+        if (sca_channel_decode(&ch, received, nbits, &pos, payload, &len,
+                               &corrected))
+        { continue; }
+        size_t frame = (pos - frame_bits + (frame_bits / 2)) / frame_bits;
+        if (frame < res.frames && len == (size_t) frame_len &&
+            !memcmp(payload, payloads + (frame * frame_len), len))
+        {
+            res.delivered++;
+            res.corrected += corrected;
+        }
+    }
+
+    free(expected);
+    free(received);
+    free(erased);
+    free(payloads);
+
+    // wait for the last slot to end before publishing anything else
+    wait_until(start + (symbols * slot));
+    return res;
+}
+
+// Receives and reports on every configuration.
+static void receiver()
+{
+    // calibrate the hit threshold, unless one was given
+    if (cache_threshold <= 0)
+    {
+        sca_dataset_t hits;
+        sca_dataset_t misses;
+        if (sca_collect_timing(16, &hits, &misses, NULL))
+        {
+            fprintf(stderr, "Failed to collect timing.\n");
+            exit(EXIT_FAILURE);
+        }
+        cache_threshold = (int) sca_calculate_threshold(&hits, &misses);
+        sca_dataset_free(&hits);
+        sca_dataset_free(&misses);
+    }
+    unsigned long cps = sca_cycles_per_second();
+    printf("Hit threshold: %d cycles. Clock: %.2f GHz. %d slots per test.\n",
+           cache_threshold, (double) cps / 1e9, symbols);
+    printf("Frames: %d payload bytes, %s code, interleaved %d deep.\n\n",
+           frame_len, sca_fec_name(fec), interleave);
+
+    printf("%12s %6s %14s %10s %10s %14s %12s %10s %14s\n", "slot cycles",
+           "lines", "raw bits/sec", "BER", "missed", "capacity", "frames",
+           "corrected", "goodput");
+    for (size_t s = 0; s < SWEEP_SLOTS_LEN; s++)
+    {
+        int slot = slot_cycles > 0 ? slot_cycles : sweep_slots[s];
+        for (size_t l = 0; l < SWEEP_LINES_LEN; l++)
+        {
+            int lines = line_count > 0 ? line_count : sweep_lines[l];
+            result_t res = receive((uint64_t) slot, (uint64_t) lines, cps);
+
+            // the channel's capacity is that of a binary symmetric channel
+            // with the measured error rate, scaled down by the fraction of
+            // slots that were erased. (An error rate above 0.5 isn't treated
+            // as an inverted channel; the receiver has no way to know that.)
+            double raw = (double) lines * (double) cps / (double) slot;
+            double ber = res.bits > 0 ? (double) res.errors / (double) res.bits
+                                      : 0.5;
+            double decoded = (double) (symbols - res.missed) / (double) symbols;
+            double capacity = raw * decoded * (1.0 - entropy(MIN(ber, 0.5)));
+
+            // goodput only counts the payload bits of frames that arrived
+            // intact (after correction)
+            double seconds = (double) symbols * slot / (double) cps;
+            double goodput = (double) res.delivered * frame_len * 8 / seconds;
+            char frames[32];
+            snprintf(frames, sizeof(frames), "%lu/%lu", res.delivered,
+                     res.frames);
+            printf("%12d %6d %14.0f %10.4f %10lu %14.0f %12s %10lu %14.0f\n",
+                   slot, lines, raw, ber, res.missed, capacity, frames,
+                   res.corrected, goodput);
+
+            if (line_count > 0)
+            { break; }
+        }
+        if (slot_cycles > 0)
+        { break; }
+    }
+
+    control->done = 1;
+}
+
+
+// =============================== Benchmark ================================ //
+// Helper function that returns the current time, in seconds.
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+// Measures how fast frames are encoded and decoded with each code, with and
+// without interleaving. Rates are in payload bits per second, so they can be
+// compared directly against the channel's goodput.
+static void benchmark()
+{
+    printf("Coding %d frames of %d payload bytes per test.\n\n",
+           BENCH_FRAMES, frame_len);
+    printf("%12s %10s %12s %16s %16s\n", "code", "interleave", "frame bits",
+           "encode bits/sec", "decode bits/sec");
+
+    int depths[] = {1, interleave};
+    for (int f = 0; f < LIBSCA_FEC_COUNT; f++)
+    {
+        for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+        {
+            if (d > 0 && depths[d] == depths[0])
+            { continue; }
+            sca_channel_t ch;
+            sca_channel_init(&ch, (sca_fec_e) f, (unsigned int) depths[d]);
+            size_t frame_bits = sca_channel_frame_bits(&ch, frame_len);
+            size_t nbits = frame_bits * BENCH_FRAMES;
+            uint8_t* bits = malloc(nbits);
+            if (!bits)
+            {
+                fprintf(stderr, "Failed to allocate the bit stream.\n");
+                exit(EXIT_FAILURE);
+            }
+
+            double t1 = now_seconds();
+            build_stream(&ch, (uint64_t) seed | 1, frame_len, bits, nbits,
+                         NULL);
+            double t2 = now_seconds();
+
+            size_t pos = 0;
+            size_t decoded = 0;
+            while (pos < nbits)
+            {
+                uint8_t payload[LIBSCA_CHANNEL_MAX_PAYLOAD];
+                size_t len;
+                if (!sca_channel_decode(&ch, bits, nbits, &pos, payload, &len,
+                                        NULL))
+                { decoded++; }
+            }
+            double t3 = now_seconds();
+            if (decoded != BENCH_FRAMES)
+            {
+                fprintf(stderr, "Only decoded %lu of %d frames.\n", decoded,
+                        BENCH_FRAMES);
+            }
+
+            double payload_bits = (double) BENCH_FRAMES * frame_len * 8;
+            printf("%12s %10d %12lu %16.0f %16.0f\n", sca_fec_name(f),
+                   depths[d], frame_bits, payload_bits / (t2 - t1),
+                   payload_bits / (t3 - t2));
+            free(bits);
+        }
+    }
+}
+
+
+// ========================== Command-Line Options ========================== //
+// Parses command-line arguments and updates globals accordingly.
+static void args_parse(int argc, char** argv)
+{
+    // set up command-line options
+    static struct option opts[] = {
+        {"help",        no_argument,        NULL,   0},
+        {"role",        required_argument,  NULL,   0},
+        {"file",        required_argument,  NULL,   0},
+        {"seed",        required_argument,  NULL,   0},
+        {"threshold",   required_argument,  NULL,   0},
+        {"symbols",     required_argument,  NULL,   0},
+        {"slot",        required_argument,  NULL,   0},
+        {"lines",       required_argument,  NULL,   0},
+        {"fec",         required_argument,  NULL,   0},
+        {"interleave",  required_argument,  NULL,   0},
+        {"frame",       required_argument,  NULL,   0},
+        {"bench",       no_argument,        NULL,   0},
+        {NULL, 0, NULL, 0}
+    };
+    int optidx = 0;
+
+    // loop forever until all options are parsed
+    while (1)
+    {
+        // parse the next option and quit on error
+        int result = getopt_long_only(argc, argv, "", opts, &optidx);
+        if (result == -1)
+        { break; }
+        if (result != 0)
+        { goto args_parse_usage; }
+
+        struct option* opt = &opts[optidx];
+        if (!strcmp(opt->name, "help"))
+        { goto args_parse_usage; }
+        else if (!strcmp(opt->name, "role"))
+        {
+            if (!strcmp(optarg, "both"))
+            { role = ROLE_BOTH; }
+            else if (!strcmp(optarg, "sender"))
+            { role = ROLE_SENDER; }
+            else if (!strcmp(optarg, "receiver"))
+            { role = ROLE_RECEIVER; }
+            else
+            {
+                fprintf(stderr, "You must specify one of 'both', 'sender', or 'receiver' for --role.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "file"))
+        { file_path = optarg; }
+        else if (!strcmp(opt->name, "seed"))
+        {
+            int result = LF(str_to_int)(optarg, &seed);
+            if (result)
+            {
+                fprintf(stderr, "You must specify an integer for --seed.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "threshold"))
+        {
+            int result = LF(str_to_int)(optarg, &cache_threshold);
+            if (result || cache_threshold <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --threshold.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "symbols"))
+        {
+            int result = LF(str_to_int)(optarg, &symbols);
+            if (result || symbols <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --symbols.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "slot"))
+        {
+            int result = LF(str_to_int)(optarg, &slot_cycles);
+            if (result || slot_cycles <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --slot.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "lines"))
+        {
+            int result = LF(str_to_int)(optarg, &line_count);
+            if (result || line_count <= 0 || line_count > MAX_LINES)
+            {
+                fprintf(stderr, "You must specify an integer in [1, %d] for --lines.",
+                        MAX_LINES);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "fec"))
+        {
+            fec = sca_fec_parse(optarg);
+            if (fec == LIBSCA_FEC_COUNT)
+            {
+                fprintf(stderr, "You must specify one of 'none' or 'hamming74' for --fec.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "interleave"))
+        {
+            int result = LF(str_to_int)(optarg, &interleave);
+            if (result || interleave <= 0 || interleave > 64)
+            {
+                fprintf(stderr, "You must specify an integer in [1, 64] for --interleave.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "frame"))
+        {
+            int result = LF(str_to_int)(optarg, &frame_len);
+            if (result || frame_len <= 0 ||
+                frame_len > LIBSCA_CHANNEL_MAX_PAYLOAD)
+            {
+                fprintf(stderr, "You must specify an integer in [1, %d] for --frame.",
+                        LIBSCA_CHANNEL_MAX_PAYLOAD);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "bench"))
+        { bench = 1; }
+    }
+    return;
+
+    // prints out a usage menu and exits the program
+    args_parse_usage:
+    printf("Covert Channel Benchmark\n");
+    printf("Usage: %s [OPTIONS]\n", argv[0]);
+    printf("Use this to measure the capacity and goodput of a cross-process Flush+Reload covert channel.\n"
+           "By default, every slot length and line count in a sweep is tested.\n"
+           "Use --bench to measure how fast frames are encoded and decoded instead.\n\n");
+
+    printf("Options:\n");
+    struct option* o = &opts[0];
+    while (o->name)
+    {
+        printf("  --%s (-%c)\n", o->name, o->name[0]);
+        o++;
+    }
+    exit(0);
+}
+
+
+// ================================== Main ================================== //
+// Main function.
+int main(int argc, char** argv)
+{
+    // initialize the library and parse arguments
+    sca_init();
+    seed = time(NULL);
+    args_parse(argc, argv);
+    if (bench)
+    {
+        benchmark();
+        return EXIT_SUCCESS;
+    }
+
+    // map the shared file. Whichever side starts first (the sender, when the
+    // roles run as separate processes) clears out the control page, since a
+    // previous run's receiver leaves 'done' set in it
+    channel_map();
+    memset(control, 0, sizeof(control_t));
+    __sync_synchronize();
+
+    if (role == ROLE_SENDER)
+    {
+        sender();
+        return EXIT_SUCCESS;
+    }
+    if (role == ROLE_RECEIVER)
+    {
+        receiver();
+        return EXIT_SUCCESS;
+    }
+
+    // otherwise, fork off the sender and receive in this process
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "Failed to fork the sender.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        sender();
+        exit(EXIT_SUCCESS);
+    }
+    receiver();
+    waitpid(pid, NULL, 0);
+    return EXIT_SUCCESS;
+}
@@ -16,15 +16,20 @@
 // Globals
 static int cache_threshold = 80;     // cache access time
 static int seed = 0;            // random seed
+static sca_probe_e probe_mode = LIBSCA_PROBE_LOAD;  // reload instruction
+static int do_calibrate = 0;    // calibrate the threshold for the probe mode
+static int do_classify = 0;     // classify reloads by level (L1/L2/LLC/DRAM)
+static sca_classifier_t classifier; // calibrated when 'do_classify' is set
 
 // Test memory region
 #define MEM_BLOCK_SIZE 4096
 #define MEM_BLOCK_COUNT 256
-static uint8_t mem[MEM_BLOCK_COUNT * MEM_BLOCK_SIZE];
+static sca_region_t mem_region;     // pre-faulted, locked, and guarded
+static uint8_t* mem;
 
-// Victim/attacker cache line recording
-sca_dataset_t victim_secrets;
-sca_dataset_t attacker_discoveries;
+// Victim/attacker cache line recording (one bit per cache line)
+sca_hitvec_t victim_secrets;
+sca_hitvec_t attacker_discoveries;
 
 
 // ============================== Victim Code =============================== //
@@ -33,20 +38,20 @@ sca_dataset_t attacker_discoveries;
 // footprint in the CPU cache.
 static void victim_access()
 {
-    printf("%-12s Accessing %lu cache lines:\n",
-           "VICTIM:", victim_secrets.size);
+    printf("%-12s Accessing %u cache lines:\n",
+           "VICTIM:", sca_hitvec_popcount(&victim_secrets));
 
     // iterate across the chosen secret cache lines the victim will access
-    for (size_t i = 0; i < victim_secrets.size; i++)
+    for (int idx = sca_hitvec_next(&victim_secrets, 0); idx >= 0;
+         idx = sca_hitvec_next(&victim_secrets, idx + 1))
     {
         // compute an address and perform the access
-        int64_t idx = victim_secrets.data[i];
         void* addr = mem + (idx * MEM_BLOCK_SIZE);
         uint64_t cycles = sca_load(addr, NULL);
         int was_cached = cycles <= cache_threshold;
 
         // log the access
-        printf("%-12s Cache line %ld: %lu cycles (%s)\n",
+        printf("%-12s Cache line %d: %lu cycles (%s)\n",
                "", idx, cycles,
                was_cached ? "Already cached" : "Not cached");
     }
@@ -58,6 +63,8 @@ static void victim_access()
 // attacker and victim.
 static void attacker_flush()
 {
+    // warm up the TLB first, so the reloads don't include page walks
+    sca_region_warm(&mem_region);
     for (int i = 0; i < MEM_BLOCK_COUNT; i++)
     { sca_flush_write(mem + (i * MEM_BLOCK_SIZE), 0xff); }
 
@@ -70,72 +77,145 @@ static void attacker_flush()
 // determines which ones were present in the CPU cache based on access time.
 static void attacker_reload()
 {
-    printf("%-12s Reloading all %d cache lines:\n",
-           "ATTACKER:", MEM_BLOCK_COUNT);
+    printf("%-12s Reloading all %d cache lines (probe: %s):\n",
+           "ATTACKER:", MEM_BLOCK_COUNT, sca_probe_name(probe_mode));
+
+    // probe every line first and record the timings, so the cost of printing
+    // doesn't land between probes
+    unsigned long timings[MEM_BLOCK_COUNT];
+    uint64_t start = sca_cycles();
     for (int i = 0; i < MEM_BLOCK_COUNT; i++)
+    { timings[i] = sca_probe(mem + (i * MEM_BLOCK_SIZE), probe_mode); }
+    uint64_t elapsed = sca_cycles() - start;
+
+    // if a classifier was calibrated, sort the timings into levels; any line
+    // that wasn't served from DRAM was cached somewhere (even if it was only
+    // in the LLC, as it would be after a victim's access on another core)
+    sca_latency_e levels[MEM_BLOCK_COUNT];
+    size_t level_counts[LIBSCA_LATENCY_COUNT];
+    if (do_classify)
     {
-        // compute the correct address and time the load
-        void* addr = mem + (i * MEM_BLOCK_SIZE);
-        uint64_t cycles = sca_load(addr, NULL);
+        sca_classify_batch(&classifier, timings, MEM_BLOCK_COUNT,
+                           levels, level_counts);
+    }
 
+    for (int i = 0; i < MEM_BLOCK_COUNT; i++)
+    {
         // if the cache line was already cached, this must have been accessed
         // by the victim
-        int was_cached = cycles <= cache_threshold;
+        int was_cached = do_classify ? levels[i] != LIBSCA_LATENCY_DRAM :
+                                       timings[i] <= cache_threshold;
         if (was_cached)
         {
-            sca_dataset_add(&attacker_discoveries, (int64_t) i);
+            sca_hitvec_set(&attacker_discoveries, i);
             printf("%-12s Cache line %d is in the cache. "
-                   "(Accessed in %lu cycles)\n",
-                   "", i, cycles);
+                   "(Accessed in %lu cycles",
+                   "", i, timings[i]);
+            if (do_classify)
+            { printf(", %s", sca_latency_name(levels[i])); }
+            printf(")\n");
         }
     }
+
+    // report how many lines landed in each level
+    if (do_classify)
+    {
+        printf("%-12s Lines per level:", "");
+        for (int l = 0; l < LIBSCA_LATENCY_COUNT; l++)
+        {
+            printf(" %s=%lu", sca_latency_name((sca_latency_e) l),
+                   level_counts[l]);
+        }
+        printf("\n");
+    }
+
+    // report the achieved probe rate
+    printf("%-12s Probed %d lines in %lu cycles (%.1f cycles/line).\n",
+           "", MEM_BLOCK_COUNT, elapsed,
+           (double) elapsed / (double) MEM_BLOCK_COUNT);
+}
+
+// Measures hit/miss timings for the selected probe mode and updates the cache
+// threshold accordingly.
+static void attacker_calibrate()
+{
+    sca_dataset_t hits;
+    sca_dataset_t misses;
+    if (sca_collect_probe_timing(probe_mode, 16, &hits, &misses, NULL))
+    {
+        fprintf(stderr, "Failed to collect probe timing.\n");
+        exit(EXIT_FAILURE);
+    }
+    cache_threshold = (int) sca_calculate_threshold(&hits, &misses);
+    printf("%-12s Calibrated '%s' threshold: %d cycles "
+           "(hit median: %ld, miss median: %ld, discarded: %lu/%lu)\n",
+           "ATTACKER:", sca_probe_name(probe_mode), cache_threshold,
+           sca_dataset_median(&hits), sca_dataset_median(&misses),
+           hits.discarded, misses.discarded);
+    sca_dataset_free(&hits);
+    sca_dataset_free(&misses);
+}
+
+// Calibrates a latency band for each level of the memory hierarchy (for the
+// selected probe mode), used to classify reloads instead of a single threshold.
+static void attacker_classify_calibrate()
+{
+    if (sca_classifier_calibrate(&classifier, probe_mode, 100))
+    {
+        fprintf(stderr, "Failed to calibrate the latency classifier.\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%-12s Calibrated '%s' latency bands:",
+           "ATTACKER:", sca_probe_name(probe_mode));
+    unsigned long low = 0;
+    for (int l = 0; l < LIBSCA_LATENCY_COUNT - 1; l++)
+    {
+        printf(" %s=%lu-%lu", sca_latency_name((sca_latency_e) l),
+               low, classifier.bounds[l]);
+        low = classifier.bounds[l] + 1;
+    }
+    printf(" DRAM=%lu+\n", low);
 }
 
 // Function that compares the victim's accesses to the attacker's discoveries
 // and highlights any differences.
-static void compare(sca_dataset_t* victim, sca_dataset_t* attacker)
+static void compare(sca_hitvec_t* victim, sca_hitvec_t* attacker)
 {
-    sca_dataset_sort(victim);
-    sca_dataset_sort(attacker);
     printf("ANALYSIS:\n");
 
-    // iterate through the victim's accesses and look for them in the attacker's
-    // discovery set
-    size_t matches = 0;
-    for (size_t i = 0; i < victim->size; i++)
-    {
-        ssize_t idx = sca_dataset_find(attacker, victim->data[i]);
-        matches += idx >= 0;
+    // the lines the attacker found are the intersection; anything the victim
+    // accessed but the attacker didn't find (and vice versa) is a difference
+    sca_hitvec_t found;
+    sca_hitvec_t missed;
+    sca_hitvec_t extra;
+    sca_hitvec_and(&found, victim, attacker);
+    sca_hitvec_andnot(&missed, victim, attacker);
+    sca_hitvec_andnot(&extra, attacker, victim);
 
-        // if the attacker didn't discover this cache line, print it out
-        if (idx < 0)
-        {
-            printf("%-12s The attacker failed to discover cache line %ld.\n",
-                   "", victim->data[i]);
-        }
-    }
-
-    // now iterate through the attacker's discoveries and look for any extra
-    // cache lines that WEREN'T accessed by the victim
-    for (size_t i = 0; i < attacker->size; i++)
+    // print out any cache lines the attacker didn't discover
+    for (int i = sca_hitvec_next(&missed, 0); i >= 0;
+         i = sca_hitvec_next(&missed, i + 1))
     {
-        ssize_t idx = sca_dataset_find(victim, attacker->data[i]);
-        if (idx < 0)
-        {
-            printf("%-12s The attacker found an extra cache line: %ld.\n",
-                   "", attacker->data[i]);
-        }
+        printf("%-12s The attacker failed to discover cache line %d.\n",
+               "", i);
     }
 
+    // now print any extra cache lines that WEREN'T accessed by the victim
+    for (int i = sca_hitvec_next(&extra, 0); i >= 0;
+         i = sca_hitvec_next(&extra, i + 1))
+    { printf("%-12s The attacker found an extra cache line: %d.\n", "", i); }
+
     // if all cache lines were discovered by the attacker, print it out
-    if (matches == victim->size)
+    unsigned int matches = sca_hitvec_popcount(&found);
+    unsigned int accesses = sca_hitvec_popcount(victim);
+    if (matches == accesses)
     {
         printf("%-12s The attacker discovered all victim cache lines.\n", "");
     }
     else
     {
-        printf("%-12s The attacker discovered %lu/%lu victim cache lines.\n",
-               "", matches, victim->size);
+        printf("%-12s The attacker discovered %u/%u victim cache lines.\n",
+               "", matches, accesses);
     }
 
 }
@@ -150,6 +230,9 @@ static void args_parse(int argc, char** argv)
         {"help",        no_argument,        NULL,   0},
         {"threshold",   required_argument,  NULL,   0},
         {"seed",        required_argument,  NULL,   0},
+        {"probe",       required_argument,  NULL,   0},
+        {"calibrate",   no_argument,        NULL,   0},
+        {"classify",    no_argument,        NULL,   0},
         {NULL, 0, NULL, 0}
     };
     int optidx = 0;
@@ -185,6 +268,20 @@ static void args_parse(int argc, char** argv)
                 exit(EXIT_FAILURE);
             }
         }
+        else if (!strcmp(opt->name, "probe"))
+        {
+            probe_mode = sca_probe_parse(optarg);
+            if (probe_mode == LIBSCA_PROBE_COUNT)
+            {
+                fprintf(stderr, "You must specify one of 'load', 'prefetch', "
+                        "'prefetchnta', or 'prefetchw' for --probe.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "calibrate"))
+        { do_calibrate = 1; }
+        else if (!strcmp(opt->name, "classify"))
+        { do_classify = 1; }
     }
     return;
     
@@ -214,19 +311,29 @@ int main(int argc, char** argv)
     args_parse(argc, argv);
     sca_rand_seed(seed);
 
+    // map the shared memory region
+    if (sca_region_init(&mem_region, MEM_BLOCK_COUNT * MEM_BLOCK_SIZE,
+                        LIBSCA_MEM_POPULATE | LIBSCA_MEM_LOCK))
+    {
+        fprintf(stderr, "Failed to map the shared memory region.\n");
+        exit(EXIT_FAILURE);
+    }
+    mem = mem_region.base;
+
+    // prefetch timings differ greatly from load timings, so calibrate the
+    // threshold for the chosen probe if asked to
+    if (do_calibrate)
+    { attacker_calibrate(); }
+    if (do_classify)
+    { attacker_classify_calibrate(); }
+
     // determine a random set of cache lines to have the victim access
+    // (repeated indexes simply set the same bit again)
     size_t victim_accesses = (size_t) sca_rand_int(1, 9);
-    sca_dataset_init(&victim_secrets, victim_accesses);
+    sca_hitvec_clear(&victim_secrets);
     for (int i = 0; i < victim_accesses; i++)
-    {
-        // generate a random cache line index and only insert it into the set if
-        // we haven't generated it before
-        int64_t idx = (int64_t) sca_rand_int(0, MEM_BLOCK_COUNT);
-        if (sca_dataset_find(&victim_secrets, idx) < 0)
-        { sca_dataset_add(&victim_secrets, idx); }
-    }
-    sca_dataset_sort(&victim_secrets);
-    sca_dataset_init(&attacker_discoveries, victim_accesses);
+    { sca_hitvec_set(&victim_secrets, sca_rand_int(0, MEM_BLOCK_COUNT)); }
+    sca_hitvec_clear(&attacker_discoveries);
     
     // perform the attack
     attacker_flush();       // 1. attacker flushes all relevant cache lines
@@ -237,7 +344,6 @@ int main(int argc, char** argv)
     compare(&victim_secrets, &attacker_discoveries);
 
     // free memory
-    sca_dataset_free(&attacker_discoveries);
-    sca_dataset_free(&victim_secrets);
+    sca_region_free(&mem_region);
 }
 
@@ -0,0 +1,222 @@
+// This program demonstrates the library's cache-footprint profiler on a few
+// small routines: a secret-indexed table lookup (which touches one table
+// set), a constant-time lookup that reads the whole table (which touches
+// every set), and a table-free routine (which touches none). Profiles can be
+// saved as CSV and diffed against a later run, such as one with a different
+// secret.
+
+// Imports
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <libsca.h>
+
+// Table layout: one entry per line, covering a whole page (so with a 64-set
+// L1D, entry 'i' lives in set 'i')
+#define TABLE_LINE 64
+#define TABLE_ENTRIES 64
+
+// Routines that can be profiled
+#define ROUTINE_TABLE 0
+#define ROUTINE_CT 1
+#define ROUTINE_NONE 2
+
+// Globals
+static uint8_t table[TABLE_ENTRIES * TABLE_LINE] __attribute__((aligned(4096)));
+static int routine = ROUTINE_TABLE;
+static int secret = 3;              // table entry the lookups select
+static int rounds = 100000;
+static int csv = 0;                 // dump profiles as CSV
+static char* save_path = NULL;      // file to save the profile to (as CSV)
+static char* diff_path = NULL;      // saved profile to diff against
+
+
+// ================================ Routines ================================ //
+// Reads the table entry selected by the secret.
+static void routine_table(void* arg)
+{ *(volatile uint8_t*) (table + (secret * TABLE_LINE)); }
+
+// Reads every table entry, keeping the one selected by the secret with a mask.
+static void routine_ct(void* arg)
+{
+    uint8_t result = 0;
+    for (int i = 0; i < TABLE_ENTRIES; i++)
+    {
+        uint8_t mask = -(uint8_t) (i == secret);
+        result |= *(volatile uint8_t*) (table + (i * TABLE_LINE)) & mask;
+    }
+    *(volatile uint8_t*) arg = result;
+}
+
+// Computes a value from the secret without touching memory.
+static void routine_none(void* arg)
+{
+    uint8_t x = (uint8_t) secret;
+    x ^= x << 3;
+    x ^= x >> 5;
+    *(volatile uint8_t*) arg = x;
+}
+
+
+// ========================== Command-Line Options ========================== //
+// Parses command-line arguments and updates globals accordingly.
+static void args_parse(int argc, char** argv)
+{
+    // set up command-line options
+    static struct option opts[] = {
+        {"help",        no_argument,        NULL,   0},
+        {"routine",     required_argument,  NULL,   0},
+        {"secret",      required_argument,  NULL,   0},
+        {"rounds",      required_argument,  NULL,   0},
+        {"csv",         no_argument,        NULL,   0},
+        {"save",        required_argument,  NULL,   0},
+        {"diff",        required_argument,  NULL,   0},
+        {NULL, 0, NULL, 0}
+    };
+    int optidx = 0;
+
+    // loop forever until all options are parsed
+    while (1)
+    {
+        // parse the next option and quit on error
+        int result = getopt_long_only(argc, argv, "", opts, &optidx);
+        if (result == -1)
+        { break; }
+        if (result != 0)
+        { goto args_parse_usage; }
+
+        struct option* opt = &opts[optidx];
+        if (!strcmp(opt->name, "help"))
+        { goto args_parse_usage; }
+        else if (!strcmp(opt->name, "routine"))
+        {
+            if (!strcmp(optarg, "table"))
+            { routine = ROUTINE_TABLE; }
+            else if (!strcmp(optarg, "ct"))
+            { routine = ROUTINE_CT; }
+            else if (!strcmp(optarg, "none"))
+            { routine = ROUTINE_NONE; }
+            else
+            {
+                fprintf(stderr, "You must specify one of 'table', 'ct', or 'none' for --routine.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "secret"))
+        {
+            int result = LF(str_to_int)(optarg, &secret);
+            if (result || secret < 0 || secret >= TABLE_ENTRIES)
+            {
+                fprintf(stderr, "You must specify an integer in [0, %d] for --secret.",
+                        TABLE_ENTRIES - 1);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "rounds"))
+        {
+            int result = LF(str_to_int)(optarg, &rounds);
+            if (result || rounds <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --rounds.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "csv"))
+        { csv = 1; }
+        else if (!strcmp(opt->name, "save"))
+        { save_path = optarg; }
+        else if (!strcmp(opt->name, "diff"))
+        { diff_path = optarg; }
+    }
+    return;
+
+    // prints out a usage menu and exits the program
+    args_parse_usage:
+    printf("Cache Footprint Profiler\n");
+    printf("Usage: %s [OPTIONS]\n", argv[0]);
+    printf("Use this to see which L1D sets a routine touches, and how often.\n"
+           "Use --save to keep a profile (as CSV), and --diff to compare a new one against it.\n\n");
+
+    printf("Options:\n");
+    struct option* o = &opts[0];
+    while (o->name)
+    {
+        printf("  --%s (-%c)\n", o->name, o->name[0]);
+        o++;
+    }
+    exit(0);
+}
+
+
+// ================================== Main ================================== //
+// Main function.
+int main(int argc, char** argv)
+{
+    // initialize the library and parse arguments
+    sca_init();
+    args_parse(argc, argv);
+    memset(table, 1, sizeof(table));
+
+    static uint8_t sink;
+    void (*fns[])(void*) = {routine_table, routine_ct, routine_none};
+    sca_footprint_t fp;
+    if (sca_footprint(&fp, fns[routine], &sink, (unsigned long) rounds))
+    {
+        fprintf(stderr, "Failed to profile the routine.\n");
+        return EXIT_FAILURE;
+    }
+    sca_footprint_format_e format = csv ? LIBSCA_FOOTPRINT_CSV
+                                        : LIBSCA_FOOTPRINT_TEXT;
+
+    // compare against a saved profile, or show the new one
+    int status = EXIT_SUCCESS;
+    if (diff_path)
+    {
+        sca_footprint_t old;
+        FILE* fp_in = fopen(diff_path, "r");
+        if (!fp_in || sca_footprint_load(&old, fp_in))
+        {
+            fprintf(stderr, "Failed to load a profile from %s.\n", diff_path);
+            status = EXIT_FAILURE;
+        }
+        else
+        {
+            long changed = sca_footprint_diff(&fp, &old, stdout, format);
+            if (changed < 0)
+            {
+                fprintf(stderr, "The profiles cover different caches.\n");
+                status = EXIT_FAILURE;
+            }
+            else if (!csv)
+            {
+                printf("\n%ld sets changed (|z| > %.1f).\n", changed,
+                       LIBSCA_FOOTPRINT_Z);
+            }
+            sca_footprint_free(&old);
+        }
+        if (fp_in)
+        { fclose(fp_in); }
+    }
+    else
+    { sca_footprint_dump(&fp, stdout, format); }
+
+    if (save_path)
+    {
+        FILE* fp_out = fopen(save_path, "w");
+        if (!fp_out)
+        {
+            fprintf(stderr, "Failed to open %s.\n", save_path);
+            status = EXIT_FAILURE;
+        }
+        else
+        {
+            sca_footprint_dump(&fp, fp_out, LIBSCA_FOOTPRINT_CSV);
+            fclose(fp_out);
+        }
+    }
+
+    sca_footprint_free(&fp);
+    return status;
+}
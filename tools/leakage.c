@@ -0,0 +1,237 @@
+// This program demonstrates the library's constant-time leakage detector on
+// two versions of a secret-indexed table lookup: a leaky one that reads only
+// the table entry its secret selects, and a constant-time one that reads
+// every entry and keeps the right one with a mask. Each class of input is a
+// different secret; the detector runs the lookup with inputs from every class
+// while watching the cache, and reports the sets (or table lines) whose
+// latencies differ significantly between classes.
+
+// Imports
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libsca.h>
+
+// Table layout: one entry per line, covering a whole page (so with a 64-set
+// L1D, entry 'i' lives in set 'i')
+#define TABLE_LINE 64
+#define TABLE_ENTRIES 64
+#define MAX_CLASSES 16
+
+// Victims that can be tested
+#define VICTIM_TABLE 0
+#define VICTIM_CT 1
+
+// Globals
+static uint8_t table[TABLE_ENTRIES * TABLE_LINE] __attribute__((aligned(4096)));
+static sca_leakage_mode_e mode = LIBSCA_LEAKAGE_PRIMEPROBE;
+static int victim = VICTIM_TABLE;
+static int traces = 200000;
+static int threads = 0;             // collection threads (0 = one per CPU)
+static int classes = 2;
+static double threshold = LIBSCA_LEAKAGE_THRESHOLD;
+
+
+// ================================ Victims ================================= //
+// Reads the table entry selected by the secret (leaks it through the cache).
+static void victim_table(const void* input, void* arg)
+{
+    uint8_t secret = *(const uint8_t*) input;
+    *(volatile uint8_t*) (table + (secret * TABLE_LINE));
+}
+
+// Reads every table entry, keeping the one selected by the secret with a
+// mask, so the memory accessed doesn't depend on the secret.
+static void victim_ct(const void* input, void* arg)
+{
+    uint8_t secret = *(const uint8_t*) input;
+    uint8_t result = 0;
+    for (unsigned int i = 0; i < TABLE_ENTRIES; i++)
+    {
+        uint8_t mask = -(uint8_t) (i == secret);
+        result |= *(volatile uint8_t*) (table + (i * TABLE_LINE)) & mask;
+    }
+    *(volatile uint8_t*) arg = result;
+}
+
+
+// ========================== Command-Line Options ========================== //
+// Parses command-line arguments and updates globals accordingly.
+static void args_parse(int argc, char** argv)
+{
+    // set up command-line options
+    static struct option opts[] = {
+        {"help",        no_argument,        NULL,   0},
+        {"mode",        required_argument,  NULL,   0},
+        {"victim",      required_argument,  NULL,   0},
+        {"traces",      required_argument,  NULL,   0},
+        {"threads",     required_argument,  NULL,   0},
+        {"classes",     required_argument,  NULL,   0},
+        {"threshold",   required_argument,  NULL,   0},
+        {NULL, 0, NULL, 0}
+    };
+    int optidx = 0;
+
+    // loop forever until all options are parsed
+    while (1)
+    {
+        // parse the next option and quit on error
+        int result = getopt_long_only(argc, argv, "", opts, &optidx);
+        if (result == -1)
+        { break; }
+        if (result != 0)
+        { goto args_parse_usage; }
+
+        struct option* opt = &opts[optidx];
+        if (!strcmp(opt->name, "help"))
+        { goto args_parse_usage; }
+        else if (!strcmp(opt->name, "mode"))
+        {
+            mode = sca_leakage_mode_parse(optarg);
+            if (mode == LIBSCA_LEAKAGE_MODE_COUNT)
+            {
+                fprintf(stderr, "You must specify one of 'primeprobe' or 'flushreload' for --mode.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "victim"))
+        {
+            if (!strcmp(optarg, "table"))
+            { victim = VICTIM_TABLE; }
+            else if (!strcmp(optarg, "ct"))
+            { victim = VICTIM_CT; }
+            else
+            {
+                fprintf(stderr, "You must specify one of 'table' or 'ct' for --victim.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "traces"))
+        {
+            int result = LF(str_to_int)(optarg, &traces);
+            if (result || traces <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --traces.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "threads"))
+        {
+            int result = LF(str_to_int)(optarg, &threads);
+            if (result || threads <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --threads.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "classes"))
+        {
+            int result = LF(str_to_int)(optarg, &classes);
+            if (result || classes < 2 || classes > MAX_CLASSES)
+            {
+                fprintf(stderr, "You must specify an integer in [2, %d] for --classes.",
+                        MAX_CLASSES);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "threshold"))
+        {
+            char* end = NULL;
+            threshold = strtod(optarg, &end);
+            if (end == optarg || *end != '\0' || threshold <= 0.0)
+            {
+                fprintf(stderr, "You must specify a positive number for --threshold.");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    return;
+
+    // prints out a usage menu and exits the program
+    args_parse_usage:
+    printf("Constant-Time Leakage Detector\n");
+    printf("Usage: %s [OPTIONS]\n", argv[0]);
+    printf("Use this to test a leaky and a constant-time table lookup for secret-dependent cache accesses.\n"
+           "Each class of input is a different secret; cache sets (or table lines) whose latencies\n"
+           "differ between classes with a Welch's |t| above --threshold are reported.\n\n");
+
+    printf("Options:\n");
+    struct option* o = &opts[0];
+    while (o->name)
+    {
+        printf("  --%s (-%c)\n", o->name, o->name[0]);
+        o++;
+    }
+    exit(0);
+}
+
+
+// ================================== Main ================================== //
+// Main function.
+int main(int argc, char** argv)
+{
+    // initialize the library and parse arguments
+    sca_init();
+    args_parse(argc, argv);
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int) cpus : 1;
+    }
+    memset(table, 1, sizeof(table));
+
+    // each class's secret selects a table entry 17 entries past the last
+    // class's (wrapping around), so each lands in its own set
+    uint8_t secrets[MAX_CLASSES];
+    const void* inputs[MAX_CLASSES];
+    for (int c = 0; c < classes; c++)
+    {
+        secrets[c] = (uint8_t) (((c * 17) + 3) % TABLE_ENTRIES);
+        inputs[c] = &secrets[c];
+    }
+
+    static uint8_t sink;
+    sca_leakage_t lk;
+    if (sca_leakage_init(&lk, victim == VICTIM_TABLE ? victim_table : victim_ct,
+                         &sink, inputs, classes, mode, table, sizeof(table)))
+    {
+        fprintf(stderr, "Failed to initialize the leakage detector.\n");
+        return EXIT_FAILURE;
+    }
+    printf("Testing the %s lookup with %d classes, measured with %s over %lu "
+           "%s.\n", victim == VICTIM_TABLE ? "leaky" : "constant-time",
+           classes, sca_leakage_mode_name(mode), lk.points,
+           mode == LIBSCA_LEAKAGE_PRIMEPROBE ? "L1D sets" : "table lines");
+
+    struct timespec t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (sca_leakage_collect(&lk, (size_t) traces, (unsigned int) threads))
+    {
+        fprintf(stderr, "Failed to collect traces.\n");
+        sca_leakage_free(&lk);
+        return EXIT_FAILURE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    double seconds = (double) (t2.tv_sec - t1.tv_sec) +
+                     ((double) (t2.tv_nsec - t1.tv_nsec) / 1e9);
+    printf("Collected %d traces on %d threads in %.2f seconds (%.0f "
+           "traces/sec).\n\n", traces, threads, seconds,
+           (double) traces / seconds);
+
+    size_t flagged = sca_leakage_analyze(&lk, threshold);
+    if (flagged == 0)
+    { printf("No leakage detected (every |t| <= %.2f).\n", threshold); }
+    else
+    {
+        printf("Leakage detected at %lu of %lu points (|t| > %.2f):\n",
+               flagged, lk.points, threshold);
+        sca_leakage_report(&lk, threshold, stdout);
+    }
+
+    sca_leakage_free(&lk);
+    return flagged > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,406 @@
+// This program monitors a file-backed mapping (such as a shared library) with
+// Flush+Reload. The file is mapped read-only, so its pages are shared with
+// every other process that maps it; time is divided into fixed-length slots
+// (measured on the timestamp counter), and in each slot a line at each of the
+// given offsets is reloaded and flushed. A fast reload means another process
+// touched the line since the previous slot.
+//
+// Hits are written to a compact binary log, which '--dump' prints as text:
+//
+//      header:  magic "SCAMON1\0", start timestamp (u64), slot cycles (u64),
+//               target count (u64), then each target's offset (u64)
+//      events:  slots since the previous event (u32), target index (u16),
+//               reload latency in cycles (u16)
+//
+// An event with a target index of 0xffff carries no hit; it only advances
+// the slot count (for gaps too long to fit in 32 bits). An event's timestamp
+// is the start timestamp plus its slot number times the slot length.
+//
+// The slots are timed by spinning on the timestamp counter (never sleeping),
+// so slots shorter than a microsecond can be sustained. Slots we reach after
+// they've already ended are counted as missed, and skipped.
+
+// Imports
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libsca.h>
+
+// Maximum number of offsets that can be monitored
+#define MAX_TARGETS 64
+
+// Events buffered in memory before being written to the log
+#define EVENT_BUFFER 65536
+
+// Marks events that only advance the slot count
+#define EVENT_GAP 0xffff
+
+// Globals
+static char* file_path = NULL;
+static size_t offsets[MAX_TARGETS];
+static int offset_count = 0;
+static int slot_cycles = 1000;      // length of each slot
+static int duration_ms = 1000;      // how long to monitor
+static int cache_threshold = 0;     // hit threshold (0 = calibrate)
+static char* log_path = NULL;       // binary log to write (NULL = none)
+static char* dump_path = NULL;      // binary log to print instead
+
+
+// ================================ Logging ================================= //
+// The log's header, followed by the targets' offsets.
+typedef struct log_header
+{
+    char magic[8];
+    uint64_t start;
+    uint64_t slot_cycles;
+    uint64_t targets;
+} log_header_t;
+
+// A hit (or a gap) in the log.
+typedef struct log_event
+{
+    uint32_t slots;         // slots since the previous event
+    uint16_t target;        // index of the target (or EVENT_GAP)
+    uint16_t cycles;        // reload latency
+} log_event_t;
+
+static FILE* log_file = NULL;
+static log_event_t events[EVENT_BUFFER];
+static size_t event_count = 0;
+static uint64_t events_written = 0;
+static uint64_t last_slot = 0;      // slot of the previous event
+
+// Writes out the buffered events.
+static void log_flush()
+{
+    if (log_file && event_count > 0)
+    { fwrite(events, sizeof(log_event_t), event_count, log_file); }
+    events_written += event_count;
+    event_count = 0;
+}
+
+// Buffers an event for the given slot and target.
+static inline void log_event(uint64_t slot, uint16_t target, uint16_t cycles)
+{
+    // split up gaps too long for a single event
+    uint64_t delta = slot - last_slot;
+    while (delta > UINT32_MAX)
+    {
+        events[event_count++] = (log_event_t) {UINT32_MAX, EVENT_GAP, 0};
+        delta -= UINT32_MAX;
+        if (event_count == EVENT_BUFFER)
+        { log_flush(); }
+    }
+    events[event_count++] = (log_event_t) {(uint32_t) delta, target, cycles};
+    last_slot = slot;
+    if (event_count == EVENT_BUFFER)
+    { log_flush(); }
+}
+
+// Prints a log as text: one line per hit, with its slot, timestamp, target
+// offset, and latency.
+static int log_dump(const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "Failed to open %s.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    log_header_t header;
+    uint64_t targets[MAX_TARGETS];
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, "SCAMON1", 8) || header.targets > MAX_TARGETS ||
+        fread(targets, sizeof(uint64_t), header.targets, fp) != header.targets)
+    {
+        fprintf(stderr, "%s is not a monitor log.\n", path);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    printf("%14s %20s %12s %8s\n", "slot", "timestamp", "offset", "cycles");
+    log_event_t event;
+    uint64_t slot = 0;
+    while (fread(&event, sizeof(event), 1, fp) == 1)
+    {
+        slot += event.slots;
+        if (event.target == EVENT_GAP)
+        { continue; }
+        if (event.target >= header.targets)
+        {
+            fprintf(stderr, "Event for unknown target %u.\n", event.target);
+            break;
+        }
+        printf("%14lu %20lu %#12lx %8u\n", slot,
+               header.start + (slot * header.slot_cycles),
+               targets[event.target], event.cycles);
+    }
+    fclose(fp);
+    return EXIT_SUCCESS;
+}
+
+
+// ================================ Monitor ================================= //
+// Monitors the targets for the configured duration.
+static int monitor()
+{
+    // map the file read-only, so we share its pages with everyone else
+    int fd = open(file_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) || st.st_size == 0)
+    {
+        fprintf(stderr, "Failed to open %s.\n", file_path);
+        return EXIT_FAILURE;
+    }
+    uint8_t* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map %s.\n", file_path);
+        return EXIT_FAILURE;
+    }
+    uint8_t* targets[MAX_TARGETS];
+    for (int t = 0; t < offset_count; t++)
+    {
+        if (offsets[t] >= (size_t) st.st_size)
+        {
+            fprintf(stderr, "Offset %#lx is past the end of %s.\n",
+                    offsets[t], file_path);
+            return EXIT_FAILURE;
+        }
+        targets[t] = map + offsets[t];
+        *(volatile uint8_t*) targets[t];    // fault the page in
+        sca_flush(targets[t]);
+    }
+
+    // calibrate the hit threshold, unless one was given
+    if (cache_threshold <= 0)
+    {
+        sca_dataset_t hits;
+        sca_dataset_t misses;
+        if (sca_collect_timing(16, &hits, &misses, NULL))
+        {
+            fprintf(stderr, "Failed to collect timing.\n");
+            return EXIT_FAILURE;
+        }
+        cache_threshold = (int) sca_calculate_threshold(&hits, &misses);
+        sca_dataset_free(&hits);
+        sca_dataset_free(&misses);
+    }
+    unsigned long cps = sca_cycles_per_second();
+    uint64_t slot = (uint64_t) slot_cycles;
+    uint64_t total = (uint64_t) duration_ms * (cps / 1000) / slot;
+    printf("Monitoring %d offsets of %s for %d ms.\n", offset_count,
+           file_path, duration_ms);
+    printf("Hit threshold: %d cycles. Clock: %.2f GHz. Slot: %d cycles "
+           "(%.3f us).\n", cache_threshold, (double) cps / 1e9, slot_cycles,
+           (double) slot * 1e6 / (double) cps);
+
+    uint64_t start = sca_cycles() + slot;
+    if (log_path)
+    {
+        log_file = fopen(log_path, "wb");
+        if (!log_file)
+        {
+            fprintf(stderr, "Failed to open %s.\n", log_path);
+            return EXIT_FAILURE;
+        }
+        log_header_t header = {"SCAMON1", start, slot, offset_count};
+        uint64_t offs[MAX_TARGETS];
+        for (int t = 0; t < offset_count; t++)
+        { offs[t] = offsets[t]; }
+        fwrite(&header, sizeof(header), 1, log_file);
+        fwrite(offs, sizeof(uint64_t), offset_count, log_file);
+    }
+
+    uint64_t hits[MAX_TARGETS] = {0};
+    size_t order[MAX_TARGETS];
+    for (int t = 0; t < offset_count; t++)
+    { order[t] = (size_t) t; }
+    uint64_t shuffle = start | 1;
+    uint64_t probed = 0;
+    uint64_t missed = 0;
+    uint64_t k = 0;
+    while (k < total)
+    {
+        // spin until the slot starts. If it has already ended, skip ahead to
+        // the slot we're in (counting the ones we passed over as missed, up to
+        // the end of the run)
+        uint64_t slot_start = start + (k * slot);
+        uint64_t now;
+        while ((now = sca_cycles()) < slot_start)
+        { }
+        if (now >= slot_start + slot)
+        {
+            uint64_t current = MIN((now - start) / slot, total);
+            missed += current - k;
+            k = current;
+            continue;
+        }
+
+        // reload each target (in a fresh random order), then flush it for the
+        // next slot
+        sca_rand_shuffle(order, (size_t) offset_count, &shuffle);
+        for (int i = 0; i < offset_count; i++)
+        {
+            int t = (int) order[i];
+            unsigned long cycles = sca_load(targets[t], NULL);
+            sca_flush(targets[t]);
+            if (cycles <= (unsigned long) cache_threshold)
+            {
+                hits[t]++;
+                if (log_file)
+                { log_event(k, (uint16_t) t, (uint16_t) MIN(cycles, 0xffff)); }
+            }
+        }
+        probed++;
+        k++;
+    }
+    log_flush();
+    if (log_file)
+    { fclose(log_file); }
+    munmap(map, st.st_size);
+
+    // report the sampling rate we achieved, and what we saw
+    double seconds = (double) (total * slot) / (double) cps;
+    printf("\nSlots: %lu probed, %lu missed (%.2f%%).\n", probed, missed,
+           total > 0 ? 100.0 * (double) missed / (double) total : 0.0);
+    printf("Sampling rate: %.0f slots/sec (target %.0f slots/sec).\n",
+           (double) probed / seconds, (double) total / seconds);
+    if (log_path)
+    {
+        printf("Logged %lu events (%lu bytes) to %s.\n", events_written,
+               sizeof(log_header_t) + (offset_count * sizeof(uint64_t)) +
+               (events_written * sizeof(log_event_t)), log_path);
+    }
+
+    printf("\n%12s %12s %12s\n", "offset", "hits", "hits/sec");
+    for (int t = 0; t < offset_count; t++)
+    {
+        printf("%#12lx %12lu %12.0f\n", offsets[t], hits[t],
+               (double) hits[t] / seconds);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+// ========================== Command-Line Options ========================== //
+// Parses command-line arguments and updates globals accordingly.
+static void args_parse(int argc, char** argv)
+{
+    // set up command-line options
+    static struct option opts[] = {
+        {"help",        no_argument,        NULL,   0},
+        {"file",        required_argument,  NULL,   0},
+        {"offset",      required_argument,  NULL,   0},
+        {"slot",        required_argument,  NULL,   0},
+        {"duration",    required_argument,  NULL,   0},
+        {"threshold",   required_argument,  NULL,   0},
+        {"log",         required_argument,  NULL,   0},
+        {"dump",        required_argument,  NULL,   0},
+        {NULL, 0, NULL, 0}
+    };
+    int optidx = 0;
+
+    // loop forever until all options are parsed
+    while (1)
+    {
+        // parse the next option and quit on error
+        int result = getopt_long_only(argc, argv, "", opts, &optidx);
+        if (result == -1)
+        { break; }
+        if (result != 0)
+        { goto args_parse_usage; }
+
+        struct option* opt = &opts[optidx];
+        if (!strcmp(opt->name, "help"))
+        { goto args_parse_usage; }
+        else if (!strcmp(opt->name, "file"))
+        { file_path = optarg; }
+        else if (!strcmp(opt->name, "offset"))
+        {
+            // offsets may be given in decimal or hex (ex: 0x1f40)
+            char* end = NULL;
+            unsigned long offset = strtoul(optarg, &end, 0);
+            if (end == optarg || *end != '\0' || offset_count == MAX_TARGETS)
+            {
+                fprintf(stderr, "You must specify up to %d non-negative integers for --offset.",
+                        MAX_TARGETS);
+                exit(EXIT_FAILURE);
+            }
+            offsets[offset_count++] = offset;
+        }
+        else if (!strcmp(opt->name, "slot"))
+        {
+            int result = LF(str_to_int)(optarg, &slot_cycles);
+            if (result || slot_cycles <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --slot.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "duration"))
+        {
+            int result = LF(str_to_int)(optarg, &duration_ms);
+            if (result || duration_ms <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --duration.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "threshold"))
+        {
+            int result = LF(str_to_int)(optarg, &cache_threshold);
+            if (result || cache_threshold <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --threshold.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "log"))
+        { log_path = optarg; }
+        else if (!strcmp(opt->name, "dump"))
+        { dump_path = optarg; }
+    }
+    if (dump_path || (file_path && offset_count > 0))
+    { return; }
+
+    // prints out a usage menu and exits the program
+    args_parse_usage:
+    printf("Flush+Reload Monitor\n");
+    printf("Usage: %s --file PATH --offset OFFSET [--offset OFFSET ...] [OPTIONS]\n",
+           argv[0]);
+    printf("Use this to watch for other processes touching lines of a shared file (such as a library).\n"
+           "Each offset's line is reloaded and flushed once per slot (of --slot cycles).\n"
+           "Use --log to record hits to a binary log, and --dump to print one.\n\n");
+
+    printf("Options:\n");
+    struct option* o = &opts[0];
+    while (o->name)
+    {
+        printf("  --%s (-%c)\n", o->name, o->name[0]);
+        o++;
+    }
+    exit(0);
+}
+
+
+// ================================== Main ================================== //
+// Main function.
+int main(int argc, char** argv)
+{
+    // initialize the library and parse arguments
+    sca_init();
+    args_parse(argc, argv);
+
+    if (dump_path)
+    { return log_dump(dump_path); }
+    return monitor();
+}
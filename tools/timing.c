@@ -21,17 +21,22 @@ static int trials = 100;
 static int show_summary = 1;
 static int show_table = 0;
 static int show_csv = 0;
+static int icache = 0;              // time instruction fetches instead
+static sca_sled_e sled = LIBSCA_SLED_RET;
 
 // Test memory regions
 #define MEM_BLOCK_SIZE 4096
 #define MEM_BLOCK_COUNT 256
-static uint8_t mem[MEM_BLOCK_COUNT * MEM_BLOCK_SIZE];
+static sca_region_t mem_region;     // pre-faulted, locked, and guarded
+static uint8_t* mem;
 
 
 // ================================= Timing ================================= //
 // Flushes all cache lines from the memory region we're using.
 static void flush_all()
 {
+    // warm up the TLB first, so the timed loads don't include page walks
+    sca_region_warm(&mem_region);
     for (int i = 0; i < MEM_BLOCK_COUNT; i++)
     { sca_flush_write(mem + (i * MEM_BLOCK_SIZE), 0xff); }
 }
@@ -76,8 +81,10 @@ static void measure(int trials)
         {
             void* addr = mem + (i * MEM_BLOCK_SIZE);
             
-            // CACHE MISS: load once (to fill up the cache) and record the time
-            uint64_t cycles = sca_load(addr, NULL);
+            // CACHE MISS: load once (to fill up the cache) and record the time.
+            // The sleeps between loads let the page's translation get evicted,
+            // so it's warmed first to keep page walks out of the measurement
+            uint64_t cycles = sca_probe_warm(addr, LIBSCA_PROBE_LOAD);
             sca_dataset_add(&cache_misses, (int64_t) cycles);
 
             // CACHE HIT: load again (with cache already full) and record
@@ -147,6 +154,43 @@ static void measure(int trials)
     sca_dataset_free(&overall_hit_medians);
 }
 
+// Measures instruction fetch times (by executing generated sleds) with and
+// without valid L1I entries, and prints a summary of each.
+static void measure_icache(int trials)
+{
+    sca_dataset_t cache_misses;
+    sca_dataset_t cache_hits;
+    if (sca_collect_icache_timing(sled, trials, &cache_hits, &cache_misses,
+                                  NULL))
+    {
+        printf("Failed to map the code region.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char* format = show_csv ? "%s,%ld,%ld,%ld,%ld\n"
+                            : "%-32s %14ld %14ld %14ld %14ld\n";
+    if (show_csv)
+    { printf("Fetch,Min,Max,Avg,Median\n"); }
+    else
+    {
+        printf("Instruction fetches ('%s' sleds, %lu samples discarded):\n",
+               sca_sled_name(sled), cache_misses.discarded);
+        printf("%-32s %14s %14s %14s %14s\n", "",
+               "Min", "Max", "Avg", "Median");
+    }
+    sca_dataset_t* sets[] = {&cache_misses, &cache_hits};
+    char* names[] = {"Cache Miss Time:", "Cache Hit Time:"};
+    for (int i = 0; i < 2; i++)
+    {
+        printf(format, show_csv ? (i ? "hit" : "miss") : names[i],
+               sca_dataset_min(sets[i]), sca_dataset_max(sets[i]),
+               sca_dataset_average(sets[i]), sca_dataset_median(sets[i]));
+    }
+
+    sca_dataset_free(&cache_misses);
+    sca_dataset_free(&cache_hits);
+}
+
 
 // ========================== Command-Line Options ========================== //
 // Parses command-line arguments and updates globals accordingly.
@@ -158,6 +202,7 @@ static void args_parse(int argc, char** argv)
         {"trials",      required_argument,  NULL,   0},
         {"show-table",  no_argument,        NULL,   0},
         {"show-csv",    no_argument,        NULL,   0},
+        {"icache",      required_argument,  NULL,   0},
         {NULL, 0, NULL, 0}
     };
     int optidx = 0;
@@ -194,6 +239,16 @@ static void args_parse(int argc, char** argv)
             show_csv = 1;
             show_summary = 0;
         }
+        else if (!strcmp(opt->name, "icache"))
+        {
+            sled = sca_sled_parse(optarg);
+            if (sled == LIBSCA_SLED_COUNT)
+            {
+                fprintf(stderr, "You must specify 'ret' or 'nop' for --icache.");
+                exit(EXIT_FAILURE);
+            }
+            icache = 1;
+        }
     }
     return;
     
@@ -202,7 +257,8 @@ static void args_parse(int argc, char** argv)
     printf("Cache Timing Measurement Utility\n");
     printf("Usage: %s [OPTIONS]\n", argv[0]);
     printf("Use this to measure the number of CPU cycles memory accesses take on your machine.\n"
-           "This tool measures for both cache hits and misses.\n\n");
+           "This tool measures for both cache hits and misses.\n"
+           "Use --icache (with 'ret' or 'nop' sleds) to time instruction fetches instead.\n\n");
 
     printf("Options:\n");
     struct option* o = &opts[0];
@@ -231,7 +287,24 @@ int main(int argc, char** argv)
     // seed the random generator and initialize data collection
     sca_rand_seed(time(NULL));
 
+    // instruction fetches are timed within the library
+    if (icache)
+    {
+        measure_icache(trials);
+        return EXIT_SUCCESS;
+    }
+
+    // map the memory region to time accesses to
+    if (sca_region_init(&mem_region, MEM_BLOCK_COUNT * MEM_BLOCK_SIZE,
+                        LIBSCA_MEM_POPULATE | LIBSCA_MEM_LOCK))
+    {
+        printf("Failed to map the memory region.\n");
+        return EXIT_FAILURE;
+    }
+    mem = mem_region.base;
+
     // perform the actual measurement and dump results
     measure(trials);
+    sca_region_free(&mem_region);
 }
 